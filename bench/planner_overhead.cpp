@@ -0,0 +1,194 @@
+#include <benchmark/benchmark.h>
+#include <planning_system.h>
+#include <gemm.h>
+
+// Cost of the planner itself per call, with executors whose operations do
+// nothing. Times are per dispatch, i.e. create_plan, calculate_workspace
+// and execute as the one-call API makes them.
+
+using namespace rtat;
+
+namespace {
+
+template<typename T>
+class Noop_Op : public MatrixOp<T> {
+public:
+  Noop_Op() : MatrixOp<T>({}) {}
+  Matrix<T> execute(gpu::blasHandle_t, Workspace, Workspace) override {
+    return Matrix<T>();
+  }
+
+  size_t output_space_req() const override {return 0;}
+  MatrixDims dims() const override {return MatrixDims();}
+};
+
+struct Noop_Params {
+  gpu::blasHandle_t handle;
+  int i;
+  Noop_Params(gpu::blasHandle_t handle, int i) : handle(handle), i(i) {}
+  bool operator==(const Noop_Params& o) const
+    {return handle == o.handle && i == o.i;}
+};
+
+struct Noop_Key {
+  int i;
+  Noop_Key(Noop_Params p) : i(p.i) {}
+  bool operator<(const Noop_Key& o) const {return i < o.i;}
+};
+
+// As many options as GEMM has, so exploration takes as long
+struct Noop_Opts {
+  int i;
+  Noop_Opts(int i) : i(i) {}
+  Noop_Opts() : i(0) {}
+
+  operator std::string() const {return std::to_string(i);}
+  friend std::ostream& operator<<(std::ostream& os, const Noop_Opts opts) {
+    os << opts.i;
+    return os;
+  }
+
+  static std::vector<Noop_Opts> enumerate() {
+    std::vector<Noop_Opts> ret;
+    for (size_t i = 0; i < GEMM_Options::enumerate().size(); i++)
+      ret.emplace_back(i);
+    return ret;
+  }
+
+  bool operator<(const Noop_Opts& o) const {return i < o.i;}
+  static Noop_Opts default_opts() {return Noop_Opts();}
+
+  std::unique_ptr<MatrixOp<double>> form_operation(Noop_Params) {
+    return std::make_unique<Noop_Op<double>>();
+  }
+};
+
+class Noop_Executor : public Executor<Noop_Params, Noop_Key, Noop_Opts> {
+  void warmup(gpu::blasHandle_t) override {}
+};
+
+using Noop_Planner = Planning_System<Noop_Executor>;
+
+void dispatch(Noop_Planner &planner, Noop_Params params, Stream s) {
+  auto opts = planner.create_plan(params);
+  benchmark::DoNotOptimize(planner.calculate_workspace(params, opts));
+  planner.execute(params, opts, Workspace(), s);
+}
+
+// Runs every key until it has converged
+void converge(Noop_Planner &planner, gpu::blasHandle_t handle,
+              int keys, Stream s) {
+  size_t rounds = Noop_Opts::enumerate().size() + 1;
+  for (int key = 0; key < keys; key++)
+    for (size_t r = 0; r < rounds; r++)
+      dispatch(planner, Noop_Params(handle, key), s);
+}
+
+}
+
+// Converged keys, cycled through so lookups see the whole table. The
+// second argument turns graph replay on or off.
+static void Dispatch_Converged(benchmark::State &state) {
+  int keys = state.range(0);
+  Stream s;
+  BLAS_Handle handle(s);
+  Noop_Planner planner;
+  planner.set_graph_replay(state.range(1));
+  converge(planner, handle, keys, s);
+
+  int key = 0;
+  for (auto _ : state) {
+    dispatch(planner, Noop_Params(handle, key), s);
+    key = (key+1 == keys) ? 0 : key+1;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(Dispatch_Converged)
+  ->ArgsProduct({{1, 64, 4096}, {0, 1}})
+  ->ArgNames({"keys", "replay"});
+
+// Keys that have not converged, so every dispatch picks an untried option
+// and records its timing. The planner is replaced, untimed, once all keys
+// have converged.
+static void Dispatch_Exploring(benchmark::State &state) {
+  int keys = state.range(0);
+  int per_key = Noop_Opts::enumerate().size();
+  Stream s;
+  BLAS_Handle handle(s);
+  auto planner = std::make_unique<Noop_Planner>();
+
+  int call = 0;
+  for (auto _ : state) {
+    dispatch(*planner, Noop_Params(handle, call/per_key), s);
+    if (++call == keys*per_key) {
+      state.PauseTiming();
+      planner = std::make_unique<Noop_Planner>();
+      call = 0;
+      state.ResumeTiming();
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(Dispatch_Exploring)->Arg(64)->Arg(4096)->ArgName("keys");
+
+static void Create_Plan_Converged(benchmark::State &state) {
+  int keys = state.range(0);
+  Stream s;
+  BLAS_Handle handle(s);
+  Noop_Planner planner;
+  converge(planner, handle, keys, s);
+
+  int key = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(planner.create_plan(Noop_Params(handle, key)));
+    key = (key+1 == keys) ? 0 : key+1;
+  }
+}
+BENCHMARK(Create_Plan_Converged)->Arg(1)->Arg(4096)->ArgName("keys");
+
+static void Calculate_Workspace(benchmark::State &state) {
+  int keys = state.range(0);
+  Stream s;
+  BLAS_Handle handle(s);
+  Noop_Planner planner;
+  converge(planner, handle, keys, s);
+
+  int key = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        planner.calculate_workspace(Noop_Params(handle, key), Noop_Opts()));
+    key = (key+1 == keys) ? 0 : key+1;
+  }
+}
+BENCHMARK(Calculate_Workspace)->Arg(1)->Arg(4096)->ArgName("keys");
+
+// Forming and optimizing the real GEMM operation trees, which the
+// executors do the first time they see a call's parameters or plan;
+// repeated calls reuse the operation already formed. No memory is touched.
+static void Form_GEMM_Operation(benchmark::State &state) {
+  Stream s;
+  BLAS_Handle handle(s);
+  std::vector<double> storage(1);
+  Workspace space(storage.data(), storage.size());
+  Matrix<double> A(space, 1, 1, 1), B(space, 1, 1, 1), C(space, 1, 1, 1);
+  GEMM_Inputs<double> params(handle, gpu::BLAS_OP_T, gpu::BLAS_OP_N,
+                             A, B, C, 1.0, 0.0);
+
+  auto plans = GEMM_Options::enumerate();
+  size_t plan = 0, elided = 0;
+  for (auto _ : state) {
+    auto operation = optimize(plans[plan].form_operation(params), elided);
+    benchmark::DoNotOptimize(operation);
+    plan = (plan+1 == plans.size()) ? 0 : plan+1;
+  }
+}
+BENCHMARK(Form_GEMM_Operation);
+
+static void Device_Timer_Creation(benchmark::State &state) {
+  Stream s;
+  for (auto _ : state) {
+    Device_Timer timer([](const Stream &) {}, s);
+    benchmark::DoNotOptimize(timer);
+  }
+}
+BENCHMARK(Device_Timer_Creation);
@@ -1,12 +1,14 @@
 #include <iostream>
 #include <planning_system.h>
 #include <string>
+#include <vector>
 
 using namespace rtat;
 
 gpu::blasOperation_t read_op(std::string op) {
   if (op == "N") return gpu::BLAS_OP_N;
   if (op == "T") return gpu::BLAS_OP_T;
+  if (op == "C") return gpu::BLAS_OP_C;
   throw;
 }
 
@@ -21,6 +23,33 @@ Matrix<double> allocate_matrix(size_t m, size_t n) {
   return Matrix<double>(allocate_workspace(size), m, n, m);
 }
 
+int measure_out_of_core(size_t m, size_t k, size_t n, int reps, 
+                        gpu::blasOperation_t opA, gpu::blasOperation_t opB) {
+  Out_Of_Core_DGEMM_Planner planner;
+
+  Stream s;
+  BLAS_Handle handle(s);
+
+  std::vector<double> A(m*k, 1.0), B(k*n, 1.0), C(m*n, 0.0);
+  size_t lda = opA == gpu::BLAS_OP_N ? m : k;
+  size_t ldb = opB == gpu::BLAS_OP_N ? k : n;
+  Matrix<double> Am(Workspace(A.data(), A.size()), lda, A.size()/lda, lda);
+  Matrix<double> Bm(Workspace(B.data(), B.size()), ldb, B.size()/ldb, ldb);
+  Matrix<double> Cm(Workspace(C.data(), C.size()), m, n, m);
+  GEMM_Inputs inputs(handle, opA, opB, Am, Bm, Cm, 1.0, 0.0);
+
+  auto plans = GEMM_Options_Out_Of_Core::enumerate();
+  size_t workspace_req = 0;
+  for (auto &plan : plans)
+    workspace_req = std::max(workspace_req, planner.calculate_workspace(inputs,plan));
+  Workspace space = allocate_workspace(workspace_req);
+
+  for (auto &plan : plans)
+    for (int i = 0; i < reps; i++) 
+      planner.execute(inputs, plan, space, s);
+  return 0;
+}
+
 int main(int argc, char *argv[]) {
   if (argc != 7) {
     std::cout << "Expected 6 parameters: m k n reps opA opB" << std::endl;
@@ -35,13 +64,20 @@ int main(int argc, char *argv[]) {
   auto opA = read_op(std::string(argv[5]));
   auto opB = read_op(std::string(argv[6]));
 
-  GEMM_Planner planner;
+  // Problems that do not fit on the device run out of core, from host 
+  // memory, with every tile size and depth
+  size_t footprint = ((size_t)m*k + (size_t)k*n + (size_t)m*n)*sizeof(double);
+  size_t free, total;
+  gpuAssert(gpu::MemGetInfo(&free, &total));
+  if (footprint > 0.9*free) {
+    std::cout << "Problem exceeds device memory, running out of core" << std::endl;
+    return measure_out_of_core(m, k, n, reps, opA, opB);
+  }
 
-  gpu::blasHandle_t handle;
-  gpu::blasCreate(&handle);
+  GEMM_Planner planner;
 
   Stream s;
-  gpu::blasSetStream(handle, s);
+  BLAS_Handle handle(s);
 
   auto plans = GEMM_Options::enumerate();
 
@@ -31,6 +31,12 @@ nlohmann::json dispatch_tests(Input_File& file) {
 
     case Data_Type::DOUBLE:
       return dispatch_tests<Executor<double>>(file);
+
+    case Data_Type::COMPLEX_FLOAT:
+      return dispatch_tests<Executor<std::complex<float>>>(file);
+
+    case Data_Type::COMPLEX_DOUBLE:
+      return dispatch_tests<Executor<std::complex<double>>>(file);
   }
   __builtin_unreachable();
 }
@@ -48,6 +54,9 @@ nlohmann::json dispatch_tests(Input_File& file) {
 
     case Method::TRSM:
       return dispatch_tests<TRSM_Executor>(file);
+
+    case Method::HERK:
+      return dispatch_tests<HERK_Executor>(file);
   }
   __builtin_unreachable();
 }
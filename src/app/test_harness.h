@@ -46,7 +46,8 @@ public:
     GEMM,
     GEMM_PAD,
     TRSM,
-    SYRK
+    SYRK,
+    HERK
   };
   _Method val;
 
@@ -59,6 +60,8 @@ public:
       val = SYRK;
     } else if (m == "trsm") {
       val = TRSM;
+    } else if (m == "herk") {
+      val = HERK;
     } else {
       throw std::runtime_error("Invalid method: "+m);
     }
@@ -74,6 +77,8 @@ public:
         return "syrk";
       case TRSM:
         return "trsm";
+      case HERK:
+        return "herk";
     }
     __builtin_unreachable();
   }
@@ -83,7 +88,9 @@ class Data_Type {
 public:
   enum _Data_Type {
     FLOAT,
-    DOUBLE
+    DOUBLE,
+    COMPLEX_FLOAT,
+    COMPLEX_DOUBLE
   };
   _Data_Type val;
 
@@ -92,6 +99,10 @@ public:
       val = DOUBLE;
     } else if (dt == "float") {
       val = FLOAT;
+    } else if (dt == "complex_double") {
+      val = COMPLEX_DOUBLE;
+    } else if (dt == "complex_float") {
+      val = COMPLEX_FLOAT;
     } else {
       throw std::runtime_error("Invalid data_type: "+dt);
     }
@@ -103,6 +114,10 @@ public:
         return "double";
       case FLOAT:
         return "float";
+      case COMPLEX_DOUBLE:
+        return "complex_double";
+      case COMPLEX_FLOAT:
+        return "complex_float";
     }
     __builtin_unreachable();
   }
@@ -145,17 +160,10 @@ private:
   ManagedWorkspace space;
   Device_RNG rng;
 public:
-  gpu::blasHandle_t handle;
+  BLAS_Handle handle;
   ManagedWorkspace scratch_space;
 
-  Device_Resources() : s(), space(1024), rng(s), scratch_space(1024){
-    gpu::blasCreate(&handle);
-    gpu::blasSetStream(handle,s);
-  }
-
-  ~Device_Resources() {
-    gpu::blasDestroy(handle);
-  }
+  Device_Resources() : s(), space(1024), rng(s), handle(s), scratch_space(1024) {}
 
   void sync() {s.synchronize();}
 
@@ -221,7 +229,7 @@ public:
     for (auto &problem : problems.get_problems()) {
       for (int i=0; i<repetitions; i++) {
         Params input = form_input<Scalar>(problem);
-        auto opts = planner.create_plan(problem);
+        auto opts = planner.create_plan(input);
         resources.scratch_space.grow_to_fit<char>(
             planner.calculate_workspace(input,opts));
         planner.execute(
@@ -278,6 +286,21 @@ public:
         key.uplo, key.trans,  
         matrices[0], matrices[1], 1.0, 0.0);
   }
+
+  template<typename T>
+  HERK_Inputs<T> form_input(HERK_Key key) {
+    MatrixDims Adims(key.trans == gpu::BLAS_OP_N ? key.n : key.k,
+                     key.trans == gpu::BLAS_OP_N ? key.k : key.n,
+                     key.trans == gpu::BLAS_OP_N ? key.n : key.k);
+    MatrixDims Cdims(key.n, key.n, key.n);
+
+    auto matrices = 
+      resources.allocate_matrices<T>({Adims,Cdims});
+
+    return HERK_Inputs<T>(resources.handle, 
+        key.uplo, key.trans,  
+        matrices[0], matrices[1], 1.0, 0.0);
+  }
 };
 
 }
@@ -1,4 +1,5 @@
 #include "gpu-api.h"
+#include <mutex>
 
 namespace rtat {
 
@@ -73,4 +74,123 @@ float Event::elapsed_time(Event start, Event end) {
     ms = NAN;
   return ms;
 }
+
+
+Raw_BLAS_Handle::operator gpu::blasHandle_t() { return handle; }
+
+class Non_Owning_BLAS_Handle : public Raw_BLAS_Handle {
+public:
+  Non_Owning_BLAS_Handle(gpu::blasHandle_t handle_) { handle = handle_; }
+  ~Non_Owning_BLAS_Handle() = default;
+};
+
+class Owning_BLAS_Handle : public Raw_BLAS_Handle {
+public:
+  Owning_BLAS_Handle(Stream s) { 
+    gpu::blasCreate(&handle); 
+    gpu::blasSetStream(handle, s);
+    bound = s;
+  }
+  ~Owning_BLAS_Handle() { gpu::blasDestroy(handle); }
+};
+
+BLAS_Handle::BLAS_Handle() : BLAS_Handle(Stream((gpu::Stream_t)nullptr)) {}
+BLAS_Handle::BLAS_Handle(Stream s) : raw_handle(std::make_shared<Owning_BLAS_Handle>(s)) {}
+BLAS_Handle::BLAS_Handle(gpu::blasHandle_t handle) : raw_handle(std::make_shared<Non_Owning_BLAS_Handle>(handle)) {}
+
+BLAS_Handle::BLAS_Handle(const BLAS_Handle& other) : raw_handle(other.raw_handle) {}
+BLAS_Handle& BLAS_Handle::operator=(const BLAS_Handle& other) { raw_handle = other.raw_handle; return *this; }
+
+BLAS_Handle::operator gpu::blasHandle_t() { return raw_handle->handle; }
+
+void BLAS_Handle::set_stream(Stream s) {
+  gpu::blasSetStream(raw_handle->handle, s);
+  raw_handle->bound = s;
+}
+
+Stream BLAS_Handle::get_stream() {
+  gpu::Stream_t stream;
+  gpu::blasGetStream(raw_handle->handle, &stream);
+  return Stream(stream);
+}
+
+
+gpu::blasHandle_t Handle_Pool::get(gpu::Stream_t s) {
+  int device;
+  gpuAssert(gpu::GetDevice(&device));
+  auto key = std::make_pair(device, s);
+  {
+    std::shared_lock<std::shared_mutex> reading(lock);
+    auto search = handles.find(key);
+    if (search != handles.end()) return search->second;
+  }
+
+  std::unique_lock<std::shared_mutex> writing(lock);
+  auto search = handles.find(key);
+  if (search == handles.end())
+    search = handles.emplace(key, BLAS_Handle(Stream(s))).first;
+  return search->second;
+}
+
+size_t Handle_Pool::size() {
+  std::shared_lock<std::shared_mutex> reading(lock);
+  return handles.size();
+}
+
+Handle_Pool& Handle_Pool::shared() {
+  static Handle_Pool pool;
+  return pool;
+}
+
+
+Host_Registration::Host_Registration(void *ptr, size_t bytes) : ptr(ptr) {
+  gpuAssert(gpu::HostRegister(ptr, bytes, gpu::HostRegisterDefault));
+}
+Host_Registration::~Host_Registration() { gpuAssert(gpu::HostUnregister(ptr)); }
+
+Event Copy_Engine::to_device(void *dst, const void *src, size_t bytes) {
+  gpuAssert(gpu::MemcpyAsync(dst, src, bytes, gpu::MemcpyHostToDevice, up));
+  Event done;
+  done.record(up);
+  return done;
+}
+
+Event Copy_Engine::to_host(void *dst, const void *src, size_t bytes) {
+  gpuAssert(gpu::MemcpyAsync(dst, src, bytes, gpu::MemcpyDeviceToHost, down));
+  Event done;
+  done.record(down);
+  return done;
+}
+
+void Copy_Engine::synchronize() {
+  up.synchronize();
+  down.synchronize();
+}
+
+// A graph of a different shape cannot be updated, and is instantiated 
+// afresh instead
+void Execution_Graph::rebuild(gpu::Graph_t graph) {
+  if (exec && gpu::GraphExecUpdate(exec, graph) == gpu::Success)
+    return;
+  if (exec) gpuAssert(gpu::GraphExecDestroy(exec));
+  gpuAssert(gpu::GraphInstantiateWithFlags(&exec, graph, 0));
+}
+
+int Device_Layer::current() const {
+  int device;
+  gpuAssert(gpu::GetDevice(&device));
+  return device;
+}
+
+int Device_Layer::count() const {
+  int devices;
+  gpuAssert(gpu::GetDeviceCount(&devices));
+  return devices;
+}
+
+std::string Device_Layer::model(int device) const {
+  gpu::DeviceProp_t prop;
+  gpuAssert(gpu::GetDeviceProperties(&prop, device));
+  return prop.name;
+}
 }
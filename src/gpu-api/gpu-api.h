@@ -20,10 +20,16 @@
 #elif defined(__GNUC__)
 #pragma GCC diagnostic pop  
 #endif
+#elif defined(_RTAT_HOST)
+#include "host-api.h"
 #endif
 #include <memory>
 #include <iostream>
 #include <map>
+#include <complex>
+#include <shared_mutex>
+#include <string>
+#include <utility>
 
 namespace rtat {
 
@@ -38,8 +44,13 @@ namespace gpu {
 #define _RTAT_GPU_BLAS(x) hipblas##x
 #define _RTAT_GPU_RAND(x) hip##x
 #define _RTAT_GPU_ENUM(x) HIP##x
+#elif defined(_RTAT_HOST)
+#define _RTAT_GPU(x) host##x
+#define _RTAT_GPU_BLAS(x) hostblas##x
+#define _RTAT_GPU_RAND(x) host##x
+#define _RTAT_GPU_ENUM(x) HOST##x
 #else 
-  static_assert(false, "Compiler must define either _RTAT_CUDA or _RTAT_HIP");
+  static_assert(false, "Compiler must define one of _RTAT_CUDA, _RTAT_HIP or _RTAT_HOST");
 #endif
   constexpr auto Success = _RTAT_GPU(Success);
   constexpr auto SetDevice = _RTAT_GPU(SetDevice);
@@ -48,6 +59,15 @@ namespace gpu {
   constexpr auto DeviceSynchronize = _RTAT_GPU(DeviceSynchronize);
   constexpr auto MemGetInfo = _RTAT_GPU(MemGetInfo);
 
+#if defined(_RTAT_CUDA)
+  using DeviceProp_t = cudaDeviceProp;
+#else
+  using DeviceProp_t = _RTAT_GPU(DeviceProp_t);
+#endif
+  inline auto GetDeviceProperties(DeviceProp_t *prop, int device) {
+    return _RTAT_GPU(GetDeviceProperties)(prop, device);
+  }
+
   using Error_t = _RTAT_GPU(Error_t);
   constexpr auto GetErrorString = _RTAT_GPU(GetErrorString);
   constexpr auto ErrorInvalidResourceHandle = _RTAT_GPU(ErrorInvalidResourceHandle);
@@ -59,6 +79,26 @@ namespace gpu {
     return _RTAT_GPU(Malloc)(ptr,size);
   }
 
+  // Page-locked host memory, which copies to and from asynchronously
+  template<typename T>
+  inline Error_t MallocHost(T** ptr, size_t size) {
+#if defined(_RTAT_HIP)
+    return hipHostMalloc((void**)ptr, size, 0);
+#else
+    return _RTAT_GPU(MallocHost)((void**)ptr, size);
+#endif
+  }
+#if defined(_RTAT_HIP)
+  constexpr auto FreeHost = hipHostFree;
+#else
+  constexpr auto FreeHost = _RTAT_GPU(FreeHost);
+#endif
+
+  // Pin an existing host allocation
+  constexpr auto HostRegister = _RTAT_GPU(HostRegister);
+  constexpr auto HostUnregister = _RTAT_GPU(HostUnregister);
+  constexpr auto HostRegisterDefault = _RTAT_GPU(HostRegisterDefault);
+
   using  Stream_t = _RTAT_GPU(Stream_t);
   constexpr auto StreamCreate = _RTAT_GPU(StreamCreate);
   constexpr auto StreamDestroy =  _RTAT_GPU(StreamDestroy);
@@ -83,6 +123,33 @@ namespace gpu {
   constexpr auto MemcpyDeviceToDevice = _RTAT_GPU(MemcpyDeviceToDevice);
   constexpr auto MemcpyDeviceToHost = _RTAT_GPU(MemcpyDeviceToHost);
   constexpr auto MemcpyHostToDevice = _RTAT_GPU(MemcpyHostToDevice);
+  constexpr auto MemcpyDefault = _RTAT_GPU(MemcpyDefault);
+  constexpr auto Memcpy2DAsync = _RTAT_GPU(Memcpy2DAsync);
+  constexpr auto DeviceCanAccessPeer = _RTAT_GPU(DeviceCanAccessPeer);
+  constexpr auto DeviceEnablePeerAccess = _RTAT_GPU(DeviceEnablePeerAccess);
+
+  // Stream capture into replayable graphs
+  using Graph_t = _RTAT_GPU(Graph_t);
+  using GraphExec_t = _RTAT_GPU(GraphExec_t);
+  constexpr auto StreamBeginCapture = _RTAT_GPU(StreamBeginCapture);
+  constexpr auto StreamEndCapture = _RTAT_GPU(StreamEndCapture);
+  constexpr auto StreamCaptureModeThreadLocal = _RTAT_GPU(StreamCaptureModeThreadLocal);
+  constexpr auto GraphDestroy = _RTAT_GPU(GraphDestroy);
+  constexpr auto GraphInstantiateWithFlags = _RTAT_GPU(GraphInstantiateWithFlags);
+  constexpr auto GraphExecDestroy = _RTAT_GPU(GraphExecDestroy);
+  constexpr auto GraphLaunch = _RTAT_GPU(GraphLaunch);
+
+  // Update reports failure differently between runtime versions
+  inline Error_t GraphExecUpdate(GraphExec_t exec, Graph_t graph) {
+#if defined(_RTAT_CUDA) && CUDART_VERSION >= 12000
+    cudaGraphExecUpdateResultInfo info;
+    return cudaGraphExecUpdate(exec, graph, &info);
+#else
+    _RTAT_GPU(GraphNode_t) node;
+    _RTAT_GPU(GraphExecUpdateResult) result;
+    return _RTAT_GPU(GraphExecUpdate)(exec, graph, &node, &result);
+#endif
+  }
 
   using blasHandle_t = _RTAT_GPU_BLAS(Handle_t);
   using blasOperation_t = _RTAT_GPU_BLAS(Operation_t);
@@ -92,12 +159,26 @@ namespace gpu {
   constexpr auto blasDestroy = _RTAT_GPU_BLAS(Destroy);
   constexpr auto blasDgeam = _RTAT_GPU_BLAS(Dgeam);
   constexpr auto blasDgemm = _RTAT_GPU_BLAS(Dgemm);
+  constexpr auto blasDgemmBatched = _RTAT_GPU_BLAS(DgemmBatched);
   constexpr auto blasDtrsm = _RTAT_GPU_BLAS(Dtrsm);
   constexpr auto blasDsyrk = _RTAT_GPU_BLAS(Dsyrk);
   constexpr auto blasSgeam = _RTAT_GPU_BLAS(Sgeam);
   constexpr auto blasSgemm = _RTAT_GPU_BLAS(Sgemm);
+  constexpr auto blasSgemmBatched = _RTAT_GPU_BLAS(SgemmBatched);
   constexpr auto blasStrsm = _RTAT_GPU_BLAS(Strsm);
   constexpr auto blasSsyrk = _RTAT_GPU_BLAS(Ssyrk);
+  constexpr auto blasZgeam = _RTAT_GPU_BLAS(Zgeam);
+  constexpr auto blasZgemm = _RTAT_GPU_BLAS(Zgemm);
+  constexpr auto blasZgemmBatched = _RTAT_GPU_BLAS(ZgemmBatched);
+  constexpr auto blasZtrsm = _RTAT_GPU_BLAS(Ztrsm);
+  constexpr auto blasZsyrk = _RTAT_GPU_BLAS(Zsyrk);
+  constexpr auto blasZherk = _RTAT_GPU_BLAS(Zherk);
+  constexpr auto blasCgeam = _RTAT_GPU_BLAS(Cgeam);
+  constexpr auto blasCgemm = _RTAT_GPU_BLAS(Cgemm);
+  constexpr auto blasCgemmBatched = _RTAT_GPU_BLAS(CgemmBatched);
+  constexpr auto blasCtrsm = _RTAT_GPU_BLAS(Ctrsm);
+  constexpr auto blasCsyrk = _RTAT_GPU_BLAS(Csyrk);
+  constexpr auto blasCherk = _RTAT_GPU_BLAS(Cherk);
   constexpr auto blasGetStream = _RTAT_GPU_BLAS(GetStream);
   constexpr auto blasSetStream = _RTAT_GPU_BLAS(SetStream);
   using blasSideMode_t = _RTAT_GPU_BLAS(SideMode_t);
@@ -111,6 +192,54 @@ namespace gpu {
   constexpr auto BLAS_FILL_MODE_UPPER = _RTAT_GPU_ENUM(BLAS_FILL_MODE_UPPER);
   constexpr auto BLAS_OP_N = _RTAT_GPU_ENUM(BLAS_OP_N);
   constexpr auto BLAS_OP_T = _RTAT_GPU_ENUM(BLAS_OP_T);
+  constexpr auto BLAS_OP_C = _RTAT_GPU_ENUM(BLAS_OP_C);
+
+  // Complex scalar types as the BLAS library expects them. These are 
+  // layout compatible with std::complex, which is what Matrix<T> holds.
+#if defined(_RTAT_CUDA)
+  using blasDoubleComplex = cuDoubleComplex;
+  using blasFloatComplex = cuComplex;
+#elif defined(_RTAT_HIP)
+  using blasDoubleComplex = hipblasDoubleComplex;
+  using blasFloatComplex = hipblasComplex;
+#elif defined(_RTAT_HOST)
+  using blasDoubleComplex = hostblasDoubleComplex;
+  using blasFloatComplex = hostblasComplex;
+#endif
+
+  // Mixed precision GEMM. The FAST compute types take fp32 operands, 
+  // round them to a reduced precision inside the library and accumulate 
+  // in fp32. hipBLAS has no equivalent, so there every compute type 
+  // maps to plain fp32. The host backend emulates the rounding.
+  constexpr auto blasGemmEx = _RTAT_GPU_BLAS(GemmEx);
+  constexpr auto blasIsamax = _RTAT_GPU_BLAS(Isamax);
+  constexpr auto blasIdamax = _RTAT_GPU_BLAS(Idamax);
+  constexpr auto BLAS_GEMM_DEFAULT = _RTAT_GPU_ENUM(BLAS_GEMM_DEFAULT);
+#if defined(_RTAT_CUDA)
+  using blasDataType_t = cudaDataType_t;
+  using blasComputeType_t = cublasComputeType_t;
+  constexpr auto BLAS_R_32F = CUDA_R_32F;
+  constexpr auto BLAS_COMPUTE_32F = CUBLAS_COMPUTE_32F;
+  constexpr auto BLAS_COMPUTE_32F_FAST_TF32 = CUBLAS_COMPUTE_32F_FAST_TF32;
+  constexpr auto BLAS_COMPUTE_32F_FAST_16F = CUBLAS_COMPUTE_32F_FAST_16F;
+  constexpr auto BLAS_COMPUTE_32F_FAST_16BF = CUBLAS_COMPUTE_32F_FAST_16BF;
+#elif defined(_RTAT_HIP)
+  using blasDataType_t = hipblasDatatype_t;
+  using blasComputeType_t = hipblasDatatype_t;
+  constexpr auto BLAS_R_32F = HIPBLAS_R_32F;
+  constexpr auto BLAS_COMPUTE_32F = HIPBLAS_R_32F;
+  constexpr auto BLAS_COMPUTE_32F_FAST_TF32 = HIPBLAS_R_32F;
+  constexpr auto BLAS_COMPUTE_32F_FAST_16F = HIPBLAS_R_32F;
+  constexpr auto BLAS_COMPUTE_32F_FAST_16BF = HIPBLAS_R_32F;
+#elif defined(_RTAT_HOST)
+  using blasDataType_t = hostDataType_t;
+  using blasComputeType_t = hostblasComputeType_t;
+  constexpr auto BLAS_R_32F = HOST_R_32F;
+  constexpr auto BLAS_COMPUTE_32F = HOSTBLAS_COMPUTE_32F;
+  constexpr auto BLAS_COMPUTE_32F_FAST_TF32 = HOSTBLAS_COMPUTE_32F_FAST_TF32;
+  constexpr auto BLAS_COMPUTE_32F_FAST_16F = HOSTBLAS_COMPUTE_32F_FAST_16F;
+  constexpr auto BLAS_COMPUTE_32F_FAST_16BF = HOSTBLAS_COMPUTE_32F_FAST_16BF;
+#endif
 
   using randGenerator_t = _RTAT_GPU_RAND(randGenerator_t);
   constexpr auto randSetStream = _RTAT_GPU_RAND(randSetStream);
@@ -200,6 +329,172 @@ private:
   std::shared_ptr<Raw_Event> raw_event;
 };
 
+class Raw_BLAS_Handle {
+public:
+  friend class BLAS_Handle;
+  virtual ~Raw_BLAS_Handle() = default;
+  operator gpu::blasHandle_t();
+protected:
+  Raw_BLAS_Handle() : bound((gpu::Stream_t)nullptr) {}
+  gpu::blasHandle_t handle;
+  // Kept so that an owning stream outlives the handle bound to it
+  Stream bound;
+};
+
+// BLAS library handle, bound to a stream on creation. Copies share the 
+// handle, so rebinding one rebinds them all.
+class BLAS_Handle {
+public:
+  BLAS_Handle();
+  BLAS_Handle(Stream s);
+  BLAS_Handle(gpu::blasHandle_t handle);
+
+  BLAS_Handle(const BLAS_Handle& other);
+  BLAS_Handle& operator=(const BLAS_Handle& other);
+
+  operator gpu::blasHandle_t();
+
+  void set_stream(Stream s);
+  Stream get_stream();
+private:
+  std::shared_ptr<Raw_BLAS_Handle> raw_handle;
+};
+
+// Handles bound to each stream, per device, created on first request and 
+// kept for the life of the pool, so callers fetch a ready handle without 
+// creating or rebinding one. Lookups share a lock, so callers on 
+// different streams do not contend. Streams are held by address only, 
+// and a stream created later at the same address gets the same handle.
+class Handle_Pool {
+public:
+  gpu::blasHandle_t get(gpu::Stream_t s);
+  size_t size();
+
+  // Process wide pool
+  static Handle_Pool& shared();
+private:
+  std::shared_mutex lock;
+  std::map<std::pair<int, gpu::Stream_t>, BLAS_Handle> handles;
+};
+
+// Page-locked host memory, which the device copies to and from 
+// asynchronously at full bus bandwidth. Move only.
+template<typename T>
+class Pinned_Buffer {
+  T *ptr = nullptr;
+  size_t count = 0;
+public:
+  Pinned_Buffer() = default;
+  Pinned_Buffer(size_t count) : count(count) {
+    gpuAssert(gpu::MallocHost(&ptr, count*sizeof(T)));
+  }
+  ~Pinned_Buffer() { if (ptr) gpuAssert(gpu::FreeHost(ptr)); }
+
+  Pinned_Buffer(const Pinned_Buffer&) = delete;
+  Pinned_Buffer& operator=(const Pinned_Buffer&) = delete;
+  Pinned_Buffer(Pinned_Buffer &&other) { *this = std::move(other); }
+  Pinned_Buffer& operator=(Pinned_Buffer &&other) {
+    std::swap(ptr, other.ptr);
+    std::swap(count, other.count);
+    return *this;
+  }
+
+  // Reallocates if smaller than new_count, discarding the contents. 
+  // Copies using the buffer must have finished.
+  void grow_to_fit(size_t new_count) {
+    if (count < new_count) *this = Pinned_Buffer(new_count);
+  }
+
+  T* data() { return ptr; }
+  size_t size() const { return count; }
+  T& operator[](size_t i) { return ptr[i]; }
+  T* begin() { return ptr; }
+  T* end() { return ptr + count; }
+};
+
+// Pins an existing host allocation for the lifetime of the object. The 
+// allocation must outlive it and must not move.
+class Host_Registration {
+  void *ptr;
+public:
+  Host_Registration(void *ptr, size_t bytes);
+  ~Host_Registration();
+
+  Host_Registration(const Host_Registration&) = delete;
+  Host_Registration& operator=(const Host_Registration&) = delete;
+};
+
+// Dedicated streams for host transfers, one per direction, so copies 
+// overlap with work on compute streams and with each other. Each copy 
+// returns an event marking its completion. Host memory should be pinned 
+// for the copies to be asynchronous.
+class Copy_Engine {
+  Stream up, down;
+public:
+  Event to_device(void *dst, const void *src, size_t bytes);
+  Event to_host(void *dst, const void *src, size_t bytes);
+
+  // Later copies in one direction wait for e
+  void upload_after(Event e) { up.wait_event(e); }
+  void download_after(Event e) { down.wait_event(e); }
+
+  void synchronize();
+};
+
+// Work captured from a stream, replayed with a single launch. Capturing 
+// again updates the executable graph in place, which is much cheaper 
+// than instantiating a new one, so a graph can follow operands that move 
+// between calls. Move only.
+class Execution_Graph {
+  gpu::GraphExec_t exec = nullptr;
+public:
+  Execution_Graph() = default;
+  ~Execution_Graph() { if (exec) gpuAssert(gpu::GraphExecDestroy(exec)); }
+
+  Execution_Graph(const Execution_Graph&) = delete;
+  Execution_Graph& operator=(const Execution_Graph&) = delete;
+  Execution_Graph(Execution_Graph &&other) { *this = std::move(other); }
+  Execution_Graph& operator=(Execution_Graph &&other) {
+    std::swap(exec, other.exec);
+    return *this;
+  }
+
+  // Records the work f issues to s, without running it. s must not be 
+  // the default stream.
+  template<typename Func>
+  void capture(gpu::Stream_t s, Func f) {
+    gpu::Graph_t graph;
+    gpuAssert(gpu::StreamBeginCapture(s, gpu::StreamCaptureModeThreadLocal));
+    try {
+      f();
+    } catch (...) {
+      if (gpu::StreamEndCapture(s, &graph) == gpu::Success)
+        gpuAssert(gpu::GraphDestroy(graph));
+      throw;
+    }
+    gpuAssert(gpu::StreamEndCapture(s, &graph));
+    rebuild(graph);
+    gpuAssert(gpu::GraphDestroy(graph));
+  }
+
+  void launch(gpu::Stream_t s) { gpuAssert(gpu::GraphLaunch(exec, s)); }
+  bool empty() const { return exec == nullptr; }
+
+private:
+  void rebuild(gpu::Graph_t graph);
+};
+
+// Device queries, virtual so that a node can be simulated in tests
+class Device_Layer {
+public:
+  virtual ~Device_Layer() = default;
+
+  virtual int current() const;
+  virtual int count() const;
+  // Devices with the same model are interchangeable for tuning
+  virtual std::string model(int device) const;
+};
+
 class Raw_Device_RNG {
 public:
   friend class Device_RNG;
@@ -236,6 +531,17 @@ public:
     gpu::randGenerateUniform(raw_rng->rng, A, len);
   }
 
+  // Complex matrices are filled as interleaved real/imaginary pairs
+  template<typename IGNORE>
+  void uniform(std::complex<double> *A, size_t len) {
+    gpu::randGenerateUniformDouble(raw_rng->rng, (double*)A, 2*len);
+  }
+
+  template<typename IGNORE>
+  void uniform(std::complex<float> *A, size_t len) {
+    gpu::randGenerateUniform(raw_rng->rng, (float*)A, 2*len);
+  }
+
 private:
   std::shared_ptr<Raw_Device_RNG> raw_rng;
 };
@@ -284,6 +590,7 @@ public:
   }
 
   bool operator==(T o) const {return val == o;}
+  bool operator<(const String_Rep &o) const {return val < o.val;}
 
   friend std::ostream& operator<<(std::ostream& os, 
       const String_Rep& r) {
@@ -295,7 +602,8 @@ public:
 struct BLAS_Operation_Str_Map {
   static std::map<gpu::blasOperation_t, std::string> map() {
     return {{gpu::BLAS_OP_N, "N"}, 
-            {gpu::BLAS_OP_T, "T"}};
+            {gpu::BLAS_OP_T, "T"},
+            {gpu::BLAS_OP_C, "C"}};
   }
 };
 using BLAS_Operation = String_Rep<BLAS_Operation_Str_Map>;
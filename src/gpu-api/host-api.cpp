@@ -0,0 +1,438 @@
+#include "host-api.h"
+#include <unistd.h>
+#include <vector>
+
+// Fortran BLAS. The CBLAS interface is deliberately avoided so that the
+// BLAS shim can export those symbols without recursing into itself.
+extern "C" {
+#define _RTAT_FORTRAN_DECLARE(P, T)                                        \
+  void P##gemm_(const char*, const char*, const int*, const int*,          \
+      const int*, const T*, const T*, const int*, const T*, const int*,    \
+      const T*, T*, const int*);                                           \
+  void P##trsm_(const char*, const char*, const char*, const char*,        \
+      const int*, const int*, const T*, const T*, const int*,              \
+      T*, const int*);                                                     \
+  void P##syrk_(const char*, const char*, const int*, const int*,          \
+      const T*, const T*, const int*, const T*, T*, const int*);
+_RTAT_FORTRAN_DECLARE(d, double)
+_RTAT_FORTRAN_DECLARE(s, float)
+_RTAT_FORTRAN_DECLARE(z, hostblasDoubleComplex)
+_RTAT_FORTRAN_DECLARE(c, hostblasComplex)
+#undef _RTAT_FORTRAN_DECLARE
+void zherk_(const char*, const char*, const int*, const int*,
+    const double*, const hostblasDoubleComplex*, const int*,
+    const double*, hostblasDoubleComplex*, const int*);
+void cherk_(const char*, const char*, const int*, const int*,
+    const float*, const hostblasComplex*, const int*,
+    const float*, hostblasComplex*, const int*);
+int isamax_(const int*, const float*, const int*);
+int idamax_(const int*, const double*, const int*);
+}
+
+namespace {
+
+char op_char(hostblasOperation_t op) {
+  switch (op) {
+    case HOSTBLAS_OP_N: return 'N';
+    case HOSTBLAS_OP_T: return 'T';
+    case HOSTBLAS_OP_C: return 'C';
+  }
+  __builtin_unreachable();
+}
+
+char fill_char(hostblasFillMode_t fill) {
+  return fill == HOSTBLAS_FILL_MODE_LOWER ? 'L' : 'U';
+}
+
+char side_char(hostblasSideMode_t side) {
+  return side == HOSTBLAS_SIDE_LEFT ? 'L' : 'R';
+}
+
+char diag_char(hostblasDiagType_t diag) {
+  return diag == HOSTBLAS_DIAG_UNIT ? 'U' : 'N';
+}
+
+template<typename T>
+T conjugate(T x) { return x; }
+
+template<typename T>
+std::complex<T> conjugate(std::complex<T> x) { return std::conj(x); }
+
+template<typename T>
+T element(hostblasOperation_t op, const T *A, int lda, int i, int j) {
+  switch (op) {
+    case HOSTBLAS_OP_N: return A[i+(size_t)j*lda];
+    case HOSTBLAS_OP_T: return A[j+(size_t)i*lda];
+    case HOSTBLAS_OP_C: return conjugate(A[j+(size_t)i*lda]);
+  }
+  __builtin_unreachable();
+}
+
+// As with the GPU libraries, a zero scale means the operand is not read
+template<typename T>
+hostblasStatus_t geam(hostblasOperation_t opa, hostblasOperation_t opb,
+                      int m, int n, T alpha, const T *A, int lda,
+                      T beta, const T *B, int ldb, T *C, int ldc) {
+  bool alias = (A == C && opa != HOSTBLAS_OP_N)
+            || (B == C && opb != HOSTBLAS_OP_N);
+  std::vector<T> scratch(alias ? (size_t)m*n : 0);
+  T *out = alias ? scratch.data() : C;
+  int ldo = alias ? m : ldc;
+
+  for (int j = 0; j < n; j++) {
+    for (int i = 0; i < m; i++) {
+      T a = (alpha == T(0.0)) ? T(0.0) : alpha*element(opa, A, lda, i, j);
+      T b = (beta == T(0.0)) ? T(0.0) : beta*element(opb, B, ldb, i, j);
+      out[i+(size_t)j*ldo] = a + b;
+    }
+  }
+
+  if (alias) {
+    for (int j = 0; j < n; j++)
+      for (int i = 0; i < m; i++)
+        C[i+(size_t)j*ldc] = out[i+(size_t)j*ldo];
+  }
+  return HOSTBLAS_STATUS_SUCCESS;
+}
+
+// Rounds to the nearest float with the given number of mantissa bits
+float round_mantissa(float x, int bits) {
+  unsigned int u;
+  std::memcpy(&u, &x, sizeof(u));
+  unsigned int drop = 23 - bits;
+  u = (u + (1u << (drop-1))) & ~((1u << drop) - 1);
+  std::memcpy(&x, &u, sizeof(u));
+  return x;
+}
+
+std::vector<float> rounded_copy(const float *A, int lda, int m, int n,
+                                int bits) {
+  std::vector<float> ret((size_t)lda*n);
+  for (int j = 0; j < n; j++)
+    for (int i = 0; i < m; i++)
+      ret[i+(size_t)j*lda] = round_mantissa(A[i+(size_t)j*lda], bits);
+  return ret;
+}
+
+thread_local int device = 0;
+
+int device_count() {
+  const char *env = std::getenv("RTAT_HOST_DEVICES");
+  int count = env ? std::atoi(env) : 1;
+  return count > 0 ? count : 1;
+}
+
+// Runs f now, or records it if the stream is being captured. Arguments 
+// must be captured by value, as the call returns before a replay.
+template<typename F>
+auto enqueue(hostStream_t s, F f) -> decltype(f()) {
+  if (s && s->capture) {
+    s->capture->tasks.push_back([f]() { f(); });
+    return {};
+  }
+  return f();
+}
+
+// A handle on the default stream, for calls made from recorded work
+hostblasContext immediate;
+}
+
+
+const char* hostGetErrorString(hostError_t err) {
+  switch (err) {
+    case hostSuccess: return "no error";
+    case hostErrorMemoryAllocation: return "out of memory";
+    case hostErrorInvalidDevice: return "invalid device ordinal";
+    case hostErrorInvalidResourceHandle: return "invalid resource handle";
+    case hostErrorStreamCaptureUnsupported: return "operation not permitted when stream is capturing";
+  }
+  return "unknown error";
+}
+
+hostError_t hostSetDevice(int d) {
+  if (d < 0 || d >= device_count()) return hostErrorInvalidDevice;
+  device = d;
+  return hostSuccess;
+}
+hostError_t hostGetDevice(int *d) { *d = device; return hostSuccess; }
+hostError_t hostGetDeviceCount(int *count) { *count = device_count(); return hostSuccess; }
+hostError_t hostDeviceSynchronize() { return hostSuccess; }
+
+hostError_t hostDeviceCanAccessPeer(int *can, int d, int peer) {
+  int count = device_count();
+  if (d < 0 || d >= count || peer < 0 || peer >= count)
+    return hostErrorInvalidDevice;
+  *can = 1;
+  return hostSuccess;
+}
+hostError_t hostDeviceEnablePeerAccess(int peer, unsigned int) {
+  if (peer < 0 || peer >= device_count()) return hostErrorInvalidDevice;
+  return hostSuccess;
+}
+
+hostError_t hostGetDeviceProperties(hostDeviceProp_t *prop, int d) {
+  if (d < 0 || d >= device_count()) return hostErrorInvalidDevice;
+  std::strncpy(prop->name, "host", sizeof(prop->name));
+  return hostSuccess;
+}
+
+hostError_t hostMemGetInfo(size_t *free, size_t *total) {
+  size_t page = sysconf(_SC_PAGESIZE);
+  *free = page*sysconf(_SC_AVPHYS_PAGES);
+  *total = page*sysconf(_SC_PHYS_PAGES);
+  return hostSuccess;
+}
+
+hostError_t hostFree(void *ptr) { std::free(ptr); return hostSuccess; }
+hostError_t hostMallocHost(void **ptr, size_t size) { return hostMalloc(ptr, size); }
+hostError_t hostFreeHost(void *ptr) { return hostFree(ptr); }
+hostError_t hostHostRegister(void*, size_t, unsigned int) { return hostSuccess; }
+hostError_t hostHostUnregister(void*) { return hostSuccess; }
+
+hostError_t hostMemcpy(void *dst, const void *src, size_t count,
+                       hostMemcpyKind) {
+  if (count) std::memmove(dst, src, count);
+  return hostSuccess;
+}
+hostError_t hostMemcpyAsync(void *dst, const void *src, size_t count,
+                            hostMemcpyKind kind, hostStream_t s) {
+  return enqueue(s, [=]() { return hostMemcpy(dst, src, count, kind); });
+}
+hostError_t hostMemcpy2DAsync(void *dst, size_t dpitch, const void *src,
+                              size_t spitch, size_t width, size_t height,
+                              hostMemcpyKind kind, hostStream_t s) {
+  return enqueue(s, [=]() {
+    for (size_t j = 0; j < height; j++)
+      hostMemcpy((char*)dst + j*dpitch, (const char*)src + j*spitch, width, kind);
+    return hostSuccess;
+  });
+}
+hostError_t hostMemset(void *dst, int value, size_t count) {
+  if (count) std::memset(dst, value, count);
+  return hostSuccess;
+}
+
+hostError_t hostStreamCreate(hostStream_t *s) { *s = new hostStream_st; return hostSuccess; }
+hostError_t hostStreamDestroy(hostStream_t s) { delete s->capture; delete s; return hostSuccess; }
+hostError_t hostStreamSynchronize(hostStream_t s) {
+  return (s && s->capture) ? hostErrorStreamCaptureUnsupported : hostSuccess;
+}
+hostError_t hostStreamWaitEvent(hostStream_t, hostEvent_t, unsigned int) { return hostSuccess; }
+
+hostError_t hostEventCreate(hostEvent_t *e) { *e = new hostEvent_st; return hostSuccess; }
+hostError_t hostEventDestroy(hostEvent_t e) { delete e; return hostSuccess; }
+hostError_t hostEventRecord(hostEvent_t e, hostStream_t s) {
+  return enqueue(s, [=]() {
+    e->time = std::chrono::steady_clock::now();
+    return hostSuccess;
+  });
+}
+hostError_t hostEventSynchronize(hostEvent_t) { return hostSuccess; }
+hostError_t hostEventQuery(hostEvent_t) { return hostSuccess; }
+hostError_t hostEventElapsedTime(float *ms, hostEvent_t start, hostEvent_t end) {
+  *ms = std::chrono::duration<float, std::milli>(end->time - start->time).count();
+  return hostSuccess;
+}
+
+hostError_t hostStreamBeginCapture(hostStream_t s, hostStreamCaptureMode) {
+  if (!s || s->capture) return hostErrorStreamCaptureUnsupported;
+  s->capture = new hostGraph_st;
+  return hostSuccess;
+}
+hostError_t hostStreamEndCapture(hostStream_t s, hostGraph_t *graph) {
+  if (!s || !s->capture) return hostErrorStreamCaptureUnsupported;
+  *graph = s->capture;
+  s->capture = nullptr;
+  return hostSuccess;
+}
+hostError_t hostGraphDestroy(hostGraph_t graph) { delete graph; return hostSuccess; }
+hostError_t hostGraphInstantiateWithFlags(hostGraphExec_t *exec, 
+                                          hostGraph_t graph, unsigned long long) {
+  *exec = new hostGraphExec_st{graph->tasks};
+  return hostSuccess;
+}
+hostError_t hostGraphExecUpdate(hostGraphExec_t exec, hostGraph_t graph,
+                                hostGraphNode_t*, 
+                                hostGraphExecUpdateResult *result) {
+  exec->tasks = graph->tasks;
+  *result = hostGraphExecUpdateSuccess;
+  return hostSuccess;
+}
+hostError_t hostGraphExecDestroy(hostGraphExec_t exec) { delete exec; return hostSuccess; }
+hostError_t hostGraphLaunch(hostGraphExec_t exec, hostStream_t s) {
+  if (s && s->capture) {
+    auto &tasks = s->capture->tasks;
+    tasks.insert(tasks.end(), exec->tasks.begin(), exec->tasks.end());
+    return hostSuccess;
+  }
+  for (auto &task : exec->tasks) task();
+  return hostSuccess;
+}
+
+
+hostblasStatus_t hostblasCreate(hostblasHandle_t *h) { *h = new hostblasContext; return HOSTBLAS_STATUS_SUCCESS; }
+hostblasStatus_t hostblasDestroy(hostblasHandle_t h) { delete h; return HOSTBLAS_STATUS_SUCCESS; }
+hostblasStatus_t hostblasSetStream(hostblasHandle_t h, hostStream_t s) { h->stream = s; return HOSTBLAS_STATUS_SUCCESS; }
+hostblasStatus_t hostblasGetStream(hostblasHandle_t h, hostStream_t *s) { *s = h->stream; return HOSTBLAS_STATUS_SUCCESS; }
+
+#define _RTAT_HOST_BLAS_DEFINE(P, p, T)                                    \
+  hostblasStatus_t hostblas##P##gemm(hostblasHandle_t h,                   \
+      hostblasOperation_t opa, hostblasOperation_t opb,                    \
+      int m, int n, int k, const T *alpha, const T *A, int lda,            \
+      const T *B, int ldb, const T *beta, T *C, int ldc) {                 \
+    if (m == 0 || n == 0) return HOSTBLAS_STATUS_SUCCESS;                  \
+    char ta = op_char(opa), tb = op_char(opb);                             \
+    T a = *alpha, b = *beta;                                               \
+    return enqueue(h->stream, [=]() {                                      \
+      p##gemm_(&ta, &tb, &m, &n, &k, &a, A, &lda, B, &ldb, &b, C, &ldc);   \
+      return HOSTBLAS_STATUS_SUCCESS;                                      \
+    });                                                                    \
+  }                                                                        \
+  /* The pointer arrays are device memory, read when the work runs */      \
+  hostblasStatus_t hostblas##P##gemmBatched(hostblasHandle_t h,            \
+      hostblasOperation_t opa, hostblasOperation_t opb,                    \
+      int m, int n, int k, const T *alpha, const T *const A[], int lda,    \
+      const T *const B[], int ldb, const T *beta, T *const C[], int ldc,   \
+      int batchCount) {                                                    \
+    if (m == 0 || n == 0) return HOSTBLAS_STATUS_SUCCESS;                  \
+    char ta = op_char(opa), tb = op_char(opb);                             \
+    T a = *alpha, b = *beta;                                               \
+    return enqueue(h->stream, [=]() {                                      \
+      for (int i = 0; i < batchCount; i++)                                 \
+        p##gemm_(&ta, &tb, &m, &n, &k, &a, A[i], &lda, B[i], &ldb,         \
+                 &b, C[i], &ldc);                                          \
+      return HOSTBLAS_STATUS_SUCCESS;                                      \
+    });                                                                    \
+  }                                                                        \
+  hostblasStatus_t hostblas##P##geam(hostblasHandle_t h,                   \
+      hostblasOperation_t opa, hostblasOperation_t opb, int m, int n,      \
+      const T *alpha, const T *A, int lda,                                 \
+      const T *beta, const T *B, int ldb, T *C, int ldc) {                 \
+    T a = *alpha, b = *beta;                                               \
+    return enqueue(h->stream, [=]() {                                      \
+      return geam<T>(opa, opb, m, n, a, A, lda, b, B, ldb, C, ldc);        \
+    });                                                                    \
+  }                                                                        \
+  hostblasStatus_t hostblas##P##trsm(hostblasHandle_t h,                   \
+      hostblasSideMode_t side, hostblasFillMode_t uplo,                    \
+      hostblasOperation_t op, hostblasDiagType_t diag, int m, int n,       \
+      const T *alpha, const T *A, int lda, T *B, int ldb) {                \
+    if (m == 0 || n == 0) return HOSTBLAS_STATUS_SUCCESS;                  \
+    char s = side_char(side), u = fill_char(uplo);                         \
+    char t = op_char(op), d = diag_char(diag);                             \
+    T a = *alpha;                                                          \
+    return enqueue(h->stream, [=]() {                                      \
+      p##trsm_(&s, &u, &t, &d, &m, &n, &a, A, &lda, B, &ldb);              \
+      return HOSTBLAS_STATUS_SUCCESS;                                      \
+    });                                                                    \
+  }                                                                        \
+  hostblasStatus_t hostblas##P##syrk(hostblasHandle_t h,                   \
+      hostblasFillMode_t uplo, hostblasOperation_t op, int n, int k,       \
+      const T *alpha, const T *A, int lda,                                 \
+      const T *beta, T *C, int ldc) {                                      \
+    if (n == 0) return HOSTBLAS_STATUS_SUCCESS;                            \
+    char u = fill_char(uplo), t = op_char(op);                             \
+    T a = *alpha, b = *beta;                                               \
+    return enqueue(h->stream, [=]() {                                      \
+      p##syrk_(&u, &t, &n, &k, &a, A, &lda, &b, C, &ldc);                  \
+      return HOSTBLAS_STATUS_SUCCESS;                                      \
+    });                                                                    \
+  }
+_RTAT_HOST_BLAS_DEFINE(D, d, double)
+_RTAT_HOST_BLAS_DEFINE(S, s, float)
+_RTAT_HOST_BLAS_DEFINE(Z, z, hostblasDoubleComplex)
+_RTAT_HOST_BLAS_DEFINE(C, c, hostblasComplex)
+#undef _RTAT_HOST_BLAS_DEFINE
+
+hostblasStatus_t hostblasZherk(hostblasHandle_t h,
+    hostblasFillMode_t uplo, hostblasOperation_t op, int n, int k,
+    const double *alpha, const hostblasDoubleComplex *A, int lda,
+    const double *beta, hostblasDoubleComplex *C, int ldc) {
+  if (n == 0) return HOSTBLAS_STATUS_SUCCESS;
+  char u = fill_char(uplo), t = op_char(op);
+  double a = *alpha, b = *beta;
+  return enqueue(h->stream, [=]() {
+    zherk_(&u, &t, &n, &k, &a, A, &lda, &b, C, &ldc);
+    return HOSTBLAS_STATUS_SUCCESS;
+  });
+}
+
+hostblasStatus_t hostblasCherk(hostblasHandle_t h,
+    hostblasFillMode_t uplo, hostblasOperation_t op, int n, int k,
+    const float *alpha, const hostblasComplex *A, int lda,
+    const float *beta, hostblasComplex *C, int ldc) {
+  if (n == 0) return HOSTBLAS_STATUS_SUCCESS;
+  char u = fill_char(uplo), t = op_char(op);
+  float a = *alpha, b = *beta;
+  return enqueue(h->stream, [=]() {
+    cherk_(&u, &t, &n, &k, &a, A, &lda, &b, C, &ldc);
+    return HOSTBLAS_STATUS_SUCCESS;
+  });
+}
+
+hostblasStatus_t hostblasGemmEx(hostblasHandle_t handle,
+    hostblasOperation_t opa, hostblasOperation_t opb, int m, int n, int k,
+    const void *alpha,
+    const void *A, hostDataType_t, int lda,
+    const void *B, hostDataType_t, int ldb,
+    const void *beta,
+    void *C, hostDataType_t, int ldc,
+    hostblasComputeType_t compute, hostblasGemmAlgo_t) {
+  int bits = 23;
+  switch (compute) {
+    case HOSTBLAS_COMPUTE_32F: bits = 23; break;
+    case HOSTBLAS_COMPUTE_32F_FAST_TF32: bits = 10; break;
+    case HOSTBLAS_COMPUTE_32F_FAST_16F: bits = 10; break;
+    case HOSTBLAS_COMPUTE_32F_FAST_16BF: bits = 7; break;
+  }
+
+  const float *Af = (const float*)A;
+  const float *Bf = (const float*)B;
+  if (bits == 23)
+    return hostblasSgemm(handle, opa, opb, m, n, k, (const float*)alpha,
+                         Af, lda, Bf, ldb, (const float*)beta, (float*)C, ldc);
+
+  // Rounding reads the operands, so it happens when the work runs
+  bool ta = opa != HOSTBLAS_OP_N;
+  bool tb = opb != HOSTBLAS_OP_N;
+  float a = *(const float*)alpha, b = *(const float*)beta;
+  return enqueue(handle->stream, [=]() {
+    auto A_round = rounded_copy(Af, lda, ta ? k : m, ta ? m : k, bits);
+    auto B_round = rounded_copy(Bf, ldb, tb ? n : k, tb ? k : n, bits);
+    return hostblasSgemm(&immediate, opa, opb, m, n, k, &a,
+                         A_round.data(), lda, B_round.data(), ldb,
+                         &b, (float*)C, ldc);
+  });
+}
+
+hostblasStatus_t hostblasIsamax(hostblasHandle_t, int n,
+                                const float *x, int incx, int *result) {
+  *result = isamax_(&n, x, &incx);
+  return HOSTBLAS_STATUS_SUCCESS;
+}
+
+hostblasStatus_t hostblasIdamax(hostblasHandle_t, int n,
+                                const double *x, int incx, int *result) {
+  *result = idamax_(&n, x, &incx);
+  return HOSTBLAS_STATUS_SUCCESS;
+}
+
+
+hostrandStatus_t hostrandCreateGenerator(hostrandGenerator_t *g, hostrandRngType_t) {
+  *g = new hostrandGenerator_st;
+  return HOSTRAND_STATUS_SUCCESS;
+}
+hostrandStatus_t hostrandDestroyGenerator(hostrandGenerator_t g) { delete g; return HOSTRAND_STATUS_SUCCESS; }
+hostrandStatus_t hostrandSetStream(hostrandGenerator_t, hostStream_t) { return HOSTRAND_STATUS_SUCCESS; }
+
+hostrandStatus_t hostrandGenerateUniformDouble(hostrandGenerator_t g, double *A, size_t len) {
+  std::uniform_real_distribution<double> unif(0.0, 1.0);
+  for (size_t i = 0; i < len; i++) A[i] = unif(g->engine);
+  return HOSTRAND_STATUS_SUCCESS;
+}
+
+hostrandStatus_t hostrandGenerateUniform(hostrandGenerator_t g, float *A, size_t len) {
+  std::uniform_real_distribution<float> unif(0.0, 1.0);
+  for (size_t i = 0; i < len; i++) A[i] = unif(g->engine);
+  return HOSTRAND_STATUS_SUCCESS;
+}
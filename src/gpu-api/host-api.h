@@ -0,0 +1,203 @@
+#pragma once
+// Host backend, selected with _RTAT_HOST. Mirrors the subset of the
+// CUDA/HIP runtime, BLAS and RNG APIs that rtatblas uses, executing
+// everything synchronously on the CPU through a Fortran BLAS. "Device"
+// memory is ordinary host memory, so this is only meant for testing on
+// machines without a GPU.
+//
+// RTAT_HOST_DEVICES sets how many devices are simulated, default 1. They
+// all share the host memory, so every pair has peer access.
+//
+// Work issued to a stream under capture is recorded rather than run, and
+// a graph is simply the recorded task list.
+#include <chrono>
+#include <complex>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+enum hostError_t {
+  hostSuccess = 0,
+  hostErrorMemoryAllocation = 2,
+  hostErrorInvalidDevice = 101,
+  hostErrorInvalidResourceHandle = 400,
+  hostErrorStreamCaptureUnsupported = 900
+};
+
+const char* hostGetErrorString(hostError_t);
+
+hostError_t hostSetDevice(int);
+hostError_t hostGetDevice(int*);
+hostError_t hostGetDeviceCount(int*);
+hostError_t hostDeviceCanAccessPeer(int*, int device, int peer);
+hostError_t hostDeviceEnablePeerAccess(int peer, unsigned int flags);
+hostError_t hostDeviceSynchronize();
+hostError_t hostMemGetInfo(size_t *free, size_t *total);
+
+struct hostDeviceProp_t { char name[256]; };
+hostError_t hostGetDeviceProperties(hostDeviceProp_t*, int);
+
+template<typename T>
+inline hostError_t hostMalloc(T** ptr, size_t size) {
+  *ptr = (T*)std::malloc(size ? size : 1);
+  return *ptr ? hostSuccess : hostErrorMemoryAllocation;
+}
+hostError_t hostFree(void*);
+// Host memory is all alike, pinned allocations are ordinary ones
+hostError_t hostMallocHost(void**, size_t);
+hostError_t hostFreeHost(void*);
+enum { hostHostRegisterDefault = 0 };
+hostError_t hostHostRegister(void*, size_t, unsigned int);
+hostError_t hostHostUnregister(void*);
+
+struct hostGraph_st { std::vector<std::function<void()>> tasks; };
+typedef hostGraph_st* hostGraph_t;
+struct hostGraphExec_st { std::vector<std::function<void()>> tasks; };
+typedef hostGraphExec_st* hostGraphExec_t;
+typedef void* hostGraphNode_t;
+
+struct hostStream_st { hostGraph_t capture = nullptr; };
+typedef hostStream_st* hostStream_t;
+hostError_t hostStreamCreate(hostStream_t*);
+hostError_t hostStreamDestroy(hostStream_t);
+hostError_t hostStreamSynchronize(hostStream_t);
+
+// The default stream cannot be captured, as on the GPU
+enum hostStreamCaptureMode {
+  hostStreamCaptureModeGlobal = 0,
+  hostStreamCaptureModeThreadLocal = 1,
+  hostStreamCaptureModeRelaxed = 2
+};
+enum hostGraphExecUpdateResult { hostGraphExecUpdateSuccess = 0 };
+hostError_t hostStreamBeginCapture(hostStream_t, hostStreamCaptureMode);
+hostError_t hostStreamEndCapture(hostStream_t, hostGraph_t*);
+hostError_t hostGraphDestroy(hostGraph_t);
+hostError_t hostGraphInstantiateWithFlags(hostGraphExec_t*, hostGraph_t,
+                                          unsigned long long);
+hostError_t hostGraphExecUpdate(hostGraphExec_t, hostGraph_t,
+                                hostGraphNode_t*, hostGraphExecUpdateResult*);
+hostError_t hostGraphExecDestroy(hostGraphExec_t);
+hostError_t hostGraphLaunch(hostGraphExec_t, hostStream_t);
+
+enum hostMemcpyKind {
+  hostMemcpyHostToHost = 0,
+  hostMemcpyHostToDevice = 1,
+  hostMemcpyDeviceToHost = 2,
+  hostMemcpyDeviceToDevice = 3,
+  hostMemcpyDefault = 4
+};
+hostError_t hostMemcpy(void*, const void*, size_t, hostMemcpyKind);
+hostError_t hostMemcpyAsync(void*, const void*, size_t, hostMemcpyKind,
+                            hostStream_t = nullptr);
+hostError_t hostMemcpy2DAsync(void*, size_t dpitch, const void*, size_t spitch,
+                              size_t width, size_t height, hostMemcpyKind,
+                              hostStream_t = nullptr);
+hostError_t hostMemset(void*, int, size_t);
+
+// Work completes before the call returns, so an event is just the time
+// at which it was recorded
+struct hostEvent_st { std::chrono::steady_clock::time_point time; };
+typedef hostEvent_st* hostEvent_t;
+hostError_t hostEventCreate(hostEvent_t*);
+hostError_t hostEventDestroy(hostEvent_t);
+hostError_t hostEventRecord(hostEvent_t, hostStream_t = nullptr);
+hostError_t hostEventSynchronize(hostEvent_t);
+hostError_t hostEventElapsedTime(float*, hostEvent_t, hostEvent_t);
+hostError_t hostEventQuery(hostEvent_t);
+hostError_t hostStreamWaitEvent(hostStream_t, hostEvent_t, unsigned int);
+
+
+enum hostblasStatus_t {
+  HOSTBLAS_STATUS_SUCCESS = 0,
+  HOSTBLAS_STATUS_INVALID_VALUE = 7
+};
+enum hostblasOperation_t { HOSTBLAS_OP_N, HOSTBLAS_OP_T, HOSTBLAS_OP_C };
+enum hostblasSideMode_t { HOSTBLAS_SIDE_LEFT, HOSTBLAS_SIDE_RIGHT };
+enum hostblasFillMode_t { HOSTBLAS_FILL_MODE_LOWER, HOSTBLAS_FILL_MODE_UPPER };
+enum hostblasDiagType_t { HOSTBLAS_DIAG_NON_UNIT, HOSTBLAS_DIAG_UNIT };
+enum hostDataType_t { HOST_R_32F };
+enum hostblasComputeType_t {
+  HOSTBLAS_COMPUTE_32F,
+  HOSTBLAS_COMPUTE_32F_FAST_TF32,
+  HOSTBLAS_COMPUTE_32F_FAST_16F,
+  HOSTBLAS_COMPUTE_32F_FAST_16BF
+};
+enum hostblasGemmAlgo_t { HOSTBLAS_GEMM_DEFAULT = -1 };
+
+struct hostblasContext { hostStream_t stream = nullptr; };
+typedef hostblasContext* hostblasHandle_t;
+
+typedef std::complex<double> hostblasDoubleComplex;
+typedef std::complex<float> hostblasComplex;
+
+hostblasStatus_t hostblasCreate(hostblasHandle_t*);
+hostblasStatus_t hostblasDestroy(hostblasHandle_t);
+hostblasStatus_t hostblasSetStream(hostblasHandle_t, hostStream_t);
+hostblasStatus_t hostblasGetStream(hostblasHandle_t, hostStream_t*);
+
+#define _RTAT_HOST_BLAS_DECLARE(P, T)                                      \
+  hostblasStatus_t hostblas##P##gemm(hostblasHandle_t,                     \
+      hostblasOperation_t, hostblasOperation_t, int m, int n, int k,       \
+      const T *alpha, const T *A, int lda, const T *B, int ldb,            \
+      const T *beta, T *C, int ldc);                                       \
+  hostblasStatus_t hostblas##P##gemmBatched(hostblasHandle_t,              \
+      hostblasOperation_t, hostblasOperation_t, int m, int n, int k,       \
+      const T *alpha, const T *const A[], int lda,                         \
+      const T *const B[], int ldb,                                         \
+      const T *beta, T *const C[], int ldc, int batchCount);               \
+  hostblasStatus_t hostblas##P##geam(hostblasHandle_t,                     \
+      hostblasOperation_t, hostblasOperation_t, int m, int n,              \
+      const T *alpha, const T *A, int lda,                                 \
+      const T *beta, const T *B, int ldb, T *C, int ldc);                  \
+  hostblasStatus_t hostblas##P##trsm(hostblasHandle_t,                     \
+      hostblasSideMode_t, hostblasFillMode_t, hostblasOperation_t,         \
+      hostblasDiagType_t, int m, int n,                                    \
+      const T *alpha, const T *A, int lda, T *B, int ldb);                 \
+  hostblasStatus_t hostblas##P##syrk(hostblasHandle_t,                     \
+      hostblasFillMode_t, hostblasOperation_t, int n, int k,               \
+      const T *alpha, const T *A, int lda,                                 \
+      const T *beta, T *C, int ldc);
+_RTAT_HOST_BLAS_DECLARE(D, double)
+_RTAT_HOST_BLAS_DECLARE(S, float)
+_RTAT_HOST_BLAS_DECLARE(Z, hostblasDoubleComplex)
+_RTAT_HOST_BLAS_DECLARE(C, hostblasComplex)
+#undef _RTAT_HOST_BLAS_DECLARE
+
+hostblasStatus_t hostblasZherk(hostblasHandle_t,
+    hostblasFillMode_t, hostblasOperation_t, int n, int k,
+    const double *alpha, const hostblasDoubleComplex *A, int lda,
+    const double *beta, hostblasDoubleComplex *C, int ldc);
+hostblasStatus_t hostblasCherk(hostblasHandle_t,
+    hostblasFillMode_t, hostblasOperation_t, int n, int k,
+    const float *alpha, const hostblasComplex *A, int lda,
+    const float *beta, hostblasComplex *C, int ldc);
+
+// The reduced precision compute types are emulated by rounding the
+// operand mantissas before an fp32 GEMM
+hostblasStatus_t hostblasGemmEx(hostblasHandle_t,
+    hostblasOperation_t, hostblasOperation_t, int m, int n, int k,
+    const void *alpha,
+    const void *A, hostDataType_t, int lda,
+    const void *B, hostDataType_t, int ldb,
+    const void *beta,
+    void *C, hostDataType_t, int ldc,
+    hostblasComputeType_t, hostblasGemmAlgo_t);
+
+hostblasStatus_t hostblasIsamax(hostblasHandle_t, int n,
+                                const float *x, int incx, int *result);
+hostblasStatus_t hostblasIdamax(hostblasHandle_t, int n,
+                                const double *x, int incx, int *result);
+
+
+enum hostrandStatus_t { HOSTRAND_STATUS_SUCCESS = 0 };
+enum hostrandRngType_t { HOSTRAND_RNG_PSEUDO_DEFAULT = 100 };
+struct hostrandGenerator_st { std::mt19937_64 engine; };
+typedef hostrandGenerator_st* hostrandGenerator_t;
+
+hostrandStatus_t hostrandCreateGenerator(hostrandGenerator_t*, hostrandRngType_t);
+hostrandStatus_t hostrandDestroyGenerator(hostrandGenerator_t);
+hostrandStatus_t hostrandSetStream(hostrandGenerator_t, hostStream_t);
+hostrandStatus_t hostrandGenerateUniformDouble(hostrandGenerator_t, double*, size_t);
+hostrandStatus_t hostrandGenerateUniform(hostrandGenerator_t, float*, size_t);
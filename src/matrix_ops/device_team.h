@@ -0,0 +1,84 @@
+#pragma once
+#include <gpu-api.h>
+#include "workspace.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace rtat {
+
+// Execution resources on a set of devices, for operations that span
+// several of them. Member 0 is the calling device, whose work runs on
+// the caller's handle and workspace, so its own resources go unused.
+// A device may appear more than once, which is useful for testing.
+class Device_Team {
+public:
+  struct Member {
+    int device;
+    // Two streams, so copies for one panel overlap work on another, 
+    // each with a handle bound to it
+    Stream streams[2];
+    BLAS_Handle handles[2] = {BLAS_Handle(streams[0]), BLAS_Handle(streams[1])};
+    ManagedWorkspace space;
+
+    Member(int device) : device(device), space(0) {}
+  };
+
+  Device_Team(std::vector<int> devices) {
+    int home;
+    gpuAssert(gpu::GetDevice(&home));
+    for (int device : devices) {
+      gpuAssert(gpu::SetDevice(device));
+      members.push_back(std::make_unique<Member>(device));
+    }
+
+    // Copies go peer to peer where possible. Enabling access twice
+    // reports an error, which is harmless.
+    for (auto &member : members) {
+      gpuAssert(gpu::SetDevice(member->device));
+      for (auto &peer : members) {
+        int can_access = 0;
+        if (peer->device == member->device) continue;
+        gpu::DeviceCanAccessPeer(&can_access, member->device, peer->device);
+        if (can_access) gpu::DeviceEnablePeerAccess(peer->device, 0);
+      }
+    }
+    gpuAssert(gpu::SetDevice(home));
+  }
+
+  // The calling device followed by every other device
+  Device_Team() : Device_Team(all_devices()) {}
+
+  // A process wide team for each calling device, shared by everything 
+  // not given a team of its own
+  static std::shared_ptr<Device_Team> shared() {
+    static std::mutex lock;
+    static std::map<int, std::shared_ptr<Device_Team>> teams;
+    std::lock_guard<std::mutex> guard(lock);
+
+    int home;
+    gpuAssert(gpu::GetDevice(&home));
+    auto &team = teams[home];
+    if (!team) team = std::make_shared<Device_Team>();
+    return team;
+  }
+
+  static std::vector<int> all_devices() {
+    int home, count;
+    gpuAssert(gpu::GetDevice(&home));
+    gpuAssert(gpu::GetDeviceCount(&count));
+    std::vector<int> devices = {home};
+    for (int device = 0; device < count; device++)
+      if (device != home) devices.push_back(device);
+    return devices;
+  }
+
+  size_t size() const { return members.size(); }
+  Member& operator[](size_t i) { return *members[i]; }
+
+private:
+  std::vector<std::unique_ptr<Member>> members;
+};
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "matrixop.h"
+
+namespace rtat {
+
+// A matrix whose contents may be held transposed in storage of its own.
+// Results computed transposed are left there rather than transposed back,
+// and calls taking the matrix as an operand read it through the
+// transpose, so chained calls do not transpose data back and forth. The
+// caller's matrix is only written when materialized, e.g. by read.
+template<typename T>
+class Lazy_Matrix {
+  Matrix<T> logical;
+  ManagedWorkspace storage;
+  bool held_transposed = false;
+  size_t transposes = 0;
+
+  Matrix<T> transposed_matrix() const {
+    auto dims = logical.dims();
+    return Matrix<T>(storage, dims.n, dims.m, dims.n);
+  }
+public:
+  Lazy_Matrix(Matrix<T> logical) : logical(logical), storage(0) {}
+
+  Lazy_Matrix(const Lazy_Matrix&) = delete;
+  Lazy_Matrix& operator=(const Lazy_Matrix&) = delete;
+
+  // The caller's matrix, out of date while the contents are transposed
+  Matrix<T> matrix() const { return logical; }
+
+  bool transposed() const { return held_transposed; }
+
+  // Transposes run so far to materialize the contents
+  size_t get_transposes() const { return transposes; }
+
+  // Where the contents currently are, i.e. the caller's matrix or its
+  // transpose
+  Matrix<T> physical() const {
+    return held_transposed ? transposed_matrix() : logical;
+  }
+
+  // The operation on physical() equal to op on the logical matrix, if
+  // BLAS can express it
+  std::optional<gpu::blasOperation_t> through(gpu::blasOperation_t op) const {
+    if (!held_transposed) return op;
+    return chain(op, gpu::BLAS_OP_T);
+  }
+
+  // Storage for the transpose of a new result, after which the contents
+  // are held transposed
+  Matrix<T> hold_transposed() {
+    storage.grow_to_fit<T>(logical.footprint());
+    held_transposed = true;
+    return transposed_matrix();
+  }
+
+  // Transposes the contents back into the caller's matrix, on the stream
+  // of handle
+  void materialize(gpu::blasHandle_t handle) {
+    if (!held_transposed) return;
+    gpuTgeam<T>(handle, gpu::BLAS_OP_T, gpu::BLAS_OP_N,
+                transposed_matrix(), logical, logical, 1.0, 0.0);
+    held_transposed = false;
+    transposes++;
+  }
+
+  // Drops the transposed contents without transposing them back, for 
+  // results that overwrite the matrix without reading it
+  void discard() { held_transposed = false; }
+
+  // The caller's matrix, up to date once the stream of handle reaches
+  // this point
+  Matrix<T> read(gpu::blasHandle_t handle) {
+    materialize(handle);
+    return logical;
+  }
+};
+
+}
@@ -1,5 +1,7 @@
 #pragma once
 #include "workspace.h"
+#include <cstdint>
+#include <optional>
 // There should be no inheritance relationship between Matrix and MatrixOp.
 // Accessing a MatrixOp requires a handle, accessing a Matrix does not.
 
@@ -14,6 +16,10 @@ struct MatrixDims {
 
   size_t footprint() const {return ld*n;}
 
+  bool operator==(const MatrixDims &other) const {
+    return m == other.m && n == other.n && ld == other.ld;
+  }
+
   friend std::ostream& operator<<(std::ostream& os, const MatrixDims dims) {
     os << "(" << dims.m << "," << dims.n << "," << dims.ld << ")";
     return os;
@@ -24,6 +30,7 @@ template<typename T>
 class Matrix {
   Workspace home;
   MatrixDims dimensions;
+  std::optional<uint64_t> gen;
 public:
 
   Matrix() {}
@@ -40,8 +47,11 @@ public:
   Matrix block(int row, int col, int nrows, int ncols) {
     MatrixDims block_dims(nrows, ncols, dims().ld);
 
-    size_t offset = row+col*dims().ld;
-    Workspace block_home(home, offset, block_dims.footprint()*sizeof(T));
+    // Workspace offsets are in bytes. The last column of a block is only 
+    // nrows long, so the block may end before a full ld*ncols footprint.
+    size_t offset = (row+col*dims().ld)*sizeof(T);
+    size_t count = (ncols > 0) ? (dims().ld*(ncols-1)+nrows) : 0;
+    Workspace block_home(home, offset, count*sizeof(T));
 
     return Matrix(block_home, block_dims);
 
@@ -52,6 +62,23 @@ public:
   const MatrixDims dims() const {return dimensions;}
 
   T* ptr() {return (T*)home;}
+  const T* ptr() const {return (const T*)home.data();}
+
+  // Marks the contents as unchanged since the caller's generation g, so 
+  // transformed copies of the matrix may be cached and reused. Callers 
+  // must move to a new generation whenever they write the matrix.
+  Matrix with_generation(uint64_t g) const {
+    Matrix ret = *this;
+    ret.gen = g;
+    return ret;
+  }
+  std::optional<uint64_t> generation() const {return gen;}
+
+  // Same storage, shape and generation
+  bool operator==(const Matrix &other) const {
+    return home == other.home && dimensions == other.dimensions 
+        && gen == other.gen;
+  }
 };
 
 }
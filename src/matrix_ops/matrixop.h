@@ -1,9 +1,17 @@
 #pragma once
 #include <gpu-api.h>
 #include "matrix.h"
+#include "device_team.h"
+#include "operand_cache.h"
 #include <iostream>
 #include <vector>
 #include <memory>
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <optional>
+#include <type_traits>
 
 namespace rtat {
 
@@ -12,18 +20,100 @@ namespace rtat {
 // concretized by providing space for the matrix and an execution 
 // context.
 
+template<typename T>
+struct is_complex : std::false_type {};
+template<typename T>
+struct is_complex<std::complex<T>> : std::true_type {};
+template<typename T>
+constexpr bool is_complex_v = is_complex<T>::value;
+
+// Underlying real type, used for HERK scaling factors
+template<typename T>
+using Real_T = decltype(std::real(T()));
+
+template<typename T>
+inline T conjugate(T x) {
+  if constexpr(is_complex_v<T>) {
+    return std::conj(x);
+  } else {
+    return x;
+  }
+}
+
+// Reinterpret std::complex data as the BLAS library's complex type.
+// Real types pass through unchanged.
+template<typename T>
+inline auto blas_cast(T* ptr) {
+  if constexpr(std::is_same_v<std::remove_const_t<T>,std::complex<double>>) {
+    using U = std::conditional_t<std::is_const_v<T>, 
+          const gpu::blasDoubleComplex, gpu::blasDoubleComplex>;
+    return reinterpret_cast<U*>(ptr);
+  } else if constexpr(std::is_same_v<std::remove_const_t<T>,std::complex<float>>) {
+    using U = std::conditional_t<std::is_const_v<T>, 
+          const gpu::blasFloatComplex, gpu::blasFloatComplex>;
+    return reinterpret_cast<U*>(ptr);
+  } else {
+    return ptr;
+  }
+}
+
+inline gpu::blasOperation_t blas_op(bool trans) {
+  return trans ? gpu::BLAS_OP_T : gpu::BLAS_OP_N;
+}
+
+// Moving op(A) into a transposed copy A' must use a conjugate transpose 
+// when op conjugates, otherwise a plain transpose. Real types never need 
+// to conjugate.
+template<typename T>
+inline gpu::blasOperation_t transpose_kind(gpu::blasOperation_t op) {
+  if constexpr(is_complex_v<T>) {
+    return op == gpu::BLAS_OP_C ? gpu::BLAS_OP_C : gpu::BLAS_OP_T;
+  } else {
+    return gpu::BLAS_OP_T;
+  }
+}
+
+// The operation equal to op followed by the transpose kind t, e.g. 
+// op(A) == compose(op,t)(A') when A' = t(A). BLAS cannot express a bare 
+// conjugation, so for complex types this is only valid when op is N or t.
+inline gpu::blasOperation_t compose(gpu::blasOperation_t op, 
+                                    gpu::blasOperation_t t) {
+  return op == gpu::BLAS_OP_N ? t : gpu::BLAS_OP_N;
+}
+
+template<typename T>
+inline bool composable(gpu::blasOperation_t op, gpu::blasOperation_t t) {
+  return !is_complex_v<T> || op == gpu::BLAS_OP_N || op == t;
+}
+
+// The single operation equal to applying inner and then outer, if one 
+// exists. T after C (or C after T) leaves a bare conjugation.
+inline std::optional<gpu::blasOperation_t> chain(gpu::blasOperation_t outer, 
+                                                 gpu::blasOperation_t inner) {
+  if (inner == gpu::BLAS_OP_N) return outer;
+  if (outer == gpu::BLAS_OP_N) return inner;
+  if (outer == inner) return gpu::BLAS_OP_N;
+  return {};
+}
+
+// The scalar a as seen through op, i.e. op(a*X) == through(op,a)*op(X)
+template<typename T>
+inline T through(gpu::blasOperation_t op, T a) {
+  return (op == gpu::BLAS_OP_C) ? conjugate(a) : a;
+}
+
 template<typename T>
 inline gpu::blasStatus_t gpuTgemm(gpu::blasHandle_t handle, 
-                               bool transa, bool transb,
+                               gpu::blasOperation_t transa, 
+                               gpu::blasOperation_t transb,
                                Matrix<T> A, Matrix<T> B, Matrix<T> C,
                                const T alpha, const T beta) {
   int m = C.dims().m;
   int n = C.dims().n;
-  int k = transa ? A.dims().m : A.dims().n;
+  int k = (transa != gpu::BLAS_OP_N) ? A.dims().m : A.dims().n;
   if constexpr(std::is_same_v<T,double>) {
     return gpu::blasDgemm(handle,
-                transa ? gpu::BLAS_OP_T : gpu::BLAS_OP_N,
-                transb ? gpu::BLAS_OP_T : gpu::BLAS_OP_N,
+                transa, transb,
                 m, n, k,
                 &alpha,
                 A.ptr(), A.dims().ld,
@@ -32,31 +122,130 @@ inline gpu::blasStatus_t gpuTgemm(gpu::blasHandle_t handle,
                 C.ptr(), C.dims().ld);
   } else if constexpr(std::is_same_v<T,float>) {
     return gpu::blasSgemm(handle,
-                transa ? gpu::BLAS_OP_T : gpu::BLAS_OP_N,
-                transb ? gpu::BLAS_OP_T : gpu::BLAS_OP_N,
+                transa, transb,
                 m, n, k,
                 &alpha,
                 A.ptr(), A.dims().ld,
                 B.ptr(), B.dims().ld,
                 &beta,
                 C.ptr(), C.dims().ld);
+  } else if constexpr(std::is_same_v<T,std::complex<double>>) {
+    return gpu::blasZgemm(handle,
+                transa, transb,
+                m, n, k,
+                blas_cast(&alpha),
+                blas_cast(A.ptr()), A.dims().ld,
+                blas_cast(B.ptr()), B.dims().ld,
+                blas_cast(&beta),
+                blas_cast(C.ptr()), C.dims().ld);
+  } else if constexpr(std::is_same_v<T,std::complex<float>>) {
+    return gpu::blasCgemm(handle,
+                transa, transb,
+                m, n, k,
+                blas_cast(&alpha),
+                blas_cast(A.ptr()), A.dims().ld,
+                blas_cast(B.ptr()), B.dims().ld,
+                blas_cast(&beta),
+                blas_cast(C.ptr()), C.dims().ld);
+  } else {
+    static_assert(!sizeof(T), "GEMM is only double, float and complex");
+  }
+  __builtin_unreachable();
+}
+
+// Independent GEMMs of one shape in a single launch. The operand pointer
+// arrays are in device memory.
+template<typename T>
+inline gpu::blasStatus_t gpuTgemmBatched(gpu::blasHandle_t handle, 
+                               gpu::blasOperation_t transa, 
+                               gpu::blasOperation_t transb,
+                               int m, int n, int k, const T alpha, 
+                               const T *const A[], int lda,
+                               const T *const B[], int ldb, const T beta,
+                               T *const C[], int ldc, int count) {
+  using U = std::remove_pointer_t<decltype(blas_cast((T*)nullptr))>;
+  auto As = reinterpret_cast<const U *const *>(A);
+  auto Bs = reinterpret_cast<const U *const *>(B);
+  auto Cs = reinterpret_cast<U *const *>(C);
+  if constexpr(std::is_same_v<T,double>) {
+    return gpu::blasDgemmBatched(handle, transa, transb, m, n, k, 
+                &alpha, As, lda, Bs, ldb, &beta, Cs, ldc, count);
+  } else if constexpr(std::is_same_v<T,float>) {
+    return gpu::blasSgemmBatched(handle, transa, transb, m, n, k, 
+                &alpha, As, lda, Bs, ldb, &beta, Cs, ldc, count);
+  } else if constexpr(std::is_same_v<T,std::complex<double>>) {
+    return gpu::blasZgemmBatched(handle, transa, transb, m, n, k, 
+                blas_cast(&alpha), As, lda, Bs, ldb, 
+                blas_cast(&beta), Cs, ldc, count);
+  } else if constexpr(std::is_same_v<T,std::complex<float>>) {
+    return gpu::blasCgemmBatched(handle, transa, transb, m, n, k, 
+                blas_cast(&alpha), As, lda, Bs, ldb, 
+                blas_cast(&beta), Cs, ldc, count);
   } else {
-    static_assert(!sizeof(T), "GEMM is only double and float");
+    static_assert(!sizeof(T), "GEMM is only double, float and complex");
   }
   __builtin_unreachable();
 }
 
+// GEMM with the operands rounded to a reduced precision by the library 
+// and accumulated in the precision of C. Only fp32 has reduced precision 
+// compute types; other types run at full precision.
+template<typename T>
+inline gpu::blasStatus_t gpuTgemmEx(gpu::blasHandle_t handle, 
+                               gpu::blasOperation_t transa, 
+                               gpu::blasOperation_t transb,
+                               Matrix<T> A, Matrix<T> B, Matrix<T> C,
+                               const T alpha, const T beta,
+                               gpu::blasComputeType_t compute) {
+  if constexpr(std::is_same_v<T,float>) {
+    int m = C.dims().m;
+    int n = C.dims().n;
+    int k = (transa != gpu::BLAS_OP_N) ? A.dims().m : A.dims().n;
+    return gpu::blasGemmEx(handle,
+                transa, transb,
+                m, n, k,
+                &alpha,
+                A.ptr(), gpu::BLAS_R_32F, A.dims().ld,
+                B.ptr(), gpu::BLAS_R_32F, B.dims().ld,
+                &beta,
+                C.ptr(), gpu::BLAS_R_32F, C.dims().ld,
+                compute, gpu::BLAS_GEMM_DEFAULT);
+  } else {
+    return gpuTgemm<T>(handle, transa, transb, A, B, C, alpha, beta);
+  }
+}
+
+// Largest absolute entry of a densely packed (ld == m) matrix.
+// Blocks until the result is available on the host.
+template<typename T>
+inline T gpuTamax(gpu::blasHandle_t handle, Matrix<T> A) {
+  int len = A.dims().m * A.dims().n;
+  if (len == 0) return 0.0;
+  int idx = 0;
+  if constexpr(std::is_same_v<T,double>) {
+    gpu::blasIdamax(handle, len, A.ptr(), 1, &idx);
+  } else if constexpr(std::is_same_v<T,float>) {
+    gpu::blasIsamax(handle, len, A.ptr(), 1, &idx);
+  } else {
+    static_assert(!sizeof(T), "amax is only double and float");
+  }
+  T result;
+  gpuAssert(gpu::Memcpy(&result, A.ptr()+(idx-1), sizeof(T), 
+                        gpu::MemcpyDeviceToHost));
+  return std::abs(result);
+}
+
 template<typename T>
 inline gpu::blasStatus_t gpuTsyrk(gpu::blasHandle_t handle, 
-                               bool lower, bool trans,
+                               bool lower, gpu::blasOperation_t trans,
                                Matrix<T> A, Matrix<T> C,
                                const T alpha, const T beta) {
   int n = C.dims().n;
-  int k = trans ? A.dims().m : A.dims().n;
+  int k = (trans != gpu::BLAS_OP_N) ? A.dims().m : A.dims().n;
   if constexpr(std::is_same_v<T,double>) {
     return gpu::blasDsyrk(handle,
                 lower ? gpu::BLAS_FILL_MODE_LOWER : gpu::BLAS_FILL_MODE_UPPER,
-                trans ? gpu::BLAS_OP_T : gpu::BLAS_OP_N,
+                trans,
                 n, k, 
                 &alpha,
                 A.ptr(), A.dims().ld,
@@ -65,14 +254,66 @@ inline gpu::blasStatus_t gpuTsyrk(gpu::blasHandle_t handle,
   } else if constexpr(std::is_same_v<T,float>) {
     return gpu::blasSsyrk(handle,
                 lower ? gpu::BLAS_FILL_MODE_LOWER : gpu::BLAS_FILL_MODE_UPPER,
-                trans ? gpu::BLAS_OP_T : gpu::BLAS_OP_N,
+                trans,
                 n, k, 
                 &alpha,
                 A.ptr(), A.dims().ld,
                 &beta,
                 C.ptr(), C.dims().ld);
+  } else if constexpr(std::is_same_v<T,std::complex<double>>) {
+    return gpu::blasZsyrk(handle,
+                lower ? gpu::BLAS_FILL_MODE_LOWER : gpu::BLAS_FILL_MODE_UPPER,
+                trans,
+                n, k, 
+                blas_cast(&alpha),
+                blas_cast(A.ptr()), A.dims().ld,
+                blas_cast(&beta),
+                blas_cast(C.ptr()), C.dims().ld);
+  } else if constexpr(std::is_same_v<T,std::complex<float>>) {
+    return gpu::blasCsyrk(handle,
+                lower ? gpu::BLAS_FILL_MODE_LOWER : gpu::BLAS_FILL_MODE_UPPER,
+                trans,
+                n, k, 
+                blas_cast(&alpha),
+                blas_cast(A.ptr()), A.dims().ld,
+                blas_cast(&beta),
+                blas_cast(C.ptr()), C.dims().ld);
   } else {
-    static_assert(!sizeof(T), "SYRK is only double and float");
+    static_assert(!sizeof(T), "SYRK is only double, float and complex");
+  }
+  __builtin_unreachable();
+}
+
+// Hermitian rank-k update. For real types this is just SYRK.
+template<typename T>
+inline gpu::blasStatus_t gpuTherk(gpu::blasHandle_t handle, 
+                               bool lower, gpu::blasOperation_t trans,
+                               Matrix<T> A, Matrix<T> C,
+                               const Real_T<T> alpha, const Real_T<T> beta) {
+  int n = C.dims().n;
+  int k = (trans != gpu::BLAS_OP_N) ? A.dims().m : A.dims().n;
+  if constexpr(std::is_same_v<T,std::complex<double>>) {
+    return gpu::blasZherk(handle,
+                lower ? gpu::BLAS_FILL_MODE_LOWER : gpu::BLAS_FILL_MODE_UPPER,
+                trans,
+                n, k, 
+                &alpha,
+                blas_cast(A.ptr()), A.dims().ld,
+                &beta,
+                blas_cast(C.ptr()), C.dims().ld);
+  } else if constexpr(std::is_same_v<T,std::complex<float>>) {
+    return gpu::blasCherk(handle,
+                lower ? gpu::BLAS_FILL_MODE_LOWER : gpu::BLAS_FILL_MODE_UPPER,
+                trans,
+                n, k, 
+                &alpha,
+                blas_cast(A.ptr()), A.dims().ld,
+                &beta,
+                blas_cast(C.ptr()), C.dims().ld);
+  } else {
+    return gpuTsyrk<T>(handle, lower, 
+        trans == gpu::BLAS_OP_N ? gpu::BLAS_OP_N : gpu::BLAS_OP_T,
+        A, C, alpha, beta);
   }
   __builtin_unreachable();
 }
@@ -80,7 +321,7 @@ inline gpu::blasStatus_t gpuTsyrk(gpu::blasHandle_t handle,
 template<typename T>
 inline gpu::blasStatus_t gpuTtrsm(gpu::blasHandle_t handle, 
                                bool side_left, bool lower, 
-                               bool trans, bool unit_diag,
+                               gpu::blasOperation_t trans, bool unit_diag,
                                Matrix<T> A, Matrix<T> B, 
                                const T alpha) {
   int m = B.dims().m;
@@ -89,7 +330,7 @@ inline gpu::blasStatus_t gpuTtrsm(gpu::blasHandle_t handle,
     return gpu::blasDtrsm(handle,
                 side_left ? gpu::BLAS_SIDE_LEFT : gpu::BLAS_SIDE_RIGHT,
                 lower ? gpu::BLAS_FILL_MODE_LOWER : gpu::BLAS_FILL_MODE_UPPER,
-                trans ? gpu::BLAS_OP_T : gpu::BLAS_OP_N,
+                trans,
                 unit_diag ? gpu::BLAS_DIAG_UNIT : gpu::BLAS_DIAG_NON_UNIT,
                 m, n,
                 &alpha,
@@ -99,28 +340,48 @@ inline gpu::blasStatus_t gpuTtrsm(gpu::blasHandle_t handle,
     return gpu::blasStrsm(handle,
                 side_left ? gpu::BLAS_SIDE_LEFT : gpu::BLAS_SIDE_RIGHT,
                 lower ? gpu::BLAS_FILL_MODE_LOWER : gpu::BLAS_FILL_MODE_UPPER,
-                trans ? gpu::BLAS_OP_T : gpu::BLAS_OP_N,
+                trans,
                 unit_diag ? gpu::BLAS_DIAG_UNIT : gpu::BLAS_DIAG_NON_UNIT,
                 m, n,
                 &alpha,
                 A.ptr(), A.dims().ld,
                 B.ptr(), B.dims().ld);
+  } else if constexpr(std::is_same_v<T,std::complex<double>>) {
+    return gpu::blasZtrsm(handle,
+                side_left ? gpu::BLAS_SIDE_LEFT : gpu::BLAS_SIDE_RIGHT,
+                lower ? gpu::BLAS_FILL_MODE_LOWER : gpu::BLAS_FILL_MODE_UPPER,
+                trans,
+                unit_diag ? gpu::BLAS_DIAG_UNIT : gpu::BLAS_DIAG_NON_UNIT,
+                m, n,
+                blas_cast(&alpha),
+                blas_cast(A.ptr()), A.dims().ld,
+                blas_cast(B.ptr()), B.dims().ld);
+  } else if constexpr(std::is_same_v<T,std::complex<float>>) {
+    return gpu::blasCtrsm(handle,
+                side_left ? gpu::BLAS_SIDE_LEFT : gpu::BLAS_SIDE_RIGHT,
+                lower ? gpu::BLAS_FILL_MODE_LOWER : gpu::BLAS_FILL_MODE_UPPER,
+                trans,
+                unit_diag ? gpu::BLAS_DIAG_UNIT : gpu::BLAS_DIAG_NON_UNIT,
+                m, n,
+                blas_cast(&alpha),
+                blas_cast(A.ptr()), A.dims().ld,
+                blas_cast(B.ptr()), B.dims().ld);
   } else {
-    static_assert(!sizeof(T), "TRSM is only double and float");
+    static_assert(!sizeof(T), "TRSM is only double, float and complex");
   }
   __builtin_unreachable();
 }
 
 template<typename T>
 inline gpu::blasStatus_t gpuTgeam(gpu::blasHandle_t handle, 
-                               bool transa, bool transb,
+                               gpu::blasOperation_t transa, 
+                               gpu::blasOperation_t transb,
                                Matrix<T> A, Matrix<T> B, Matrix<T> C,
                                const T alpha, 
                                const T beta) {
   if constexpr(std::is_same_v<T,double>) {
     return gpu::blasDgeam(handle,
-                transa ? gpu::BLAS_OP_T : gpu::BLAS_OP_N, 
-                transb ? gpu::BLAS_OP_T : gpu::BLAS_OP_N, 
+                transa, transb,
                 B.dims().m, B.dims().n,
                 &alpha,
                 A.ptr(), A.dims().ld,
@@ -129,25 +390,109 @@ inline gpu::blasStatus_t gpuTgeam(gpu::blasHandle_t handle,
                 C.ptr(), C.dims().ld);
   } else if constexpr(std::is_same_v<T,float>) {
     return gpu::blasSgeam(handle,
-                transa ? gpu::BLAS_OP_T : gpu::BLAS_OP_N, 
-                transb ? gpu::BLAS_OP_T : gpu::BLAS_OP_N, 
+                transa, transb,
                 B.dims().m, B.dims().n,
                 &alpha,
                 A.ptr(), A.dims().ld,
                 &beta,
                 B.ptr(), B.dims().ld,
                 C.ptr(), C.dims().ld);
+  } else if constexpr(std::is_same_v<T,std::complex<double>>) {
+    return gpu::blasZgeam(handle,
+                transa, transb,
+                B.dims().m, B.dims().n,
+                blas_cast(&alpha),
+                blas_cast(A.ptr()), A.dims().ld,
+                blas_cast(&beta),
+                blas_cast(B.ptr()), B.dims().ld,
+                blas_cast(C.ptr()), C.dims().ld);
+  } else if constexpr(std::is_same_v<T,std::complex<float>>) {
+    return gpu::blasCgeam(handle,
+                transa, transb,
+                B.dims().m, B.dims().n,
+                blas_cast(&alpha),
+                blas_cast(A.ptr()), A.dims().ld,
+                blas_cast(&beta),
+                blas_cast(B.ptr()), B.dims().ld,
+                blas_cast(C.ptr()), C.dims().ld);
   } else {
-    static_assert(!sizeof(T), "GEAM is only double and float");
+    static_assert(!sizeof(T), "GEAM is only double, float and complex");
   }
   __builtin_unreachable();
 }
 
+// Copy between matrices of the same shape. Either may be on the host 
+// or any device, the runtime routes the copy peer to peer if it can.
+template<typename T>
+inline gpu::Error_t gpuTcopy(Matrix<T> dst, Matrix<T> src, gpu::Stream_t s) {
+  return gpu::Memcpy2DAsync(dst.ptr(), dst.dims().ld*sizeof(T),
+                            src.ptr(), src.dims().ld*sizeof(T),
+                            src.dims().m*sizeof(T), src.dims().n,
+                            gpu::MemcpyDefault, s);
+}
+
+// Copy between host matrices of the same shape
+template<typename T>
+inline void host_copy(Matrix<T> dst, Matrix<T> src) {
+  for (size_t j = 0; j < src.dims().n; j++)
+    std::memcpy(dst.ptr() + j*dst.dims().ld, src.ptr() + j*src.dims().ld,
+                src.dims().m*sizeof(T));
+}
+
+// Calls f(row, col, rows, cols) on rectangular blocks covering one 
+// triangle, diagonal included, of an n by n matrix. Off diagonal 
+// blocks come from recursive halving on multiples of leaf, so most of 
+// the triangle is covered by a few large blocks. The diagonal blocks 
+// are leaf wide, but for the last, and start at multiples of leaf. 
+// They are passed whole if diagonal is set, and otherwise left to the 
+// caller, see for_each_diagonal_column.
+template<typename F>
+inline void for_each_triangle_block(int n, bool lower, int leaf, 
+                                    bool diagonal, F f) {
+  auto visit = [&](auto &self, int o, int size) -> void {
+    if (size <= 0) return;
+    if (size <= leaf) {
+      if (diagonal) f(o, o, size, size);
+      return;
+    }
+    int h = ((size+leaf-1)/leaf/2)*leaf;
+    self(self, o, h);
+    if (lower) f(o+h, o, size-h, h);
+    else       f(o, o+h, h, size-h);
+    self(self, o+h, size-h);
+  };
+  visit(visit, 0, n);
+}
+
+// Calls f(row, col, rows, count) on the columns of one triangle within 
+// the diagonal blocks of for_each_triangle_block, so exactly the 
+// elements those blocks leave out. Each call covers the column at the 
+// same position in count blocks, starting with the one at (row, col), 
+// each a further leaf rows and columns down the diagonal. So a call is 
+// one strided matrix operation, and there are at most 2*leaf of them.
+template<typename F>
+inline void for_each_diagonal_column(int n, bool lower, int leaf, F f) {
+  int full = n/leaf;
+  int rest = n%leaf;
+  int o = full*leaf;
+  for (int c = 0; c < leaf; c++) {
+    if (full > 0) {
+      if (lower) f(c, c, leaf-c, full);
+      else       f(0, c, c+1, full);
+    }
+    if (c < rest) {
+      if (lower) f(o+c, o+c, rest-c, 1);
+      else       f(o, o+c, c+1, 1);
+    }
+  }
+}
+
 template<typename T>
 class MatrixOp {
 protected:
   std::vector<std::unique_ptr<MatrixOp>> operands;
   int output_operand = -1;
+  std::vector<Matrix<T>> computed;
 public:
   MatrixOp(const MatrixOp&) = delete;
   MatrixOp(MatrixOp&&) = default;
@@ -193,10 +538,13 @@ public:
   }
 
 
-  std::vector<Matrix<T>> compute_operands(gpu::blasHandle_t handle,
+  // The results are kept in the node, so repeated executions of a tree 
+  // reuse their storage
+  std::vector<Matrix<T>>& compute_operands(gpu::blasHandle_t handle,
                                        Workspace out_space, Workspace scratch_space) {
     // TODO compute operands in decreasing order of space requirements
-    std::vector<Matrix<T>> output;
+    std::vector<Matrix<T>> &output = computed;
+    output.clear();
     for (int i = 0; i < (int)operands.size(); i++) {
       auto &operand = operands[i];
       Workspace operand_space;
@@ -213,11 +561,86 @@ public:
     return output;
   }
 
-  std::vector<Matrix<T>> compute_operands(gpu::blasHandle_t handle, Workspace scratch_space) {
+  std::vector<Matrix<T>>& compute_operands(gpu::blasHandle_t handle, Workspace scratch_space) {
     return compute_operands(handle, Workspace(), scratch_space);
   }
+
+  // Rewrite the tree rooted at op into an equivalent one making fewer 
+  // passes over memory. Operands are simplified first, so rules only 
+  // need to look one level down. elided counts the passes removed.
+  static std::unique_ptr<MatrixOp> optimize(std::unique_ptr<MatrixOp> op, 
+                                            size_t &elided) {
+    for (auto &operand : op->operands)
+      operand = optimize(std::move(operand), elided);
+
+    if (auto replacement = op->simplify(elided))
+      return optimize(std::move(replacement), elided);
+
+    // Copies of operands which are only read are redundant
+    for (int i = 0; i < (int)op->operands.size(); i++) {
+      auto &operand = op->operands[i];
+      if (i != op->output_operand && operand->is_identity()) {
+        operand = std::move(operand->operands[0]);
+        elided++;
+      }
+    }
+    return op;
+  }
+
+  // Local rewrite rule. Either modifies this node in place and returns 
+  // nullptr, or returns a node to replace it.
+  virtual std::unique_ptr<MatrixOp> simplify([[maybe_unused]] size_t &elided) { 
+    return nullptr; 
+  }
+
+  // True if the node is an unscaled copy of its first operand
+  virtual bool is_identity() const { return false; }
+
+  // The caller's matrix, for leaves that use it as is
+  virtual const Matrix<T>* source() const { return nullptr; }
+
+  // Set for transforms of a matrix the caller has given a generation, 
+  // whose results can be kept between calls
+  virtual std::optional<Operand_Key> cache_key() const { return {}; }
+
+  // Rewrite the tree so cacheable transforms go through cache
+  static std::unique_ptr<MatrixOp> use_cache(std::unique_ptr<MatrixOp> op, 
+                                             Operand_Cache &cache);
+
+  // Remove a scalar factor from this node so the consumer can apply it
+  virtual T take_scale() { return 1.0; }
+
+protected:
+  // Key for an unscaled transform of the first operand
+  std::optional<Operand_Key> source_key(gpu::blasOperation_t op, 
+                                        size_t pad, int triangle) const {
+    auto source = operands[0]->source();
+    if (!source || !source->generation()) return {};
+    int device;
+    gpuAssert(gpu::GetDevice(&device));
+    auto dims = source->dims();
+    return Operand_Key{device, source->ptr(), dims.m, dims.n, dims.ld, 
+                       *source->generation(), (int)op, pad, triangle};
+  }
+public:
+
+  // Absorb a following C = alpha*op(this) + beta*C by writing into C 
+  // directly. Returns nullptr, leaving C untouched, if not possible.
+  virtual std::unique_ptr<MatrixOp> fuse_accumulate(
+      [[maybe_unused]] std::unique_ptr<MatrixOp> &C, 
+      [[maybe_unused]] T alpha, [[maybe_unused]] T beta, 
+      [[maybe_unused]] gpu::blasOperation_t op, 
+      [[maybe_unused]] size_t &elided) {
+    return nullptr;
+  }
 };
 
+template<typename T>
+std::unique_ptr<MatrixOp<T>> optimize(std::unique_ptr<MatrixOp<T>> op, 
+                                      size_t &elided) {
+  return MatrixOp<T>::optimize(std::move(op), elided);
+}
+
 template<typename T>
 class NoOp : public MatrixOp<T> {
   Matrix<T> A;
@@ -230,6 +653,8 @@ public:
 
   size_t output_space_req()  const override {return 0;}
   MatrixDims dims() const override {return A.dims();}
+
+  const Matrix<T>* source() const override {return &A;}
 };
 
 template<typename T>
@@ -260,11 +685,16 @@ public:
 template<typename T>
 class MatrixAccumulate : public MatrixOp<T> {
   T alpha, beta;
-  bool transpose;
+  gpu::blasOperation_t transpose;
 public:
   MatrixAccumulate(std::unique_ptr<MatrixOp<T>> Aop, std::unique_ptr<MatrixOp<T>> Bop,
-                   T alpha, T beta, bool transpose) : MatrixOp<T>({}, 1) ,
-                     alpha(alpha), beta(beta), transpose(transpose) {
+                   T alpha, T beta, bool transpose) 
+    : MatrixAccumulate(std::move(Aop), std::move(Bop), alpha, beta, 
+                       blas_op(transpose)) {}
+
+  MatrixAccumulate(std::unique_ptr<MatrixOp<T>> Aop, std::unique_ptr<MatrixOp<T>> Bop,
+                   T alpha, T beta, gpu::blasOperation_t transpose) 
+    : MatrixOp<T>({}, 1), alpha(alpha), beta(beta), transpose(transpose) {
     int Am = Aop->dims().m;
     int An = Aop->dims().n;
     int Bm = Bop->dims().m;
@@ -274,7 +704,7 @@ public:
     this->operands.push_back(std::move(Bop));
 
     bool bad = false;
-    if (transpose) {
+    if (transpose != gpu::BLAS_OP_N) {
       bad = bad || (Am != Bn || An != Bm);
     } else {
       bad = bad || (Am != Bm || An != Bn);
@@ -283,7 +713,7 @@ public:
     if (bad) {
       std::cout << "Bad matrix accumulate, Adims=" << Am << "," << An
                                       << " Bdims=" << Bm << "," << Bn 
-                               << " " << (transpose ? "trans" : "notrans") << std::endl;
+                               << " " << (transpose != gpu::BLAS_OP_N ? "trans" : "notrans") << std::endl;
       throw;
     }
   }
@@ -299,23 +729,32 @@ public:
       throw "Not enough space";
     }
 
-    auto matrices = this->compute_operands(handle, out_space, scratch_space);
+    auto &matrices = this->compute_operands(handle, out_space, scratch_space);
     Matrix<T> A = matrices[0];
     Matrix<T> B = matrices[1];
 
-    gpuTgeam(handle, transpose, false, A, B, B, alpha, beta);
+    gpuTgeam(handle, transpose, gpu::BLAS_OP_N, A, B, B, alpha, beta);
     return B;
   }
+
+  std::unique_ptr<MatrixOp<T>> simplify(size_t &elided) override {
+    return this->operands[0]->fuse_accumulate(
+        this->operands[1], alpha, beta, transpose, elided);
+  }
 };
 
 template<typename T>
 class MatrixMove : public MatrixOp<T> {
 private:
   T alpha;
-  bool transpose;
+  gpu::blasOperation_t transpose;
   size_t pad;
 public:
   MatrixMove(std::unique_ptr<MatrixOp<T>> Aop, T alpha, bool transpose, size_t pad)
+      : MatrixMove(std::move(Aop), alpha, blas_op(transpose), pad) {}
+
+  MatrixMove(std::unique_ptr<MatrixOp<T>> Aop, T alpha, 
+             gpu::blasOperation_t transpose, size_t pad)
       : MatrixOp<T>({}), alpha(alpha), transpose(transpose), pad(pad) {
     this->operands.push_back(std::move(Aop));
   }
@@ -324,8 +763,9 @@ public:
 
   MatrixDims dims() const override {
     auto &Aop = this->operands[0];
-    size_t m = transpose ? Aop->dims().n : Aop->dims().m;
-    size_t n = transpose ? Aop->dims().m : Aop->dims().n;
+    bool trans = transpose != gpu::BLAS_OP_N;
+    size_t m = trans ? Aop->dims().n : Aop->dims().m;
+    size_t n = trans ? Aop->dims().m : Aop->dims().n;
     size_t ld = ((m+pad-1)/pad)*pad;
     return MatrixDims(m,n,ld);
   };
@@ -336,37 +776,317 @@ public:
       std::cout << "MATRIX MOVE NOT ENOUGH SPACE" << std::endl;
       throw "Not enough space";
     }
-    auto matrices = this->compute_operands(handle, out_space, scratch_space);
+    auto &matrices = this->compute_operands(handle, out_space, scratch_space);
     Matrix<T> A = matrices[0];
     Matrix<T> B(out_space, dims());
 
     T beta = 0.0;
-    gpuTgeam<T>(handle, transpose, false,
+    gpuTgeam<T>(handle, transpose, gpu::BLAS_OP_N,
                 A, B, B, alpha, beta);
     return B;
   }
+
+  // Merge with a move directly below
+  std::unique_ptr<MatrixOp<T>> simplify(size_t &elided) override {
+    auto inner = dynamic_cast<MatrixMove<T>*>(this->operands[0].get());
+    if (!inner) return nullptr;
+
+    auto op = chain(transpose, inner->transpose);
+    if (!op) return nullptr;
+
+    alpha = alpha * through(transpose, inner->alpha);
+    transpose = *op;
+    this->operands[0] = std::move(inner->operands[0]);
+    elided++;
+    return nullptr;
+  }
+
+  bool is_identity() const override {
+    return alpha == T(1.0) && transpose == gpu::BLAS_OP_N && pad == 1;
+  }
+
+  std::optional<Operand_Key> cache_key() const override {
+    if (alpha != T(1.0)) return {};
+    return this->source_key(transpose, pad, 0);
+  }
+
+  T take_scale() override {
+    T scale = alpha;
+    alpha = 1.0;
+    return scale;
+  }
+
+  std::unique_ptr<MatrixOp<T>> fuse_accumulate(
+      std::unique_ptr<MatrixOp<T>> &C, T acc_alpha, T acc_beta, 
+      gpu::blasOperation_t op, size_t &elided) override {
+    auto fused_op = chain(op, transpose);
+    if (!fused_op) return nullptr;
+
+    elided++;
+    return std::make_unique<MatrixAccumulate<T>>(
+        std::move(this->operands[0]), std::move(C), 
+        acc_alpha * through(op, alpha), acc_beta, *fused_op);
+  }
+};
+
+
+// Moves only one triangle of a square matrix, transposing if asked. 
+// lower refers to the triangle of the result, the rest of which is 
+// left unset, so roughly half the bytes of a MatrixMove are moved.
+template<typename T>
+class MatrixMoveTriangle : public MatrixOp<T> {
+  T alpha;
+  gpu::blasOperation_t transpose;
+  bool lower;
+  static constexpr int leaf = 64;
+public:
+  MatrixMoveTriangle(std::unique_ptr<MatrixOp<T>> Aop, T alpha, 
+                     gpu::blasOperation_t transpose, bool lower)
+      : MatrixOp<T>({}), alpha(alpha), transpose(transpose), lower(lower) {
+    if (Aop->dims().m != Aop->dims().n) {
+      std::cout << "Bad triangle move, mA=" << Aop->dims().m 
+                << " nA=" << Aop->dims().n << std::endl;
+      throw;
+    }
+    this->operands.push_back(std::move(Aop));
+  }
+
+  size_t output_space_req() const override { return dims().footprint(); }
+
+  MatrixDims dims() const override {
+    size_t n = this->operands[0]->dims().n;
+    return MatrixDims(n,n,n);
+  }
+
+  Matrix<T> execute(gpu::blasHandle_t handle, Workspace out_space, Workspace scratch_space) override {
+    auto &matrices = this->compute_operands(handle, out_space, scratch_space);
+    Matrix<T> A = matrices[0];
+    Matrix<T> B(out_space, dims());
+
+    bool trans = transpose != gpu::BLAS_OP_N;
+    for_each_triangle_block(B.dims().n, lower, leaf, true, 
+        [&](int r, int c, int m, int n) {
+      Matrix<T> Bblock = B.block(r, c, m, n);
+      Matrix<T> Ablock = trans ? A.block(c, r, n, m) : A.block(r, c, m, n);
+      gpuTgeam<T>(handle, transpose, gpu::BLAS_OP_N, 
+                  Ablock, Bblock, Bblock, alpha, 0.0);
+    });
+    return B;
+  }
+
+  std::optional<Operand_Key> cache_key() const override {
+    if (alpha != T(1.0)) return {};
+    return this->source_key(transpose, 1, lower ? 2 : 1);
+  }
 };
 
+// A transform whose result is kept in an Operand_Cache, so later calls 
+// with the same operand and generation skip it. Space for the result is 
+// still reserved, for copies too large to cache.
+template<typename T>
+class CachedOperand : public MatrixOp<T> {
+  Operand_Cache &cache;
+  Operand_Key key;
+public:
+  CachedOperand(std::unique_ptr<MatrixOp<T>> transform, Operand_Cache &cache,
+                Operand_Key key) 
+      : MatrixOp<T>({}, 0), cache(cache), key(key) {
+    this->operands.push_back(std::move(transform));
+  }
+
+  size_t output_space_req() const override { 
+    return this->operands[0]->output_space_req(); 
+  }
+
+  MatrixDims dims() const override { return this->operands[0]->dims(); }
+
+  Matrix<T> execute(gpu::blasHandle_t handle, Workspace out_space, Workspace scratch_space) override {
+    if (auto hit = cache.find(key))
+      return Matrix<T>(*hit, dims());
+
+    auto &transform = this->operands[0];
+    if (auto space = cache.insert(key, transform->output_space_req()*sizeof(T)))
+      return transform->execute(handle, *space, scratch_space);
+    return transform->execute(handle, out_space, scratch_space);
+  }
+};
+
+template<typename T>
+std::unique_ptr<MatrixOp<T>> MatrixOp<T>::use_cache(
+    std::unique_ptr<MatrixOp<T>> op, Operand_Cache &cache) {
+  if (auto key = op->cache_key())
+    return std::make_unique<CachedOperand<T>>(std::move(op), cache, *key);
+  for (auto &operand : op->operands)
+    operand = use_cache(std::move(operand), cache);
+  return op;
+}
+
+template<typename T>
+std::unique_ptr<MatrixOp<T>> use_cache(std::unique_ptr<MatrixOp<T>> op, 
+                                       Operand_Cache &cache) {
+  return MatrixOp<T>::use_cache(std::move(op), cache);
+}
+
+// B = alpha*op(A) + beta*B on the lower or upper triangle of B only. 
+// Nothing outside the triangle of B is written. Off diagonal blocks are 
+// accumulated directly. Diagonal blocks are accumulated whole into 
+// scratch, reading both operands up to a block either side of the 
+// diagonal, and their triangles copied into B a column at a time, the 
+// same column of every block in one call.
+template<typename T>
+class MatrixAccumulateTriangle : public MatrixOp<T> {
+  T alpha, beta;
+  gpu::blasOperation_t transpose;
+  bool lower;
+  static constexpr int leaf = 32;
+
+  // count columns rows long, stride elements apart
+  static Matrix<T> strided(T *ptr, int rows, int count, size_t stride) {
+    return Matrix<T>(Workspace(ptr, (count-1)*stride + rows), 
+                     rows, count, stride);
+  }
+public:
+  MatrixAccumulateTriangle(std::unique_ptr<MatrixOp<T>> Aop, 
+                           std::unique_ptr<MatrixOp<T>> Bop,
+                           T alpha, T beta, 
+                           gpu::blasOperation_t transpose, bool lower)
+      : MatrixOp<T>({}, 1), alpha(alpha), beta(beta), 
+        transpose(transpose), lower(lower) {
+    if (Aop->dims().m != Aop->dims().n || Bop->dims().m != Bop->dims().n ||
+        Aop->dims().m != Bop->dims().m) {
+      std::cout << "Bad triangle accumulate, Adims=" << Aop->dims().m << "," 
+                << Aop->dims().n << " Bdims=" << Bop->dims().m << "," 
+                << Bop->dims().n << std::endl;
+      throw;
+    }
+    size_t n = Bop->dims().n;
+    this->operands.push_back(std::move(Aop));
+    this->operands.push_back(std::move(Bop));
+    this->operands.push_back(std::make_unique<ScratchMatrix<T>>(leaf, n, leaf));
+  }
+
+  size_t output_space_req() const override { return 0; }
+
+  MatrixDims dims() const override { return this->operands[1]->dims(); }
+
+  Matrix<T> execute(gpu::blasHandle_t handle, Workspace out_space, Workspace scratch_space) override {
+    auto &matrices = this->compute_operands(handle, out_space, scratch_space);
+    Matrix<T> A = matrices[0];
+    Matrix<T> B = matrices[1];
+    Matrix<T> S = matrices[2];
+
+    int n = B.dims().n;
+    bool trans = transpose != gpu::BLAS_OP_N;
+    for_each_triangle_block(n, lower, leaf, false, 
+        [&](int r, int c, int rows, int cols) {
+      Matrix<T> Bblock = B.block(r, c, rows, cols);
+      Matrix<T> Ablock = trans ? A.block(c, r, cols, rows) 
+                               : A.block(r, c, rows, cols);
+      gpuTgeam<T>(handle, transpose, gpu::BLAS_OP_N, 
+                  Ablock, Bblock, Bblock, alpha, beta);
+    });
+
+    // Diagonal block o sits in columns o to o+leaf of S
+    for (int o = 0; o < n; o += leaf) {
+      int size = std::min(leaf, n-o);
+      gpuTgeam<T>(handle, transpose, gpu::BLAS_OP_N, 
+                  A.block(o, o, size, size), B.block(o, o, size, size), 
+                  S.block(0, o, size, size), alpha, beta);
+    }
+
+    size_t ld = B.dims().ld;
+    for_each_diagonal_column(n, lower, leaf, 
+        [&](int r, int c, int m, int count) {
+      int o = c - c%leaf;
+      Matrix<T> from = strided(S.ptr() + (r-o) + (size_t)c*leaf, m, count, 
+                               (size_t)leaf*leaf);
+      Matrix<T> to = strided(B.ptr() + r + c*ld, m, count, leaf*(ld+1));
+      gpuTgeam<T>(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, 
+                  from, to, to, 1.0, 0.0);
+    });
+    return B;
+  }
+};
+
+// Transposes a square matrix in place, one pair of tiles at a time, 
+// so only a single tile of scratch is needed.
+template<typename T>
+class MatrixTransposeInPlace : public MatrixOp<T> {
+  gpu::blasOperation_t kind;
+  size_t tile;
+public:
+  MatrixTransposeInPlace(std::unique_ptr<MatrixOp<T>> Aop, 
+                         gpu::blasOperation_t kind, size_t tile)
+      : MatrixOp<T>({}, 0), kind(kind), 
+        tile(std::min(tile, Aop->dims().m)) {
+    if (Aop->dims().m != Aop->dims().n) {
+      std::cout << "Bad in place transpose, mA=" << Aop->dims().m 
+                << " nA=" << Aop->dims().n << std::endl;
+      throw;
+    }
+
+    this->operands.push_back(std::move(Aop));
+    this->operands.push_back(std::make_unique<ScratchMatrix<T>>(
+          this->tile, this->tile, std::max<size_t>(this->tile, 1)));
+  }
+
+  size_t output_space_req() const override { return 0; }
+
+  MatrixDims dims() const override { return this->operands[0]->dims(); }
+
+  Matrix<T> execute(gpu::blasHandle_t handle, Workspace out_space, Workspace scratch_space) override {
+    auto &matrices = this->compute_operands(handle, out_space, scratch_space);
+    Matrix<T> A = matrices[0];
+    Matrix<T> S = matrices[1];
+
+    int n = A.dims().m;
+    int b = tile;
+    for (int i = 0; i < n; i += b) {
+      for (int j = i; j < n; j += b) {
+        int mi = std::min(b, n-i);
+        int nj = std::min(b, n-j);
+        Matrix<T> Aij = A.block(i, j, mi, nj);
+        Matrix<T> Aji = A.block(j, i, nj, mi);
+        Matrix<T> Sji = S.block(0, 0, nj, mi);
+
+        // S = op(Aij), Aij = op(Aji), Aji = S
+        gpuTgeam<T>(handle, kind, gpu::BLAS_OP_N, Aij, Sji, Sji, 1.0, 0.0);
+        if (i != j)
+          gpuTgeam<T>(handle, kind, gpu::BLAS_OP_N, Aji, Aij, Aij, 1.0, 0.0);
+        gpuTgeam<T>(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, 
+                    Sji, Aji, Aji, 1.0, 0.0);
+      }
+    }
+    return A;
+  }
+};
 
 template<typename T>
 class MatrixMult : public MatrixOp<T> {
 protected:
-  bool transa, transb;
+  gpu::blasOperation_t transa, transb;
   T alpha, beta;
 public:
   virtual ~MatrixMult() = default;
   MatrixMult(std::unique_ptr<MatrixOp<T>> Aop, std::unique_ptr<MatrixOp<T>> Bop,
              std::unique_ptr<MatrixOp<T>> Cop, bool transa, bool transb, 
+             T alpha, T beta) 
+    : MatrixMult(std::move(Aop), std::move(Bop), std::move(Cop), 
+                 blas_op(transa), blas_op(transb), alpha, beta) {}
+
+  MatrixMult(std::unique_ptr<MatrixOp<T>> Aop, std::unique_ptr<MatrixOp<T>> Bop,
+             std::unique_ptr<MatrixOp<T>> Cop, 
+             gpu::blasOperation_t transa, gpu::blasOperation_t transb, 
              T alpha, T beta) : MatrixOp<T>({}, 2), transa(transa), transb(transb),
                                           alpha(alpha), beta(beta) {
-    int kA = transa ? Aop->dims().m : Aop->dims().n;
-    int kB = transb ? Bop->dims().n : Bop->dims().m;
+    int kA = (transa != gpu::BLAS_OP_N) ? Aop->dims().m : Aop->dims().n;
+    int kB = (transb != gpu::BLAS_OP_N) ? Bop->dims().n : Bop->dims().m;
     if (kA != kB) {
       std::cout << "Bad matrix mult, kA=" << kA << " kB=" << kB << std::endl;
       throw;
     }
-    size_t mA = transa ? Aop->dims().n : Aop->dims().m;
-    size_t nB = transb ? Bop->dims().m : Bop->dims().n;
+    size_t mA = (transa != gpu::BLAS_OP_N) ? Aop->dims().n : Aop->dims().m;
+    size_t nB = (transb != gpu::BLAS_OP_N) ? Bop->dims().m : Bop->dims().n;
     if (mA != Cop->dims().m || nB != Cop->dims().n) {
       std::cout << "Bad matrix mult, mA=" << mA << ", mC=" << Cop->dims().m
                 <<                ", nB=" << nB << ", nC=" << Cop->dims().n << std::endl;
@@ -386,7 +1106,7 @@ public:
 
   virtual Matrix<T> execute(gpu::blasHandle_t handle, Workspace out_space, Workspace scratch_space) override {
 
-    auto matrices = this->compute_operands(handle, out_space, scratch_space);
+    auto &matrices = this->compute_operands(handle, out_space, scratch_space);
 
     Matrix<T> &A = matrices[0];
     Matrix<T> &B = matrices[1];
@@ -396,19 +1116,33 @@ public:
     return C;
   }
 
+  // Fold scalings of A and B into alpha
+  std::unique_ptr<MatrixOp<T>> simplify([[maybe_unused]] size_t &elided) override {
+    alpha = alpha * through(transa, this->operands[0]->take_scale());
+    alpha = alpha * through(transb, this->operands[1]->take_scale());
+    return nullptr;
+  }
+
 };
 
 template<typename T>
 class MatrixMultAlloc : public MatrixOp<T> {
-  bool transa, transb;
+protected:
+  gpu::blasOperation_t transa, transb;
   T alpha;
   size_t pad;
 public:
   MatrixMultAlloc(std::unique_ptr<MatrixOp<T>> Aop, std::unique_ptr<MatrixOp<T>> Bop,
                   bool transa, bool transb, T alpha, size_t pad) 
+              : MatrixMultAlloc(std::move(Aop), std::move(Bop), 
+                                blas_op(transa), blas_op(transb), alpha, pad) {}
+
+  MatrixMultAlloc(std::unique_ptr<MatrixOp<T>> Aop, std::unique_ptr<MatrixOp<T>> Bop,
+                  gpu::blasOperation_t transa, gpu::blasOperation_t transb, 
+                  T alpha, size_t pad) 
               : MatrixOp<T>({}), transa(transa), transb(transb), alpha(alpha), pad(pad) {
-    int kA = transa ? Aop->dims().m : Aop->dims().n;
-    int kB = transb ? Bop->dims().n : Bop->dims().m;
+    int kA = (transa != gpu::BLAS_OP_N) ? Aop->dims().m : Aop->dims().n;
+    int kB = (transb != gpu::BLAS_OP_N) ? Bop->dims().n : Bop->dims().m;
     if (kA != kB) {
       std::cout << "Bad matrix mult, kA=" << kA << " kB=" << kB << std::endl;
       throw;
@@ -421,8 +1155,8 @@ public:
   MatrixDims dims() const override {
     auto &Aop = this->operands[0];
     auto &Bop = this->operands[1];
-    size_t m = transa ? Aop->dims().n : Aop->dims().m;
-    size_t n = transb ? Bop->dims().m : Bop->dims().n;
+    size_t m = (transa != gpu::BLAS_OP_N) ? Aop->dims().n : Aop->dims().m;
+    size_t n = (transb != gpu::BLAS_OP_N) ? Bop->dims().m : Bop->dims().n;
     size_t ld = ((m+pad-1)/pad)*pad;
     return MatrixDims(m,n,ld);
   }
@@ -430,7 +1164,7 @@ public:
   size_t output_space_req() const override {return dims().footprint();}
 
   Matrix<T> execute(gpu::blasHandle_t handle, Workspace out_space, Workspace scratch_space) override {
-    auto matrices = this->compute_operands(handle, out_space, scratch_space);
+    auto &matrices = this->compute_operands(handle, out_space, scratch_space);
 
     Matrix<T> &A = matrices[0];
     Matrix<T> &B = matrices[1];
@@ -441,16 +1175,103 @@ public:
     return C;
   }
 
+  std::unique_ptr<MatrixOp<T>> simplify([[maybe_unused]] size_t &elided) override {
+    alpha = alpha * through(transa, this->operands[0]->take_scale());
+    alpha = alpha * through(transb, this->operands[1]->take_scale());
+    return nullptr;
+  }
+
+  // Without padding the scratch result can be computed into C directly
+  std::unique_ptr<MatrixOp<T>> fuse_accumulate(
+      std::unique_ptr<MatrixOp<T>> &C, T acc_alpha, T acc_beta, 
+      gpu::blasOperation_t op, size_t &elided) override {
+    if (op != gpu::BLAS_OP_N || pad != 1) return nullptr;
+
+    elided++;
+    return std::make_unique<MatrixMult<T>>(
+        std::move(this->operands[0]), std::move(this->operands[1]), 
+        std::move(C), transa, transb, acc_alpha * alpha, acc_beta);
+  }
+
+};
+
+// Variants of MatrixMult and MatrixMultAlloc that round A and B to a 
+// reduced precision compute type.
+template<typename T>
+class MatrixMultLowered : public MatrixMult<T> {
+  gpu::blasComputeType_t compute;
+public:
+  MatrixMultLowered(std::unique_ptr<MatrixOp<T>> Aop, std::unique_ptr<MatrixOp<T>> Bop,
+                    std::unique_ptr<MatrixOp<T>> Cop, 
+                    gpu::blasOperation_t transa, gpu::blasOperation_t transb, 
+                    T alpha, T beta, gpu::blasComputeType_t compute) 
+              : MatrixMult<T>(std::move(Aop), std::move(Bop), std::move(Cop),
+                              transa, transb, alpha, beta), compute(compute) {}
+
+  Matrix<T> execute(gpu::blasHandle_t handle, Workspace out_space, Workspace scratch_space) override {
+    auto &matrices = this->compute_operands(handle, out_space, scratch_space);
+
+    Matrix<T> &A = matrices[0];
+    Matrix<T> &B = matrices[1];
+    Matrix<T> &C = matrices[2];
+
+    gpuTgemmEx<T>(handle, this->transa, this->transb, A, B, C, 
+                  this->alpha, this->beta, compute);
+    return C;
+  }
+};
+
+template<typename T>
+class MatrixMultAllocLowered : public MatrixMultAlloc<T> {
+  gpu::blasComputeType_t compute;
+public:
+  MatrixMultAllocLowered(std::unique_ptr<MatrixOp<T>> Aop, std::unique_ptr<MatrixOp<T>> Bop,
+                         gpu::blasOperation_t transa, gpu::blasOperation_t transb, 
+                         T alpha, size_t pad, gpu::blasComputeType_t compute) 
+              : MatrixMultAlloc<T>(std::move(Aop), std::move(Bop), 
+                                   transa, transb, alpha, pad), compute(compute) {}
+
+  Matrix<T> execute(gpu::blasHandle_t handle, Workspace out_space, Workspace scratch_space) override {
+    auto &matrices = this->compute_operands(handle, out_space, scratch_space);
+
+    Matrix<T> &A = matrices[0];
+    Matrix<T> &B = matrices[1];
+    Matrix<T> C(out_space, this->dims());
+
+    T beta = 0.0;
+    gpuTgemmEx<T>(handle, this->transa, this->transb, A, B, C, 
+                  this->alpha, beta, compute);
+    return C;
+  }
+
+  std::unique_ptr<MatrixOp<T>> fuse_accumulate(
+      std::unique_ptr<MatrixOp<T>> &C, T acc_alpha, T acc_beta, 
+      gpu::blasOperation_t op, size_t &elided) override {
+    if (op != gpu::BLAS_OP_N || this->pad != 1) return nullptr;
+
+    elided++;
+    return std::make_unique<MatrixMultLowered<T>>(
+        std::move(this->operands[0]), std::move(this->operands[1]), 
+        std::move(C), this->transa, this->transb, 
+        acc_alpha * this->alpha, acc_beta, compute);
+  }
 };
 
 template<typename T>
 class MatrixTrs : public MatrixOp<T> {
 protected:
-  bool side_left, lower, trans, unit_diag;
+  bool side_left, lower;
+  gpu::blasOperation_t trans;
+  bool unit_diag;
   T alpha;
 public:
   MatrixTrs(std::unique_ptr<MatrixOp<T>> Aop, std::unique_ptr<MatrixOp<T>> Bop,
       bool side_left, bool lower, bool trans, bool unit_diag,
+             T alpha) : MatrixTrs(std::move(Aop), std::move(Bop), side_left, 
+                                  lower, blas_op(trans), unit_diag, alpha) {}
+
+  MatrixTrs(std::unique_ptr<MatrixOp<T>> Aop, std::unique_ptr<MatrixOp<T>> Bop,
+      bool side_left, bool lower, gpu::blasOperation_t trans, bool unit_diag,
              T alpha) : MatrixOp<T>({}, 1), side_left(side_left),
                         lower(lower), trans(trans), 
                         unit_diag(unit_diag), alpha(alpha) {
@@ -478,7 +1299,7 @@ public:
 
   virtual Matrix<T> execute(gpu::blasHandle_t handle, Workspace out_space, Workspace scratch_space) override {
 
-    auto matrices = this->compute_operands(handle, out_space, scratch_space);
+    auto &matrices = this->compute_operands(handle, out_space, scratch_space);
 
     Matrix<T> &A = matrices[0];
     Matrix<T> &B = matrices[1];
@@ -492,12 +1313,20 @@ public:
 template<typename T>
 class MatrixTrsAlloc : public MatrixOp<T> {
 protected:
-  bool side_left, lower, trans, unit_diag;
+  bool side_left, lower;
+  gpu::blasOperation_t trans;
+  bool unit_diag;
   T alpha;
   size_t pad;
 public:
   MatrixTrsAlloc(std::unique_ptr<MatrixOp<T>> Aop, std::unique_ptr<MatrixOp<T>> Bop,
       bool side_left, bool lower, bool trans, bool unit_diag,
+             T alpha, size_t pad = 1) 
+    : MatrixTrsAlloc(std::move(Aop), std::move(Bop), side_left, lower, 
+                     blas_op(trans), unit_diag, alpha, pad) {}
+
+  MatrixTrsAlloc(std::unique_ptr<MatrixOp<T>> Aop, std::unique_ptr<MatrixOp<T>> Bop,
+      bool side_left, bool lower, gpu::blasOperation_t trans, bool unit_diag,
              T alpha, size_t pad = 1) : MatrixOp<T>({},1), side_left(side_left),
                         lower(lower), trans(trans), 
                         unit_diag(unit_diag), alpha(alpha), pad(pad) {
@@ -526,7 +1355,7 @@ public:
 
   virtual Matrix<T> execute(gpu::blasHandle_t handle, Workspace out_space, Workspace scratch_space) override {
 
-    auto matrices = this->compute_operands(handle, out_space, scratch_space);
+    auto &matrices = this->compute_operands(handle, out_space, scratch_space);
 
     Matrix<T> &A = matrices[0];
     Matrix<T> &B = matrices[1];
@@ -540,16 +1369,22 @@ public:
 template<typename T>
 class MatrixSyrk : public MatrixOp<T> {
 protected:
-  bool lower, trans;
+  bool lower;
+  gpu::blasOperation_t trans;
   T alpha;
   T beta;
 public:
   MatrixSyrk(std::unique_ptr<MatrixOp<T>> Aop, std::unique_ptr<MatrixOp<T>> Cop,
       bool lower, bool trans, T alpha, T beta) 
+    : MatrixSyrk(std::move(Aop), std::move(Cop), lower, blas_op(trans), 
+                 alpha, beta) {}
+
+  MatrixSyrk(std::unique_ptr<MatrixOp<T>> Aop, std::unique_ptr<MatrixOp<T>> Cop,
+      bool lower, gpu::blasOperation_t trans, T alpha, T beta) 
     : MatrixOp<T>({}, 1), lower(lower), trans(trans), 
       alpha(alpha), beta(beta) {
     size_t n = Cop->dims().n;
-    size_t nA = trans ? Aop->dims().n : Aop->dims().m;
+    size_t nA = (trans != gpu::BLAS_OP_N) ? Aop->dims().n : Aop->dims().m;
     if ((n != nA) || 
         (Cop->dims().m != Cop->dims().n)) {
       std::cout << "Bad matrix trs, mA=" << Aop->dims().m << " nA=" << Aop->dims().n << std::endl;
@@ -570,7 +1405,7 @@ public:
 
   virtual Matrix<T> execute(gpu::blasHandle_t handle, Workspace out_space, Workspace scratch_space) override {
 
-    auto matrices = this->compute_operands(handle, out_space, scratch_space);
+    auto &matrices = this->compute_operands(handle, out_space, scratch_space);
 
     Matrix<T> &A = matrices[0];
     Matrix<T> &C = matrices[1];
@@ -581,24 +1416,33 @@ public:
 
 };
 
+// zero_fill clears the unreferenced triangle, which is only needed if 
+// the consumer reads the whole matrix.
 template<typename T>
 class MatrixSyrkAlloc : public MatrixOp<T> {
 protected:
-  bool lower, trans;
+  bool lower;
+  gpu::blasOperation_t trans;
   T alpha;
   size_t pad = 1;
+  bool zero_fill = true;
 public:
   MatrixSyrkAlloc(std::unique_ptr<MatrixOp<T>> Aop,
       bool lower, bool trans, T alpha, size_t pad = 1) 
+    : MatrixSyrkAlloc(std::move(Aop), lower, blas_op(trans), alpha, pad) {}
+
+  MatrixSyrkAlloc(std::unique_ptr<MatrixOp<T>> Aop,
+      bool lower, gpu::blasOperation_t trans, T alpha, size_t pad = 1,
+      bool zero_fill = true) 
     : MatrixOp<T>({}), lower(lower), trans(trans), 
-      alpha(alpha), pad(pad) {
+      alpha(alpha), pad(pad), zero_fill(zero_fill) {
     
     this->operands.push_back(std::move(Aop));
   }
 
   MatrixDims dims() const override {
     auto &Aop = this->operands[0];
-    size_t n = trans ? Aop->dims().n : Aop->dims().m;
+    size_t n = (trans != gpu::BLAS_OP_N) ? Aop->dims().n : Aop->dims().m;
     size_t ld = ((n+pad-1)/pad)*pad;
     return MatrixDims(n,n,ld);
   }
@@ -607,17 +1451,88 @@ public:
 
   virtual Matrix<T> execute(gpu::blasHandle_t handle, Workspace out_space, Workspace scratch_space) override {
 
-    auto matrices = this->compute_operands(handle, out_space, scratch_space);
+    auto &matrices = this->compute_operands(handle, out_space, scratch_space);
 
     Matrix<T> &A = matrices[0];
     Matrix<T> C(out_space, dims());
 
-    // Zero out C?
-    gpuTgeam<T>(handle, false, false, C, C, C, 0.0, 0.0);
+    if (zero_fill)
+      gpuTgeam<T>(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, C, C, C, 0.0, 0.0);
     gpuTsyrk<T>(handle, lower, trans, A, C, alpha, 0.0);
     return C;
   }
 
+  // The zero fill only exists so the unreferenced triangle accumulates 
+  // as zero. When C is overwritten (beta == 0), the result is symmetric 
+  // and can be written straight into the matching triangle of C, 
+  // skipping both the fill and the accumulate.
+  std::unique_ptr<MatrixOp<T>> fuse_accumulate(
+      std::unique_ptr<MatrixOp<T>> &C, T acc_alpha, T acc_beta, 
+      gpu::blasOperation_t op, size_t &elided) override {
+    if (acc_beta != T(0.0) || op == gpu::BLAS_OP_C) return nullptr;
+
+    elided += zero_fill ? 2 : 1;
+    return std::make_unique<MatrixSyrk<T>>(
+        std::move(this->operands[0]), std::move(C), 
+        (op == gpu::BLAS_OP_N) ? lower : !lower, trans, 
+        acc_alpha * alpha, 0.0);
+  }
+
+};
+
+// Hermitian variants of the above, alpha and beta must be real
+template<typename T>
+class MatrixHerk : public MatrixSyrk<T> {
+public:
+  using MatrixSyrk<T>::MatrixSyrk;
+
+  Matrix<T> execute(gpu::blasHandle_t handle, Workspace out_space, Workspace scratch_space) override {
+
+    auto &matrices = this->compute_operands(handle, out_space, scratch_space);
+
+    Matrix<T> &A = matrices[0];
+    Matrix<T> &C = matrices[1];
+
+    gpuTherk<T>(handle, this->lower, this->trans, A, C, 
+                std::real(this->alpha), std::real(this->beta));
+    return C;
+  }
+};
+
+template<typename T>
+class MatrixHerkAlloc : public MatrixSyrkAlloc<T> {
+public:
+  using MatrixSyrkAlloc<T>::MatrixSyrkAlloc;
+
+  Matrix<T> execute(gpu::blasHandle_t handle, Workspace out_space, Workspace scratch_space) override {
+
+    auto &matrices = this->compute_operands(handle, out_space, scratch_space);
+
+    Matrix<T> &A = matrices[0];
+    Matrix<T> C(out_space, this->dims());
+
+    if (this->zero_fill)
+      gpuTgeam<T>(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, C, C, C, 0.0, 0.0);
+    gpuTherk<T>(handle, this->lower, this->trans, A, C, 
+                std::real(this->alpha), 0.0);
+    return C;
+  }
+
+  // As for SYRK, but Hermitian so the transpose must be conjugate and 
+  // the combined scale must stay real
+  std::unique_ptr<MatrixOp<T>> fuse_accumulate(
+      std::unique_ptr<MatrixOp<T>> &C, T acc_alpha, T acc_beta, 
+      gpu::blasOperation_t op, size_t &elided) override {
+    T scale = acc_alpha * this->alpha;
+    if (acc_beta != T(0.0) || std::imag(scale) != 0) return nullptr;
+    if (is_complex_v<T> && op == gpu::BLAS_OP_T) return nullptr;
+
+    elided += this->zero_fill ? 2 : 1;
+    return std::make_unique<MatrixHerk<T>>(
+        std::move(this->operands[0]), std::move(C), 
+        (op == gpu::BLAS_OP_N) ? this->lower : !this->lower, this->trans, 
+        scale, 0.0);
+  }
 };
 
 // template<typename T>
@@ -705,7 +1620,7 @@ public:
 
   Matrix<T> execute(gpu::blasHandle_t handle, Workspace out_space, Workspace scratch_space) override {
 
-    auto matrices = this->compute_operands(handle, out_space, scratch_space);
+    auto &matrices = this->compute_operands(handle, out_space, scratch_space);
 
     Matrix<T> &A = matrices[0];
     Matrix<T> &B = matrices[1];
@@ -713,7 +1628,7 @@ public:
 
     int m = C.dims().m;
     int n = C.dims().n;
-    int k = this->transa ? A.dims().m : A.dims().n;
+    int k = (this->transa != gpu::BLAS_OP_N) ? A.dims().m : A.dims().n;
 
     for (int a = 0; a < m; a += mblock) {
       for (int b = 0; b < n; b += nblock) {
@@ -737,4 +1652,337 @@ public:
 };
 
 
+// GEMM with C split into row or column panels across a team of devices.
+// The calling device computes its share in place. Every other member 
+// receives a copy of the operand all panels need, then streams panels 
+// of the other operand and of C through two buffers on two streams, so 
+// the copies for one panel overlap the multiplication of the previous. 
+// home_share weights the calling device's share against the others', 
+// which each get theirs in panels pieces.
+template<typename T>
+class DistributedMatrixMult : public MatrixMult<T> {
+  Device_Team &team;
+  bool split_rows;
+  double home_share;
+  int panels;
+
+  // The part of op(A) (rows) or op(B) (columns) that a panel needs
+  Matrix<T> operand_panel(Matrix<T> &A, Matrix<T> &B, int k, int start, int width) {
+    if (split_rows) {
+      return (this->transa == gpu::BLAS_OP_N) ? A.block(start, 0, width, k)
+                                              : A.block(0, start, k, width);
+    } else {
+      return (this->transb == gpu::BLAS_OP_N) ? B.block(0, start, k, width)
+                                              : B.block(start, 0, width, k);
+    }
+  }
+
+  Matrix<T> output_panel(Matrix<T> &C, int start, int width) {
+    return split_rows ? C.block(start, 0, width, C.dims().n)
+                      : C.block(0, start, C.dims().m, width);
+  }
+
+  void multiply(gpu::blasHandle_t handle, Matrix<T> panel, Matrix<T> whole, 
+                Matrix<T> C, T beta) {
+    if (split_rows) {
+      gpuTgemm<T>(handle, this->transa, this->transb, panel, whole, C, this->alpha, beta);
+    } else {
+      gpuTgemm<T>(handle, this->transa, this->transb, whole, panel, C, this->alpha, beta);
+    }
+  }
+
+public:
+  DistributedMatrixMult(std::unique_ptr<MatrixOp<T>> Aop, std::unique_ptr<MatrixOp<T>> Bop,
+                        std::unique_ptr<MatrixOp<T>> Cop, 
+                        gpu::blasOperation_t transa, gpu::blasOperation_t transb, 
+                        T alpha, T beta, Device_Team &team, 
+                        bool split_rows, double home_share, int panels)
+        : MatrixMult<T>(std::move(Aop), std::move(Bop), std::move(Cop), 
+                        transa, transb, alpha, beta),
+          team(team), split_rows(split_rows), home_share(home_share), panels(panels) {}
+
+  Matrix<T> execute(gpu::blasHandle_t handle, Workspace out_space, Workspace scratch_space) override {
+
+    auto &matrices = this->compute_operands(handle, out_space, scratch_space);
+
+    Matrix<T> &A = matrices[0];
+    Matrix<T> &B = matrices[1];
+    Matrix<T> &C = matrices[2];
+
+    int extent = split_rows ? C.dims().m : C.dims().n;
+    int k = (this->transa != gpu::BLAS_OP_N) ? A.dims().m : A.dims().n;
+
+    // Panel boundaries, the calling device's share first
+    int remote = team.size() - 1;
+    double total = home_share + remote;
+    std::vector<int> bounds = {0};
+    bounds.push_back(std::lround(extent*home_share/total));
+    for (int r = 0; r < remote; r++)
+      for (int p = 1; p <= panels; p++)
+        bounds.push_back(std::lround(extent*(home_share + r + (double)p/panels)/total));
+    bounds.back() = extent;
+
+    int widest = 0;
+    for (size_t i = 1; i+1 < bounds.size(); i++)
+      widest = std::max(widest, bounds[i+1] - bounds[i]);
+
+    int home;
+    gpuAssert(gpu::GetDevice(&home));
+    gpu::Stream_t home_stream;
+    gpu::blasGetStream(handle, &home_stream);
+
+    // Remote copies must follow the work producing the operands
+    Event ready;
+    ready.record(home_stream);
+
+    Matrix<T> whole = split_rows ? B : A;
+    size_t whole_size = whole.dims().m*whole.dims().n;
+    auto widest_panel = operand_panel(A, B, k, 0, widest).dims();
+    auto widest_output = output_panel(C, 0, widest).dims();
+    size_t slot_size = widest_panel.m*widest_panel.n + widest_output.m*widest_output.n;
+
+    std::vector<Event> done;
+    for (int r = 1; r <= remote && widest > 0; r++) {
+      auto &member = team[r];
+      gpuAssert(gpu::SetDevice(member.device));
+      member.space.template grow_to_fit<T>(whole_size + 2*slot_size);
+
+      Workspace space = member.space;
+      Matrix<T> whole_copy(space.peel<T>(whole_size), 
+                           whole.dims().m, whole.dims().n, whole.dims().m);
+      Workspace slots[2] = {space.peel<T>(slot_size), space.peel<T>(slot_size)};
+
+      for (auto &stream : member.streams) stream.wait_event(ready);
+      gpuAssert(gpuTcopy<T>(whole_copy, whole, member.streams[0]));
+      Event staged;
+      staged.record(member.streams[0]);
+      member.streams[1].wait_event(staged);
+
+      for (int p = 0; p < panels; p++) {
+        int first = 1 + (r-1)*panels + p;
+        int start = bounds[first];
+        int width = bounds[first+1] - start;
+        if (width == 0) continue;
+
+        Stream &stream = member.streams[p%2];
+        BLAS_Handle &member_handle = member.handles[p%2];
+        Workspace slot = slots[p%2];
+        Matrix<T> panel = operand_panel(A, B, k, start, width);
+        Matrix<T> output = output_panel(C, start, width);
+        Matrix<T> panel_copy(slot.peel<T>(panel.dims().m*panel.dims().n),
+                             panel.dims().m, panel.dims().n, panel.dims().m);
+        Matrix<T> output_copy(slot.peel<T>(output.dims().m*output.dims().n),
+                              output.dims().m, output.dims().n, output.dims().m);
+
+        gpuAssert(gpuTcopy<T>(panel_copy, panel, stream));
+        if (this->beta != T(0.0))
+          gpuAssert(gpuTcopy<T>(output_copy, output, stream));
+        multiply(member_handle, panel_copy, whole_copy, output_copy, this->beta);
+        gpuAssert(gpuTcopy<T>(output, output_copy, stream));
+      }
+
+      for (auto &stream : member.streams) {
+        done.emplace_back();
+        done.back().record(stream);
+      }
+    }
+    gpuAssert(gpu::SetDevice(home));
+
+    if (bounds[1] > 0) {
+      multiply(handle, operand_panel(A, B, k, 0, bounds[1]), whole,
+               output_panel(C, 0, bounds[1]), this->beta);
+    }
+
+    // The operation completes in the order of the calling stream
+    for (auto &event : done)
+      gpuAssert(gpu::StreamWaitEvent(home_stream, event, 0));
+    return C;
+  }
+};
+
+// Pinned staging memory and a copy engine for host resident operations, 
+// kept between calls as pinned allocation is slow
+struct Host_Staging {
+  Pinned_Buffer<char> space;
+  Copy_Engine copies;
+};
+
+// GEMM on host resident A, B and C, for problems larger than device 
+// memory. C is computed one tile square at a time, accumulated over tile 
+// wide chunks of k. Operand tiles are gathered into pinned staging and 
+// uploaded on their own stream through a ring of depth buffers, so the 
+// uploads run up to depth-1 chunks ahead of the multiplications. C tiles 
+// alternate between two buffers, so each download overlaps the next 
+// tile's work. The device buffers are this node's scratch space.
+template<typename T>
+class OutOfCoreMatrixMult : public MatrixMult<T> {
+  std::shared_ptr<Host_Staging> staging;
+  int depth;
+  int mt, nt, kt;
+
+  Matrix<T> A_tile(Matrix<T> &A, int i, int l, int rows, int chunk) {
+    return (this->transa == gpu::BLAS_OP_N) ? A.block(i, l, rows, chunk)
+                                            : A.block(l, i, chunk, rows);
+  }
+
+  Matrix<T> B_tile(Matrix<T> &B, int l, int j, int chunk, int cols) {
+    return (this->transb == gpu::BLAS_OP_N) ? B.block(l, j, chunk, cols)
+                                            : B.block(j, l, cols, chunk);
+  }
+
+  // A packed matrix shaped like M, on the front of space
+  static Matrix<T> packed(Workspace space, MatrixDims M) {
+    return Matrix<T>(Workspace((T*)space, M.m*M.n), M.m, M.n, M.m);
+  }
+
+  size_t operand_buffer() const { return (size_t)mt*kt + (size_t)kt*nt; }
+  size_t output_buffer() const { return (size_t)mt*nt; }
+  size_t buffer_size() const { return depth*operand_buffer() + 2*output_buffer(); }
+
+public:
+  OutOfCoreMatrixMult(std::unique_ptr<MatrixOp<T>> Aop, std::unique_ptr<MatrixOp<T>> Bop,
+                      std::unique_ptr<MatrixOp<T>> Cop, 
+                      gpu::blasOperation_t transa, gpu::blasOperation_t transb, 
+                      T alpha, T beta, std::shared_ptr<Host_Staging> staging, 
+                      int tile, int depth)
+        : MatrixMult<T>(std::move(Aop), std::move(Bop), std::move(Cop), 
+                        transa, transb, alpha, beta),
+          staging(staging), depth(depth) {
+    auto A = this->operands[0]->dims();
+    mt = std::min<int>(tile, this->dims().m);
+    nt = std::min<int>(tile, this->dims().n);
+    kt = std::min<int>(tile, (transa != gpu::BLAS_OP_N) ? A.m : A.n);
+    this->operands.push_back(std::make_unique<ScratchMatrix<T>>(buffer_size(), 1, buffer_size()));
+  }
+
+  Matrix<T> execute(gpu::blasHandle_t handle, Workspace out_space, Workspace scratch_space) override {
+
+    auto &matrices = this->compute_operands(handle, out_space, scratch_space);
+
+    Matrix<T> &A = matrices[0];
+    Matrix<T> &B = matrices[1];
+    Matrix<T> &C = matrices[2];
+    Workspace device(matrices[3].ptr(), buffer_size());
+
+    int m = C.dims().m;
+    int n = C.dims().n;
+    int k = (this->transa != gpu::BLAS_OP_N) ? A.dims().m : A.dims().n;
+
+    gpu::Stream_t compute_stream;
+    gpu::blasGetStream(handle, &compute_stream);
+    Stream compute(compute_stream);
+
+    // Without k there is nothing to multiply, C is only scaled by beta,
+    // which is done on the host rather than round tripping tiles that no
+    // GEMM would write
+    if (k == 0) {
+      compute.synchronize();
+      for (int j = 0; j < n; j++) {
+        T *column = C.ptr() + (size_t)j*C.dims().ld;
+        for (int i = 0; i < m; i++)
+          column[i] = (this->beta == T(0.0)) ? T(0.0) : this->beta*column[i];
+      }
+      return C;
+    }
+
+    staging->space.grow_to_fit(buffer_size()*sizeof(T));
+    Workspace host(staging->space.data(), staging->space.size());
+    Copy_Engine &copies = staging->copies;
+
+    struct Slot {
+      Workspace device, host;
+      Event uploaded, consumed;
+      bool used = false;
+    };
+    std::vector<Slot> ring(depth);
+    for (auto &slot : ring) {
+      slot.device = device.peel<T>(operand_buffer());
+      slot.host = host.peel<T>(operand_buffer());
+    }
+
+    struct Output_Slot {
+      Workspace device, host;
+      Event uploaded, computed, downloaded;
+      std::optional<Matrix<T>> pending;
+    };
+    Output_Slot outputs[2];
+    for (auto &slot : outputs) {
+      slot.device = device.peel<T>(output_buffer());
+      slot.host = host.peel<T>(output_buffer());
+    }
+
+    // Write a downloaded C tile back once its copy has finished
+    auto retire = [&](Output_Slot &slot) {
+      if (!slot.pending) return;
+      slot.downloaded.synchronize();
+      host_copy<T>(*slot.pending, packed(slot.host, slot.pending->dims()));
+      slot.pending.reset();
+    };
+
+    // Operands must be ready before the first upload
+    Event ready;
+    ready.record(compute);
+    copies.upload_after(ready);
+
+    size_t step = 0;
+    int count = 0;
+    for (int j = 0; j < n; j += nt) {
+      for (int i = 0; i < m; i += mt, count++) {
+        int rows = std::min(mt, m-i);
+        int cols = std::min(nt, n-j);
+        Output_Slot &out = outputs[count%2];
+        retire(out);
+
+        Matrix<T> C_tile = C.block(i, j, rows, cols);
+        Matrix<T> C_device = packed(out.device, C_tile.dims());
+        if (this->beta != T(0.0)) {
+          host_copy<T>(packed(out.host, C_tile.dims()), C_tile);
+          out.uploaded = copies.to_device(C_device.ptr(), (T*)out.host, 
+                                          rows*cols*sizeof(T));
+          compute.wait_event(out.uploaded);
+        }
+
+        for (int l = 0; l < k; l += kt, step++) {
+          int chunk = std::min(kt, k-l);
+          Slot &slot = ring[step%depth];
+
+          // The staging buffer is free once its last upload is done
+          if (slot.used) slot.uploaded.synchronize();
+          Matrix<T> A_part = A_tile(A, i, l, rows, chunk);
+          Matrix<T> B_part = B_tile(B, l, j, chunk, cols);
+          Workspace host_slot = slot.host;
+          Workspace device_slot = slot.device;
+          size_t A_size = A_part.dims().m*A_part.dims().n;
+          Matrix<T> A_host = packed(host_slot.peel<T>(A_size), A_part.dims());
+          Matrix<T> B_host = packed(host_slot, B_part.dims());
+          Matrix<T> A_device = packed(device_slot.peel<T>(A_size), A_part.dims());
+          Matrix<T> B_device = packed(device_slot, B_part.dims());
+          host_copy<T>(A_host, A_part);
+          host_copy<T>(B_host, B_part);
+
+          if (slot.used) copies.upload_after(slot.consumed);
+          copies.to_device(A_device.ptr(), A_host.ptr(), A_size*sizeof(T));
+          slot.uploaded = copies.to_device(B_device.ptr(), B_host.ptr(), 
+              B_host.dims().m*B_host.dims().n*sizeof(T));
+          slot.used = true;
+
+          compute.wait_event(slot.uploaded);
+          gpuTgemm<T>(handle, this->transa, this->transb, A_device, B_device, C_device,
+                      this->alpha, (l == 0) ? this->beta : T(1.0));
+          slot.consumed.record(compute);
+        }
+
+        out.computed.record(compute);
+        copies.download_after(out.computed);
+        out.downloaded = copies.to_host((T*)out.host, C_device.ptr(), 
+                                        rows*cols*sizeof(T));
+        out.pending = C_tile;
+      }
+    }
+
+    for (auto &slot : outputs) retire(slot);
+    return C;
+  }
+};
+
 }
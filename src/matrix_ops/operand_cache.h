@@ -0,0 +1,109 @@
+#pragma once
+#include <gpu-api.h>
+#include "workspace.h"
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <tuple>
+
+namespace rtat {
+
+// A transformed copy of a matrix: which matrix, as of which of the
+// caller's generations, and how it was transformed
+struct Operand_Key {
+  int device;
+  const void *ptr;
+  size_t m, n, ld;
+  uint64_t generation;
+
+  // Transposition, padding of the leading dimension, and for triangular
+  // copies which triangle (0 for whole matrices, 1 upper, 2 lower)
+  int op;
+  size_t pad;
+  int triangle;
+
+  bool operator<(const Operand_Key &o) const {
+    return std::tie(device, ptr, m, n, ld, generation, op, pad, triangle)
+         < std::tie(o.device, o.ptr, o.m, o.n, o.ld, o.generation,
+                    o.op, o.pad, o.triangle);
+  }
+};
+
+// Device memory holding transformed copies of operands the caller has
+// marked unchanged, so calls reusing them skip the transform. Bounded by
+// capacity bytes, evicting the least recently used copy first. Opt in
+// with Planning_System::set_operand_cache.
+class Operand_Cache {
+  struct Entry {
+    Operand_Key key;
+    std::unique_ptr<ManagedWorkspace> space;
+  };
+
+  size_t capacity;
+  size_t used = 0;
+  std::list<Entry> entries;
+  std::map<Operand_Key, std::list<Entry>::iterator> index;
+  std::mutex lock;
+
+  size_t hit_count = 0;
+  size_t miss_count = 0;
+
+public:
+  Operand_Cache(size_t capacity) : capacity(capacity) {}
+
+  Operand_Cache(const Operand_Cache&) = delete;
+  Operand_Cache& operator=(const Operand_Cache&) = delete;
+
+  // The cached copy, if any, marking it most recently used
+  std::optional<Workspace> find(const Operand_Key &key) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto search = index.find(key);
+    if (search == index.end()) {
+      miss_count++;
+      return {};
+    }
+    hit_count++;
+    entries.splice(entries.begin(), entries, search->second);
+    return *search->second->space;
+  }
+
+  // Space for a new copy, evicting as needed. Copies larger than the
+  // whole cache are not kept. Freeing device memory synchronizes, so
+  // evicted copies are no longer being read.
+  std::optional<Workspace> insert(const Operand_Key &key, size_t bytes) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (bytes > capacity) return {};
+
+    if (auto search = index.find(key); search != index.end())
+      erase(search->second);
+    while (used + bytes > capacity)
+      erase(std::prev(entries.end()));
+
+    entries.push_front({key, std::make_unique<ManagedWorkspace>(bytes)});
+    index[key] = entries.begin();
+    used += bytes;
+    return *entries.front().space;
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> guard(lock);
+    while (!entries.empty()) erase(entries.begin());
+  }
+
+  size_t bytes() const { return used; }
+  size_t size() const { return entries.size(); }
+  size_t hits() const { return hit_count; }
+  size_t misses() const { return miss_count; }
+
+private:
+  void erase(std::list<Entry>::iterator entry) {
+    used -= entry->space->size<char>();
+    index.erase(entry->key);
+    entries.erase(entry);
+  }
+};
+
+}
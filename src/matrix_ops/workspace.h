@@ -44,6 +44,13 @@ public:
 
   template<typename T>
   size_t size() {return count/sizeof(T);}
+
+  const char* data() const {return ptr;}
+
+  // Same memory, not same contents
+  bool operator==(const Workspace &other) const {
+    return ptr == other.ptr && count == other.count;
+  }
 };
 
 class ManagedWorkspace : public Workspace {
@@ -98,6 +98,239 @@ public:
   }
 };
 
+// Precision the GEMM operands are rounded to before multiplication.
+// Accumulation always happens in the precision of the output.
+class Precision_Op {
+public:
+  enum _Precision_Op {
+    FULL, TF32, FP16, BF16
+  };
+  _Precision_Op op;
+
+  Precision_Op() : op(FULL) {}
+
+  bool operator==(_Precision_Op o) const { return op == o; }
+  bool operator<(const Precision_Op& o) const { return op < o.op; }
+
+  operator std::string() const {
+    switch (op) {
+      case FULL: return "F";
+      case TF32: return "X";
+      case FP16: return "H";
+      case BF16: return "B";
+    }
+    __builtin_unreachable();
+  }
+
+  Precision_Op(_Precision_Op op) : op(op) {}
+
+  Precision_Op(std::string c) {
+    if (c == "F") {
+      op = FULL;
+    } else if (c == "X") {
+      op = TF32;
+    } else if (c == "H") {
+      op = FP16;
+    } else if (c == "B") {
+      op = BF16;
+    } else {
+      throw std::runtime_error("Invalid Precision_Op string "+c);
+    }
+  }
+
+  std::vector<Precision_Op> enumerate() {
+    return {Precision_Op(FULL), Precision_Op(TF32), 
+            Precision_Op(FP16), Precision_Op(BF16)};
+  }
+};
+
+// Whether a GEMM spread over several devices splits C into row or 
+// column panels
+class Split_Op {
+public:
+  enum _Split_Op {
+    ROWS, COLS
+  };
+  _Split_Op op;
+
+  Split_Op() : op(COLS) {}
+
+  bool operator==(_Split_Op o) const { return op == o; }
+
+  operator std::string() const {
+    switch (op) {
+      case ROWS: return "R";
+      case COLS: return "C";
+    }
+    __builtin_unreachable();
+  }
+
+  Split_Op(_Split_Op op) : op(op) {}
+
+  Split_Op(std::string c) {
+    if (c == "R") {
+      op = ROWS;
+    } else if (c == "C") {
+      op = COLS;
+    } else {
+      throw std::runtime_error("Invalid Split_Op string "+c);
+    }
+  }
+
+  std::vector<Split_Op> enumerate() {
+    return {Split_Op(ROWS), Split_Op(COLS)};
+  }
+};
+
+// Share of a multi-device GEMM kept by the calling device, relative to 
+// each other device. It needs no operand copies, but also does any 
+// work feeding the GEMM.
+class Share_Op {
+public:
+  enum _Share_Op {
+    HALF, EVEN, DOUBLE
+  };
+  _Share_Op op;
+
+  Share_Op() : op(EVEN) {}
+
+  bool operator==(_Share_Op o) const { return op == o; }
+
+  operator std::string() const {
+    switch (op) {
+      case HALF: return "H";
+      case EVEN: return "E";
+      case DOUBLE: return "D";
+    }
+    __builtin_unreachable();
+  }
+
+  double weight() const {
+    switch (op) {
+      case HALF: return 0.5;
+      case EVEN: return 1.0;
+      case DOUBLE: return 2.0;
+    }
+    __builtin_unreachable();
+  }
+
+  Share_Op(_Share_Op op) : op(op) {}
+
+  Share_Op(std::string c) {
+    if (c == "H") {
+      op = HALF;
+    } else if (c == "E") {
+      op = EVEN;
+    } else if (c == "D") {
+      op = DOUBLE;
+    } else {
+      throw std::runtime_error("Invalid Share_Op string "+c);
+    }
+  }
+
+  std::vector<Share_Op> enumerate() {
+    return {Share_Op(HALF), Share_Op(EVEN), Share_Op(DOUBLE)};
+  }
+};
+
+// Number of panels each other device's share is streamed in. More 
+// panels overlap more of the copying, at the cost of smaller GEMMs.
+class Panel_Op {
+public:
+  int op;
+
+  Panel_Op() : op(1) {}
+
+  bool operator==(int o) const { return op == o; }
+
+  operator std::string() const { return std::to_string(op); }
+
+  Panel_Op(int op) : op(op) {}
+
+  Panel_Op(std::string c) {
+    if (c == "1" || c == "2" || c == "4") {
+      op = std::stoi(c);
+    } else {
+      throw std::runtime_error("Invalid Panel_Op string "+c);
+    }
+  }
+
+  std::vector<Panel_Op> enumerate() {
+    return {Panel_Op(1), Panel_Op(2), Panel_Op(4)};
+  }
+};
+
+// Edge of the square C tiles, and chunks of k, of an out-of-core GEMM
+class Tile_Op {
+public:
+  enum _Tile_Op {
+    T512, T1024, T2048, T4096
+  };
+  _Tile_Op op;
+
+  Tile_Op() : op(T1024) {}
+
+  bool operator==(_Tile_Op o) const { return op == o; }
+
+  operator std::string() const {
+    switch (op) {
+      case T512: return "S";
+      case T1024: return "M";
+      case T2048: return "L";
+      case T4096: return "X";
+    }
+    __builtin_unreachable();
+  }
+
+  int size() const { return 512 << op; }
+
+  Tile_Op(_Tile_Op op) : op(op) {}
+
+  Tile_Op(std::string c) {
+    if (c == "S") {
+      op = T512;
+    } else if (c == "M") {
+      op = T1024;
+    } else if (c == "L") {
+      op = T2048;
+    } else if (c == "X") {
+      op = T4096;
+    } else {
+      throw std::runtime_error("Invalid Tile_Op string "+c);
+    }
+  }
+
+  std::vector<Tile_Op> enumerate() {
+    return {Tile_Op(T512), Tile_Op(T1024), Tile_Op(T2048), Tile_Op(T4096)};
+  }
+};
+
+// Number of operand buffers an out-of-core GEMM streams tiles through
+class Depth_Op {
+public:
+  int op;
+
+  Depth_Op() : op(2) {}
+
+  bool operator==(int o) const { return op == o; }
+
+  operator std::string() const { return std::to_string(op); }
+
+  Depth_Op(int op) : op(op) {}
+
+  Depth_Op(std::string c) {
+    if (c == "2" || c == "3") {
+      op = std::stoi(c);
+    } else {
+      throw std::runtime_error("Invalid Depth_Op string "+c);
+    }
+  }
+
+  std::vector<Depth_Op> enumerate() {
+    return {Depth_Op(2), Depth_Op(3)};
+  }
+};
+
 class Bool_Op {
 public:
   bool op;
@@ -0,0 +1,71 @@
+#pragma once
+#include <cmath>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace rtat {
+
+// Groups nearly equal problem dimensions so that keys differing only by
+// them share timings and a plan. Dimensions from exact_below up are
+// rounded into geometric buckets, each growth times wider than the last,
+// with boundaries on multiples of alignment. Multiples of alignment and
+// other sizes are kept in separate buckets, as they often perform
+// differently. Buckets can be refined, halving them where performance
+// changes sharply, down to single dimensions.
+class Dimension_Buckets {
+  double growth;
+  int alignment;
+  int exact_below;
+  std::set<std::pair<int,int>> refined;
+
+  int round_up(double x) const {
+    return (int)std::ceil(x/alignment)*alignment;
+  }
+public:
+  Dimension_Buckets(double growth = 1.25, int alignment = 8,
+                    int exact_below = 64)
+    : growth(growth), alignment(alignment), exact_below(exact_below) {}
+
+  // The bucket [lo,hi) holding dim, or [dim,dim+1) when kept exact
+  std::pair<int,int> range(int dim) const {
+    if (dim < exact_below) return {dim, dim+1};
+
+    int lo = round_up(exact_below);
+    int hi = std::max(round_up(lo*growth), lo+alignment);
+    if (dim < lo) return {dim, dim+1};
+    while (dim >= hi) {
+      lo = hi;
+      hi = std::max(round_up(lo*growth), lo+alignment);
+    }
+
+    while (refined.count({lo, hi})) {
+      if (hi - lo <= alignment) return {dim, dim+1};
+      int mid = lo + round_up((hi-lo)/2.0);
+      if (mid >= hi) mid = lo + alignment;
+      if (dim < mid) hi = mid; else lo = mid;
+    }
+    return {lo, hi};
+  }
+
+  // The dimension standing in for dim in bucketed keys. Bucket bounds
+  // are multiples of alignment, so the two classes never collide.
+  int bucket(int dim) const {
+    auto [lo, hi] = range(dim);
+    if (hi - lo == 1) return dim;
+    return (dim % alignment == 0) ? lo : lo+1;
+  }
+
+  // Halves the buckets holding each of dims, once each
+  void refine(const std::vector<int> &dims) {
+    std::set<std::pair<int,int>> ranges;
+    for (int dim : dims) ranges.insert(range(dim));
+    for (auto &bucket_range : ranges)
+      if (bucket_range.second - bucket_range.first > 1)
+        refined.insert(bucket_range);
+  }
+
+  size_t refinements() const { return refined.size(); }
+};
+
+}
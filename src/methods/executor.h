@@ -1,10 +1,47 @@
 #pragma once
 #include <timer_bank.h>
 #include <workspace.h>
+#include <matrixop.h>
+#include "dimension_buckets.h"
+#include "options.h"
 #include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <type_traits>
 
 namespace rtat {
 
+// Keys and options with a mirror() describe an equivalent problem and the
+// corresponding plan for it, e.g. GEMM_Key::mirror. A plan and its mirror
+// do different work, so each key keeps its own timings, see 
+// Planning_System::set_share_mirrors.
+template<typename T, typename = void>
+struct has_mirror : std::false_type {};
+
+template<typename T>
+struct has_mirror<T, std::void_t<decltype(std::declval<const T&>().mirror())>> 
+    : std::true_type {};
+
+// Keys with a map_dims() can be bucketed, see Dimension_Buckets
+template<typename T, typename = void>
+struct has_map_dims : std::false_type {};
+
+template<typename T>
+struct has_map_dims<T, std::void_t<decltype(
+    std::declval<const T&>().map_dims(std::declval<int(*)(int)>()))>>
+    : std::true_type {};
+
+// The mirror of key, if it has one distinct from key
+template<typename Key, typename Opts>
+std::optional<Key> mirror_key(const Key &key) {
+  if constexpr(has_mirror<Key>::value && has_mirror<Opts>::value) {
+    Key mirror = key.mirror();
+    if (mirror < key || key < mirror) return mirror;
+  }
+  return {};
+}
+
 template<typename Params, typename Key, typename Opts>
 class Executor {
 public:
@@ -19,43 +56,251 @@ public:
                        Workspace space, Stream s, 
                        Device_Timer::Mode sync = Device_Timer::ASYNCHRONOUS) {
 
-    if (!warm) {
-      warmup(params, opts, s);
-      warm = true;
-    }
+    ensure_warm(params.handle);
 
     Device_Timer timer([&](const Stream &str) {
       internal_execute(params, opts, space, str);
     }, s, sync);
 
-    if (timer_log[params][opts].size() < log_size_limit)
-      timer_log[params][opts].append(timer);
+    log(params, opts, timer);
+  }
+
+  // Executes by launching a graph of the plan's work, captured from the 
+  // handle's stream. Saves forming the operation and dispatching each 
+  // library call. A graph is only captured once a call repeats the 
+  // operands, scalars, workspace and device of the one before, and is 
+  // launched for calls matching it. Other calls execute directly, so 
+  // callers whose operands change every call never pay for capturing. 
+  // Falls back to execute when the plan cannot be captured, the handle 
+  // is on the default stream, or operands are cached, as a graph would 
+  // fix whether each cache lookup hit.
+  void replay(Params params, Opts opts, Workspace space, Stream s,
+              Device_Timer::Mode sync = Device_Timer::ASYNCHRONOUS) {
+    gpu::Stream_t stream = nullptr;
+    gpu::blasGetStream(params.handle, &stream);
+    if (!capturable() || stream == nullptr || operand_cache) {
+      execute(params, opts, space, s, sync);
+      return;
+    }
+
+    int device;
+    gpuAssert(gpu::GetDevice(&device));
+    Graph_Call call{params, space, device};
+    auto &entry = graphs[params][opts];
+    bool current = entry.captured && *entry.captured == call;
+    bool repeated = entry.last && *entry.last == call;
+    entry.last.emplace(call);
+    if (!current && !repeated) {
+      execute(params, opts, space, s, sync);
+      return;
+    }
+
+    ensure_warm(params.handle);
+    if (!current) {
+      entry.graph.capture(stream, [&]() {
+        internal_execute(params, opts, space, Stream(stream));
+      });
+      entry.captured.emplace(call);
+      captures++;
+    }
+
+    Device_Timer timer([&](const Stream &) {
+      entry.graph.launch(stream);
+    }, s, sync);
+
+    log(params, opts, timer);
+  }
+
+
+  // Initializes the libraries on the current device ahead of the first 
+  // call, with a handle and stream of its own so that it can run on 
+  // another thread. Calls made meanwhile wait for it to finish.
+  void prepare() {
+    Stream s;
+    BLAS_Handle handle(s);
+    ensure_warm(handle);
   }
 
+  bool is_warm() {
+    int device;
+    gpuAssert(gpu::GetDevice(&device));
+    std::lock_guard<std::mutex> guard(warm_lock);
+    return warm.count(device);
+  }
 
-  std::map<Key, std::map<Opts, Timer_Bank>>& get_timings() 
+  // Timings are kept under canonical keys, i.e. bucketed if enabled
+  std::map<Key, Option_Map<Opts, Timer_Bank>>& get_timings() 
     { return timer_log; }
-  std::map<Opts, Timer_Bank>& get_timings(Key key) 
-    { return timer_log[key]; }
+  Option_Map<Opts, Timer_Bank>& get_timings(Key key) 
+    { return timer_log[canonical(key)]; }
+
+  Timer_Bank& get_timings(Key key, Opts opts) 
+    { return get_timings(key)[opts]; }
+
+  Key canonical(const Key &key) const {
+    Key ret = key;
+    if constexpr(has_map_dims<Key>::value) {
+      if (buckets)
+        ret = ret.map_dims([this](int d) { return buckets->bucket(d); });
+    }
+    return ret;
+  }
+
+  void set_buckets(std::shared_ptr<Dimension_Buckets> new_buckets) {
+    buckets = new_buckets;
+  }
+  std::shared_ptr<Dimension_Buckets> get_buckets() const { return buckets; }
 
+  // Timings of the keys that fell into a bucket, a few of each
+  std::map<Key, Option_Map<Opts, Timer_Bank>>& 
+  get_member_timings(Key bucket) {
+    return members[bucket];
+  }
+
+  // Drops the timings of a canonical key, e.g. once its bucket is split
+  void forget(const Key &key) {
+    timer_log.erase(key);
+    members.erase(key);
+  }
+
+  // Workspace only depends on the problem shape, so it is worked out 
+  // once per key and plan rather than forming the operation every call
   virtual size_t calculate_workspace(Params params, Opts opts) {
-    auto operation = opts.form_operation(params);
-    return operation->workspace_req_bytes();
+    auto &sizes = workspace_sizes[params];
+    if (auto search = sizes.find(opts); search != sizes.end())
+      return search->second;
+
+    size_t elided = 0;
+    auto operation = optimize(opts.form_operation(params), elided);
+    return sizes[opts] = operation->workspace_req_bytes();
+  }
+
+  // Number of memory passes removed by optimizing executed operations
+  size_t get_elided_passes() const { return elided_passes; }
+
+  // Number of graphs captured by replay
+  size_t get_captures() const { return captures; }
+
+  // Transforms of generation-tagged operands are kept here between calls
+  void set_operand_cache(std::shared_ptr<Operand_Cache> cache) {
+    operand_cache = cache;
   }
+  std::shared_ptr<Operand_Cache> get_operand_cache() const { 
+    return operand_cache; 
+  }
+  // Number of operations formed, see formed
+  size_t get_formed_count() const { return formed_count; }
 protected:
   virtual void internal_execute(Params params, Opts opts, Workspace space,
                         [[maybe_unused]] Stream s) {
-    auto operation = opts.form_operation(params);
+    auto &operation = formed(params, opts, [&]() {
+      auto operation = optimize(opts.form_operation(params), elided_passes);
+      if (operand_cache)
+        operation = use_cache(std::move(operation), *operand_cache);
+      return operation;
+    });
     if (operation->workspace_req_bytes() > space.size<char>()) {
       throw "internal_execute: Insufficient workspace";
     }
     operation->execute(params.handle, Workspace(), space);
   }
-  virtual void warmup(Params, Opts, Stream) = 0;
 
-  std::map<Key, std::map<Opts, Timer_Bank>> timer_log;  
+  // The operation for a call, formed by form, or the one formed for the 
+  // last call of its key if it had the same parameters and plan, as 
+  // calls on a converged plan with the same operands do. Saves allocating
+  // and optimizing the tree on every call.
+  template<typename Form>
+  auto& formed(const Params &params, const Opts &opts, Form form) {
+    using Operation = decltype(form());
+    auto &slot = formed_operations[Key(params)];
+    auto *last = dynamic_cast<Formed<Operation>*>(slot.get());
+    if (!last || !(last->params == params) 
+        || last->opts < opts || opts < last->opts) {
+      slot = std::make_unique<Formed<Operation>>(params, opts, form());
+      last = static_cast<Formed<Operation>*>(slot.get());
+      formed_count++;
+    }
+    return last->operation;
+  }
+  virtual void warmup(gpu::blasHandle_t) = 0;
+
+  // Plans that synchronize, or that span devices, cannot be captured
+  virtual bool capturable() const { return true; }
+
+  void log(Params params, Opts opts, Device_Timer &timer) {
+    Key key(params);
+    if (buckets) {
+      auto &bucket = members[canonical(key)];
+      if (bucket.size() < member_limit || bucket.count(key)) {
+        Timer_Bank &sample = bucket[key][opts];
+        Device_Timer copy = timer;
+        if (sample.size() < member_log_limit)
+          sample.append(copy);
+      }
+    }
+
+    Timer_Bank &bank = get_timings(key, opts);
+    if (bank.size() < log_size_limit)
+      bank.append(timer);
+  }
+
+  // Warmup is per device, as libraries initialize each one lazily
+  void ensure_warm(gpu::blasHandle_t handle) {
+    int device;
+    gpuAssert(gpu::GetDevice(&device));
+    std::lock_guard<std::mutex> guard(warm_lock);
+    if (!warm.count(device)) {
+      warmup(handle);
+      warm.insert(device);
+    }
+  }
+
+  struct Formed_Base {
+    virtual ~Formed_Base() = default;
+  };
+  template<typename Operation>
+  struct Formed : Formed_Base {
+    Params params;
+    Opts opts;
+    Operation operation;
+    Formed(Params params, Opts opts, Operation operation)
+      : params(params), opts(opts), operation(std::move(operation)) {}
+  };
+
+  // What a captured graph depends on
+  struct Graph_Call {
+    Params params;
+    Workspace space;
+    int device;
+
+    bool operator==(const Graph_Call &o) const {
+      return params == o.params && space == o.space && device == o.device;
+    }
+  };
+
+  // The captured graph for a plan, the call it was captured from and the
+  // last call replayed
+  struct Graph_Entry {
+    std::optional<Graph_Call> captured, last;
+    Execution_Graph graph;
+  };
+
+  std::map<Key, Option_Map<Opts, Timer_Bank>> timer_log;  
+  std::map<Key, std::map<Opts, size_t>> workspace_sizes;
   const size_t log_size_limit = 100;
-  bool warm = false;
+  std::set<int> warm;
+  std::mutex warm_lock;
+  std::map<Key, std::map<Opts, Graph_Entry>> graphs;
+  size_t elided_passes = 0;
+  size_t captures = 0;
+  std::map<Key, std::unique_ptr<Formed_Base>> formed_operations;
+  size_t formed_count = 0;
+  std::shared_ptr<Operand_Cache> operand_cache;
+
+  std::shared_ptr<Dimension_Buckets> buckets;
+  std::map<Key, std::map<Key, Option_Map<Opts, Timer_Bank>>> members;
+  const size_t member_limit = 16;
+  const size_t member_log_limit = 8;
 };
 
 }
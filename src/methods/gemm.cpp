@@ -1,13 +1,31 @@
 #include "gemm.h"
+#include <optional>
 #include <sstream>
+#include <tuple>
 using namespace rtat;
 
+// Computing C^t in place of C requires both operand operations to 
+// compose with t. A conjugate transpose is needed as soon as either 
+// operand is conjugated, so complex inputs mixing T and C have no valid 
+// choice and the output transpose is skipped.
+template<typename T>
+static std::optional<gpu::blasOperation_t> output_transpose(
+    gpu::blasOperation_t opA, gpu::blasOperation_t opB) {
+  auto t = transpose_kind<T>(
+      (opA == gpu::BLAS_OP_C || opB == gpu::BLAS_OP_C) 
+        ? gpu::BLAS_OP_C : gpu::BLAS_OP_T);
+  if (composable<T>(opA, t) && composable<T>(opB, t))
+    return t;
+  return {};
+}
+
 // GEMM_Key implementation
 GEMM_Key::operator std::string() const {
   std::stringstream ss;
   ss << transa << ","
      << transb << ","
-     << "," << m << "," << k << "," << n;
+     << "," << m << "," << k << "," << n << ","
+     << lda << ldb << ldc << "," << align << "," << beta;
 
   std::string ret;
   ss >> ret;
@@ -15,7 +33,20 @@ GEMM_Key::operator std::string() const {
 }
 
 bool GEMM_Key::operator<(const GEMM_Key& rhs) const {
-  return std::string(*this) < std::string(rhs);
+  return std::tie(transa, transb, m, n, k, lda, ldb, ldc, align, beta)
+       < std::tie(rhs.transa, rhs.transb, rhs.m, rhs.n, rhs.k, 
+                  rhs.lda, rhs.ldb, rhs.ldc, rhs.align, rhs.beta);
+}
+
+GEMM_Key GEMM_Key::mirror() const {
+  auto ta = chain(gpu::BLAS_OP_T, transa);
+  auto tb = chain(gpu::BLAS_OP_T, transb);
+  if (!ta || !tb) return *this;
+  return GEMM_Key(*tb, *ta, n, k, m, ldb, lda, ldc, align, beta);
+}
+
+bool GEMM_Key::canonical() const {
+  return !(mirror() < *this);
 }
 
 std::ostream& operator<<(std::ostream& os, const GEMM_Key& dt) {
@@ -53,7 +84,14 @@ GEMM_Options_Pad::operator std::string() const {
 }
 
 bool GEMM_Options_Pad::operator<(const GEMM_Options_Pad& o) const {
-  return std::string(*this) < std::string(o);
+  return std::tie(transa.op, pada.op, transb.op, padb.op, transc.op, padc.op)
+       < std::tie(o.transa.op, o.pada.op, o.transb.op, o.padb.op, 
+                  o.transc.op, o.padc.op);
+}
+
+GEMM_Options_Pad GEMM_Options_Pad::mirror() const {
+  BLAS_Op tc = transc;
+  return GEMM_Options_Pad(transb, padb, transa, pada, !tc, padc);
 }
 
 std::ostream& operator<<(std::ostream& os, const GEMM_Options_Pad opts) {
@@ -93,33 +131,36 @@ std::unique_ptr<MatrixOp<T>> GEMM_Options_Pad::form_operation(GEMM_Inputs<T> par
   bool pb = padb == Pad_Op::PAD;
   bool pc = padc == Pad_Op::PAD;
 
+  gpu::blasOperation_t kind_a = transpose_kind<T>(params.transa);
   if (ta) 
-    params.transa = !params.transa;
+    params.transa = compose(params.transa, kind_a);
   if (ta || pa)
     A = std::make_unique<MatrixMove<T>>(
-        std::move(A), 1.0, ta, pa ? 32 : 1);
+        std::move(A), 1.0, ta ? kind_a : gpu::BLAS_OP_N, pa ? 32 : 1);
 
+  gpu::blasOperation_t kind_b = transpose_kind<T>(params.transb);
   if (tb)
-    params.transb = !params.transb;
+    params.transb = compose(params.transb, kind_b);
   if (tb || pb)
     B = std::make_unique<MatrixMove<T>>(
-        std::move(B), 1.0, tb, pb ? 32 : 1);
+        std::move(B), 1.0, tb ? kind_b : gpu::BLAS_OP_N, pb ? 32 : 1);
 
-  if (tc) {
+  auto kind_c = output_transpose<T>(params.transa, params.transb);
+  if (tc && kind_c) {
     auto scratch = std::make_unique<MatrixMultAlloc<T>>(
         std::move(B), std::move(A), 
-        params.transb != gpu::BLAS_OP_T, 
-        params.transa != gpu::BLAS_OP_T, 
-        params.alpha, pc ? 32 : 1);
+        compose(params.transb, *kind_c), 
+        compose(params.transa, *kind_c), 
+        *kind_c == gpu::BLAS_OP_C ? conjugate(params.alpha) : params.alpha, 
+        pc ? 32 : 1);
 
     return std::make_unique<MatrixAccumulate<T>>(
         std::move(scratch), std::move(C), 
-        1.0, params.beta, true);
+        1.0, params.beta, *kind_c);
   } else if (pc) {
     auto scratch = std::make_unique<MatrixMultAlloc<T>>(
         std::move(A), std::move(B),
-        params.transa == gpu::BLAS_OP_T, 
-        params.transb == gpu::BLAS_OP_T, 
+        params.transa, params.transb, 
         params.alpha, 32);
 
     return std::make_unique<MatrixAccumulate<T>>(
@@ -128,7 +169,7 @@ std::unique_ptr<MatrixOp<T>> GEMM_Options_Pad::form_operation(GEMM_Inputs<T> par
   } else {
     return std::make_unique<MatrixMult<T>>(
         std::move(A), std::move(B), std::move(C), 
-        params.transa == gpu::BLAS_OP_T, params.transb == gpu::BLAS_OP_T,
+        params.transa, params.transb,
         params.alpha, params.beta);
   }
 }
@@ -156,7 +197,14 @@ GEMM_Options::operator std::string() const {
 }
 
 bool GEMM_Options::operator<(const GEMM_Options& o) const {
-  return std::string(*this) < std::string(o);
+  return std::tie(transa.op, transb.op, transc.op)
+       < std::tie(o.transa.op, o.transb.op, o.transc.op);
+}
+
+// The operands swap, and C^T is the mirror's C
+GEMM_Options GEMM_Options::mirror() const {
+  BLAS_Op tc = transc;
+  return GEMM_Options(transb, transa, !tc);
 }
 
 std::ostream& operator<<(std::ostream& os, const GEMM_Options opts) {
@@ -191,35 +239,291 @@ std::unique_ptr<MatrixOp<T>> GEMM_Options::form_operation(GEMM_Inputs<T> params)
   bool tc = transc == BLAS_Op::TRANS;
 
   if (ta) {
-    params.transa = !params.transa;
+    auto kind = transpose_kind<T>(params.transa);
+    params.transa = compose(params.transa, kind);
     A = std::make_unique<MatrixMove<T>>(
-        std::move(A), 1.0, ta, 1);
+        std::move(A), 1.0, kind, 1);
   }
 
   if (tb) {
-    params.transb = !params.transb;
+    auto kind = transpose_kind<T>(params.transb);
+    params.transb = compose(params.transb, kind);
     B = std::make_unique<MatrixMove<T>>(
-        std::move(B), 1.0, tb, 1);
+        std::move(B), 1.0, kind, 1);
   }
 
-  if (tc) {
+  auto kind_c = output_transpose<T>(params.transa, params.transb);
+  if (tc && kind_c) {
     auto scratch = std::make_unique<MatrixMultAlloc<T>>(
         std::move(B), std::move(A), 
-        params.transb != gpu::BLAS_OP_T, 
-        params.transa != gpu::BLAS_OP_T, 
-        params.alpha, 1);
+        compose(params.transb, *kind_c), 
+        compose(params.transa, *kind_c), 
+        *kind_c == gpu::BLAS_OP_C ? conjugate(params.alpha) : params.alpha, 
+        1);
 
     return std::make_unique<MatrixAccumulate<T>>(
         std::move(scratch), std::move(C), 
-        1.0, params.beta, true);
+        1.0, params.beta, *kind_c);
   }  else {
     return std::make_unique<MatrixMult<T>>(
         std::move(A), std::move(B), std::move(C), 
-        params.transa == gpu::BLAS_OP_T, params.transb == gpu::BLAS_OP_T,
+        params.transa, params.transb,
         params.alpha, params.beta);
   }
 }
 
+// GEMM_Options_Mixed implementation
+std::vector<GEMM_Options_Mixed> GEMM_Options_Mixed::enumerate() {
+  std::vector<GEMM_Options_Mixed> ret;
+
+  for (auto opA : {BLAS_Op::NOTRANS, BLAS_Op::TRANS})
+    for (auto opB : {BLAS_Op::NOTRANS, BLAS_Op::TRANS})
+      for (auto opC : {BLAS_Op::NOTRANS, BLAS_Op::TRANS})
+        for (auto prec : Precision_Op().enumerate())
+          ret.push_back(GEMM_Options_Mixed(opA,opB,opC,prec));
+  return ret;
+}
+
+GEMM_Options_Mixed::operator std::string() const {
+  std::stringstream ss;
+  ss << std::string(transa);
+  ss << std::string(transb);
+  ss << std::string(transc);
+  ss << std::string(precision);
+
+  std::string ret;
+  ss >> ret;
+  return ret;
+}
+
+bool GEMM_Options_Mixed::operator<(const GEMM_Options_Mixed& o) const {
+  return std::tie(transa.op, transb.op, transc.op, precision.op)
+       < std::tie(o.transa.op, o.transb.op, o.transc.op, o.precision.op);
+}
+
+std::ostream& operator<<(std::ostream& os, const GEMM_Options_Mixed opts) {
+  os << std::string(opts); 
+  return os;
+}
+
+std::istream& operator>>(std::istream &is, GEMM_Options_Mixed &opts) {
+  std::string s;
+  is >> s;
+  if (s.size() != 4) {
+    is.setstate(std::ios::failbit);
+    return is;
+  }
+    
+  opts.transa = BLAS_Op({s[0]});
+  opts.transb = BLAS_Op({s[1]});
+  opts.transc = BLAS_Op({s[2]});
+  opts.precision = Precision_Op({s[3]});
+
+  return is;
+}
+
+gpu::blasComputeType_t GEMM_Options_Mixed::compute_type() const {
+  switch (precision.op) {
+    case Precision_Op::FULL: return gpu::BLAS_COMPUTE_32F;
+    case Precision_Op::TF32: return gpu::BLAS_COMPUTE_32F_FAST_TF32;
+    case Precision_Op::FP16: return gpu::BLAS_COMPUTE_32F_FAST_16F;
+    case Precision_Op::BF16: return gpu::BLAS_COMPUTE_32F_FAST_16BF;
+  }
+  __builtin_unreachable();
+}
+
+template<typename T>
+std::unique_ptr<MatrixOp<T>> GEMM_Options_Mixed::form_operation(GEMM_Inputs<T> params) {
+
+  std::unique_ptr<MatrixOp<T>> A = std::make_unique<NoOp<T>>(params.A);
+  std::unique_ptr<MatrixOp<T>> B = std::make_unique<NoOp<T>>(params.B);
+  std::unique_ptr<MatrixOp<T>> C = std::make_unique<NoOp<T>>(params.C);
+
+  bool ta = transa == BLAS_Op::TRANS;
+  bool tb = transb == BLAS_Op::TRANS;
+  bool tc = transc == BLAS_Op::TRANS;
+
+  if (ta) {
+    auto kind = transpose_kind<T>(params.transa);
+    params.transa = compose(params.transa, kind);
+    A = std::make_unique<MatrixMove<T>>(
+        std::move(A), 1.0, kind, 1);
+  }
+
+  if (tb) {
+    auto kind = transpose_kind<T>(params.transb);
+    params.transb = compose(params.transb, kind);
+    B = std::make_unique<MatrixMove<T>>(
+        std::move(B), 1.0, kind, 1);
+  }
+
+  auto kind_c = output_transpose<T>(params.transa, params.transb);
+  if (tc && kind_c) {
+    auto scratch = std::make_unique<MatrixMultAllocLowered<T>>(
+        std::move(B), std::move(A), 
+        compose(params.transb, *kind_c), 
+        compose(params.transa, *kind_c), 
+        *kind_c == gpu::BLAS_OP_C ? conjugate(params.alpha) : params.alpha, 
+        1, compute_type());
+
+    return std::make_unique<MatrixAccumulate<T>>(
+        std::move(scratch), std::move(C), 
+        1.0, params.beta, *kind_c);
+  }  else {
+    return std::make_unique<MatrixMultLowered<T>>(
+        std::move(A), std::move(B), std::move(C), 
+        params.transa, params.transb,
+        params.alpha, params.beta, compute_type());
+  }
+}
+
+// GEMM_Options_Distributed implementation
+std::vector<GEMM_Options_Distributed> GEMM_Options_Distributed::enumerate() {
+  std::vector<GEMM_Options_Distributed> ret;
+
+  for (auto split : Split_Op().enumerate())
+    for (auto share : Share_Op().enumerate())
+      for (auto panels : Panel_Op().enumerate())
+        ret.push_back(GEMM_Options_Distributed(split,share,panels));
+  return ret;
+}
+
+GEMM_Options_Distributed::operator std::string() const {
+  std::stringstream ss;
+  ss << std::string(split);
+  ss << std::string(share);
+  ss << std::string(panels);
+
+  std::string ret;
+  ss >> ret;
+  return ret;
+}
+
+bool GEMM_Options_Distributed::operator<(const GEMM_Options_Distributed& o) const {
+  return std::tie(split.op, share.op, panels.op)
+       < std::tie(o.split.op, o.share.op, o.panels.op);
+}
+
+std::ostream& operator<<(std::ostream& os, const GEMM_Options_Distributed opts) {
+  os << std::string(opts); 
+  return os;
+}
+
+std::istream& operator>>(std::istream &is, GEMM_Options_Distributed &opts) {
+  std::string s;
+  is >> s;
+  if (s.size() != 3) {
+    is.setstate(std::ios::failbit);
+    return is;
+  }
+    
+  opts.split = Split_Op({s[0]});
+  opts.share = Share_Op({s[1]});
+  opts.panels = Panel_Op(std::string({s[2]}));
+
+  return is;
+}
+
+template<typename T>
+std::unique_ptr<MatrixOp<T>> GEMM_Options_Distributed::form_operation(
+    GEMM_Inputs<T> params, Device_Team &team) {
+
+  std::unique_ptr<MatrixOp<T>> A = std::make_unique<NoOp<T>>(params.A);
+  std::unique_ptr<MatrixOp<T>> B = std::make_unique<NoOp<T>>(params.B);
+  std::unique_ptr<MatrixOp<T>> C = std::make_unique<NoOp<T>>(params.C);
+
+  return std::make_unique<DistributedMatrixMult<T>>(
+      std::move(A), std::move(B), std::move(C), 
+      params.transa, params.transb,
+      params.alpha, params.beta, team,
+      split == Split_Op::ROWS, share.weight(), panels.op);
+}
+
+// GEMM_Options_Out_Of_Core implementation
+std::vector<GEMM_Options_Out_Of_Core> GEMM_Options_Out_Of_Core::enumerate() {
+  std::vector<GEMM_Options_Out_Of_Core> ret;
+
+  for (auto tile : Tile_Op().enumerate())
+    for (auto depth : Depth_Op().enumerate())
+      ret.push_back(GEMM_Options_Out_Of_Core(tile,depth));
+  return ret;
+}
+
+GEMM_Options_Out_Of_Core::operator std::string() const {
+  std::stringstream ss;
+  ss << std::string(tile);
+  ss << std::string(depth);
+
+  std::string ret;
+  ss >> ret;
+  return ret;
+}
+
+bool GEMM_Options_Out_Of_Core::operator<(const GEMM_Options_Out_Of_Core& o) const {
+  return std::tie(tile.op, depth.op) < std::tie(o.tile.op, o.depth.op);
+}
+
+std::ostream& operator<<(std::ostream& os, const GEMM_Options_Out_Of_Core opts) {
+  os << std::string(opts); 
+  return os;
+}
+
+std::istream& operator>>(std::istream &is, GEMM_Options_Out_Of_Core &opts) {
+  std::string s;
+  is >> s;
+  if (s.size() != 2) {
+    is.setstate(std::ios::failbit);
+    return is;
+  }
+    
+  opts.tile = Tile_Op({s[0]});
+  opts.depth = Depth_Op(std::string({s[1]}));
+
+  return is;
+}
+
+template<typename T>
+std::unique_ptr<MatrixOp<T>> GEMM_Options_Out_Of_Core::form_operation(
+    GEMM_Inputs<T> params, std::shared_ptr<Host_Staging> staging) {
+
+  std::unique_ptr<MatrixOp<T>> A = std::make_unique<NoOp<T>>(params.A);
+  std::unique_ptr<MatrixOp<T>> B = std::make_unique<NoOp<T>>(params.B);
+  std::unique_ptr<MatrixOp<T>> C = std::make_unique<NoOp<T>>(params.C);
+
+  return std::make_unique<OutOfCoreMatrixMult<T>>(
+      std::move(A), std::move(B), std::move(C), 
+      params.transa, params.transb,
+      params.alpha, params.beta, staging,
+      tile.size(), depth.op);
+}
+
+template std::unique_ptr<MatrixOp<float>> 
+  GEMM_Options_Mixed::form_operation(GEMM_Inputs<float>);
+
+template std::unique_ptr<MatrixOp<double>> 
+  GEMM_Options_Out_Of_Core::form_operation(GEMM_Inputs<double>, std::shared_ptr<Host_Staging>);
+
+template std::unique_ptr<MatrixOp<float>> 
+  GEMM_Options_Out_Of_Core::form_operation(GEMM_Inputs<float>, std::shared_ptr<Host_Staging>);
+
+template std::unique_ptr<MatrixOp<std::complex<double>>> 
+  GEMM_Options_Out_Of_Core::form_operation(GEMM_Inputs<std::complex<double>>, std::shared_ptr<Host_Staging>);
+
+template std::unique_ptr<MatrixOp<std::complex<float>>> 
+  GEMM_Options_Out_Of_Core::form_operation(GEMM_Inputs<std::complex<float>>, std::shared_ptr<Host_Staging>);
+
+template std::unique_ptr<MatrixOp<double>> 
+  GEMM_Options_Distributed::form_operation(GEMM_Inputs<double>, Device_Team&);
+
+template std::unique_ptr<MatrixOp<float>> 
+  GEMM_Options_Distributed::form_operation(GEMM_Inputs<float>, Device_Team&);
+
+template std::unique_ptr<MatrixOp<std::complex<double>>> 
+  GEMM_Options_Distributed::form_operation(GEMM_Inputs<std::complex<double>>, Device_Team&);
+
+template std::unique_ptr<MatrixOp<std::complex<float>>> 
+  GEMM_Options_Distributed::form_operation(GEMM_Inputs<std::complex<float>>, Device_Team&);
+
 template std::unique_ptr<MatrixOp<double>> 
   GEMM_Options::form_operation(GEMM_Inputs<double>);
 
@@ -231,3 +535,15 @@ template std::unique_ptr<MatrixOp<double>>
 
 template std::unique_ptr<MatrixOp<float>> 
   GEMM_Options_Pad::form_operation(GEMM_Inputs<float>);
+
+template std::unique_ptr<MatrixOp<std::complex<double>>> 
+  GEMM_Options::form_operation(GEMM_Inputs<std::complex<double>>);
+
+template std::unique_ptr<MatrixOp<std::complex<float>>> 
+  GEMM_Options::form_operation(GEMM_Inputs<std::complex<float>>);
+
+template std::unique_ptr<MatrixOp<std::complex<double>>> 
+  GEMM_Options_Pad::form_operation(GEMM_Inputs<std::complex<double>>);
+
+template std::unique_ptr<MatrixOp<std::complex<float>>> 
+  GEMM_Options_Pad::form_operation(GEMM_Inputs<std::complex<float>>);
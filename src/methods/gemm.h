@@ -1,9 +1,12 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <optional>
+#include <limits>
 #include <matrixop.h>
 #include <executor.h>
 #include "base_options.h"
+#include "key_classes.h"
 
 namespace rtat {
 
@@ -26,20 +29,56 @@ struct GEMM_Inputs {
   size_t m() {return C.dims().m;}
   size_t n() {return C.dims().n;}
   size_t k() {return (transa == gpu::BLAS_OP_N) ? A.dims().n : A.dims().m;}
+
+  bool operator==(const GEMM_Inputs &o) const {
+    return handle == o.handle && transa == o.transa && transb == o.transb
+        && A == o.A && B == o.B && C == o.C 
+        && alpha == o.alpha && beta == o.beta;
+  }
 };
 
 
+// Besides the operations and shape, keys hold the classes of each 
+// operand's leading dimension, the operands' alignment and beta, see 
+// key_classes.h
 struct GEMM_Key {
   BLAS_Operation transa; BLAS_Operation transb;
   int m; int n; int k;
+  Stride_Class lda; Stride_Class ldb; Stride_Class ldc;
+  Align_Class align;
+  Beta_Class beta;
 
   template<typename T>
   GEMM_Key(GEMM_Inputs<T> i) : transa(i.transa), transb(i.transb), 
-                            m(i.m()), n(i.n()), k(i.k()) {}
+                            m(i.m()), n(i.n()), k(i.k()),
+                            lda(stride_class(i.A)), ldb(stride_class(i.B)),
+                            ldc(stride_class(i.C)),
+                            align(align_class(i.A, i.B, i.C)),
+                            beta(beta_class(i.beta)) {}
 
   GEMM_Key(BLAS_Operation transa, BLAS_Operation transb,
-           int m, int k, int n) : transa(transa), transb(transb), 
-                                  m(m), n(n), k(k) {}
+           int m, int k, int n,
+           Stride_Class lda = STRIDE_ALIGNED,
+           Stride_Class ldb = STRIDE_ALIGNED,
+           Stride_Class ldc = STRIDE_ALIGNED,
+           Align_Class align = ALIGN_LINE,
+           Beta_Class beta = BETA_ZERO) 
+    : transa(transa), transb(transb), m(m), n(n), k(k),
+      lda(lda), ldb(ldb), ldc(ldc), align(align), beta(beta) {}
+
+  // The same problem transposed, C^T = op(B)^T op(A)^T. A key may adopt
+  // its mirror's plan, see Planning_System::set_share_mirrors. Conjugated
+  // operands have no mirror, as BLAS cannot express a bare conjugation.
+  GEMM_Key mirror() const;
+  bool canonical() const;
+
+  // The key with each dimension d replaced by f(d), e.g. for bucketing. 
+  // f sees the dimensions in the order they are declared.
+  template<typename F>
+  GEMM_Key map_dims(F f) const { 
+    int fm = f(m), fn = f(n), fk = f(k);
+    return GEMM_Key(transa, transb, fm, fk, fn, lda, ldb, ldc, align, beta); 
+  }
 
   operator std::string() const;
   bool operator<(const GEMM_Key&) const;
@@ -66,8 +105,26 @@ struct GEMM_Options {
 
   static std::vector<GEMM_Options> enumerate();
 
+  // The equivalent plan for the mirrored key
+  GEMM_Options mirror() const;
+
   operator std::string() const;
 
+  // The option's choices, one level per factor. Options made of 
+  // independent factors can be searched by screening them, see 
+  // Planning_System::set_screening.
+  std::vector<std::string> factors() const {
+    return {transa, transb, transc};
+  }
+
+  // Dense index of the option, so planner tables are arrays, see 
+  // Option_Table
+  static constexpr size_t count = 8;
+  size_t index() const {
+    return transa.op*4 + transb.op*2 + transc.op;
+  }
+  bool valid() const { return true; }
+
   bool operator<(const GEMM_Options&) const;
 
   friend std::ostream& operator<<(std::ostream&, const GEMM_Options);
@@ -99,8 +156,24 @@ struct GEMM_Options_Pad {
 
   static std::vector<GEMM_Options_Pad> enumerate();
 
+  // The equivalent plan for the mirrored key
+  GEMM_Options_Pad mirror() const;
+
   operator std::string() const;
 
+  // See GEMM_Options::factors
+  std::vector<std::string> factors() const {
+    return {transa, pada, transb, padb, transc, padc};
+  }
+
+  // See GEMM_Options::index
+  static constexpr size_t count = 64;
+  size_t index() const {
+    return ((((transa.op*2 + pada.op)*2 + transb.op)*2 + padb.op)*2
+            + transc.op)*2 + padc.op;
+  }
+  bool valid() const { return true; }
+
   bool operator<(const GEMM_Options_Pad&) const;
 
   friend std::ostream& operator<<(std::ostream&, const GEMM_Options_Pad);
@@ -110,61 +183,347 @@ struct GEMM_Options_Pad {
   std::unique_ptr<MatrixOp<T>> form_operation(GEMM_Inputs<T>);
 };
 
+// GEMM options with a reduced compute precision. Only meaningful for 
+// float, which is the only type with reduced precision compute types.
+struct GEMM_Options_Mixed {
+  BLAS_Op transa;
+  BLAS_Op transb;
+  BLAS_Op transc;
+  Precision_Op precision;
+
+  GEMM_Options_Mixed() = default;
+  GEMM_Options_Mixed(BLAS_Op transa,
+                     BLAS_Op transb,
+                     BLAS_Op transc,
+                     Precision_Op precision) :
+    transa(transa), 
+    transb(transb),
+    transc(transc),
+    precision(precision) {}
+
+  static GEMM_Options_Mixed default_opts() {
+    return GEMM_Options_Mixed();
+  }
+
+  static std::vector<GEMM_Options_Mixed> enumerate();
+
+  operator std::string() const;
+
+  // See GEMM_Options::factors
+  std::vector<std::string> factors() const {
+    return {transa, transb, transc, precision};
+  }
+
+  bool operator<(const GEMM_Options_Mixed&) const;
+
+  friend std::ostream& operator<<(std::ostream&, const GEMM_Options_Mixed);
+  friend std::istream& operator>>(std::istream&, GEMM_Options_Mixed&); 
+
+  gpu::blasComputeType_t compute_type() const;
+
+  template<typename T>
+  std::unique_ptr<MatrixOp<T>> form_operation(GEMM_Inputs<T>);
+};
+
+// GEMM spread over a team of devices. The split axis, the calling 
+// device's share and the panel count are tuned; operand layouts are 
+// left as given, since every device works on views of them.
+struct GEMM_Options_Distributed {
+  Split_Op split;
+  Share_Op share;
+  Panel_Op panels;
+
+  GEMM_Options_Distributed() = default;
+  GEMM_Options_Distributed(Split_Op split,
+                           Share_Op share,
+                           Panel_Op panels) :
+    split(split),
+    share(share),
+    panels(panels) {}
+
+  static GEMM_Options_Distributed default_opts() {
+    return GEMM_Options_Distributed();
+  }
+
+  static std::vector<GEMM_Options_Distributed> enumerate();
+
+  operator std::string() const;
+
+  // See GEMM_Options::factors
+  std::vector<std::string> factors() const {
+    return {split, share, panels};
+  }
+
+  bool operator<(const GEMM_Options_Distributed&) const;
+
+  friend std::ostream& operator<<(std::ostream&, const GEMM_Options_Distributed);
+  friend std::istream& operator>>(std::istream&, GEMM_Options_Distributed&); 
+
+  template<typename T>
+  std::unique_ptr<MatrixOp<T>> form_operation(GEMM_Inputs<T>, Device_Team&);
+
+  // On the calling device's shared team
+  template<typename T>
+  std::unique_ptr<MatrixOp<T>> form_operation(GEMM_Inputs<T> params) {
+    return form_operation(params, *Device_Team::shared());
+  }
+};
+
+// GEMM on host resident operands, streamed through the device in tiles.
+// The tile size and the number of operand buffers are tuned.
+struct GEMM_Options_Out_Of_Core {
+  Tile_Op tile;
+  Depth_Op depth;
+
+  GEMM_Options_Out_Of_Core() = default;
+  GEMM_Options_Out_Of_Core(Tile_Op tile,
+                           Depth_Op depth) :
+    tile(tile),
+    depth(depth) {}
+
+  static GEMM_Options_Out_Of_Core default_opts() {
+    return GEMM_Options_Out_Of_Core();
+  }
+
+  static std::vector<GEMM_Options_Out_Of_Core> enumerate();
+
+  operator std::string() const;
+
+  // See GEMM_Options::factors
+  std::vector<std::string> factors() const {
+    return {tile, depth};
+  }
+
+  bool operator<(const GEMM_Options_Out_Of_Core&) const;
+
+  friend std::ostream& operator<<(std::ostream&, const GEMM_Options_Out_Of_Core);
+  friend std::istream& operator>>(std::istream&, GEMM_Options_Out_Of_Core&); 
+
+  template<typename T>
+  std::unique_ptr<MatrixOp<T>> form_operation(GEMM_Inputs<T>, std::shared_ptr<Host_Staging>);
+
+  // With staging of its own
+  template<typename T>
+  std::unique_ptr<MatrixOp<T>> form_operation(GEMM_Inputs<T> params) {
+    return form_operation(params, std::make_shared<Host_Staging>());
+  }
+};
+
+// Touch every GEMM/GEAM variant once so library initialization and 
+// kernel loading aren't attributed to the first timed plan.
+template<typename T>
+void gemm_warmup(gpu::blasHandle_t handle) {
+  size_t n = 8;
+  T *A, *B, *C;
+  gpuAssert(gpu::Malloc(&A, n*n*sizeof(T)));
+  gpuAssert(gpu::Malloc(&B, n*n*sizeof(T)));
+  gpuAssert(gpu::Malloc(&C, n*n*sizeof(T)));
+  Matrix<T> Am(Workspace(A, n*n), n, n, n);
+  Matrix<T> Bm(Workspace(B, n*n), n, n, n);
+  Matrix<T> Cm(Workspace(C, n*n), n, n, n);
+
+  std::vector<gpu::blasOperation_t> ops = {gpu::BLAS_OP_N, gpu::BLAS_OP_T};
+  if constexpr(is_complex_v<T>) ops.push_back(gpu::BLAS_OP_C);
+
+  for (auto &opA : ops) {
+    for (auto &opB : ops) {
+      gpuTgemm<T>(handle, opA, opB, Am, Bm, Cm, 1.0, 0.0);
+      gpuTgeam<T>(handle, opA, opB, Am, Bm, Cm, 1.0, 0.0);
+    }
+  }
+  gpuAssert(gpu::DeviceSynchronize());
+  gpuAssert(gpu::Free(A));
+  gpuAssert(gpu::Free(B));
+  gpuAssert(gpu::Free(C));
+}
 
 template<typename T>
 class GEMM_Executor : public Executor<GEMM_Inputs<T>, GEMM_Key, GEMM_Options> {
 protected:
-  void warmup(GEMM_Inputs<T> params, [[maybe_unused]] GEMM_Options opts,
-              [[maybe_unused]] Stream s) override {
-    size_t n = 8;
-    double *A, *B, *C;
-    gpuAssert(gpu::Malloc(&A, n*n*sizeof(double)));
-    gpuAssert(gpu::Malloc(&B, n*n*sizeof(double)));
-    gpuAssert(gpu::Malloc(&C, n*n*sizeof(double)));
-
-    std::vector<BLAS_Operation> ops = {gpu::BLAS_OP_N, gpu::BLAS_OP_T};
-
-    for (auto &opA : ops) {
-      for (auto &opB : ops) {
-        double alpha = 1.0;
-        double beta = 0.0;
-        gpu::blasDgemm(params.handle, opA, opB, n,n,n, &alpha, A,n,B,n, &beta, C,n);
-        gpu::blasDgeam(params.handle, opA, opB, n,n, &alpha, A, n, &beta, B, n, C, n);
-      }
-    }
-    gpuAssert(gpu::DeviceSynchronize());
-    gpuAssert(gpu::Free(A));
-    gpuAssert(gpu::Free(B));
-    gpuAssert(gpu::Free(C));
+  void warmup(gpu::blasHandle_t handle) override {
+    gemm_warmup<T>(handle);
   }
 };
 
 template<typename T>
 class GEMM_Executor_Pad : public Executor<GEMM_Inputs<T>, GEMM_Key, GEMM_Options_Pad> {
 protected:
-  void warmup(GEMM_Inputs<T> params, [[maybe_unused]] GEMM_Options_Pad opts,
-              [[maybe_unused]] Stream s) override {
-    size_t n = 8;
-    double *A, *B, *C;
-    gpuAssert(gpu::Malloc(&A, n*n*sizeof(double)));
-    gpuAssert(gpu::Malloc(&B, n*n*sizeof(double)));
-    gpuAssert(gpu::Malloc(&C, n*n*sizeof(double)));
-
-    std::vector<BLAS_Operation> ops = {gpu::BLAS_OP_N, gpu::BLAS_OP_T};
-
-    for (auto &opA : ops) {
-      for (auto &opB : ops) {
-        double alpha = 1.0;
-        double beta = 0.0;
-        gpu::blasDgemm(params.handle, opA, opB, n,n,n, &alpha, A,n,B,n, &beta, C,n);
-        gpu::blasDgeam(params.handle, opA, opB, n,n, &alpha, A, n, &beta, B, n, C, n);
-      }
+  void warmup(gpu::blasHandle_t handle) override {
+    gemm_warmup<T>(handle);
+  }
+};
+
+// Executor for multi-device plans. The team defaults to the shared team 
+// of the device current when the executor is created. Only the calling 
+// device's workspace is accounted for; the other members keep their own.
+template<typename T>
+class GEMM_Executor_Distributed 
+    : public Executor<GEMM_Inputs<T>, GEMM_Key, GEMM_Options_Distributed> {
+  std::shared_ptr<Device_Team> team = Device_Team::shared();
+
+protected:
+  void warmup(gpu::blasHandle_t handle) override {
+    int home;
+    gpuAssert(gpu::GetDevice(&home));
+    gemm_warmup<T>(handle);
+    for (size_t i = 1; i < team->size(); i++) {
+      gpuAssert(gpu::SetDevice((*team)[i].device));
+      gemm_warmup<T>((*team)[i].handles[0]);
+    }
+    gpuAssert(gpu::SetDevice(home));
+  }
+
+  bool capturable() const override { return false; }
+
+  void internal_execute(GEMM_Inputs<T> params, GEMM_Options_Distributed opts, 
+                        Workspace space, [[maybe_unused]] Stream s) override {
+    auto &operation = this->formed(params, opts, [&]() {
+      return optimize(opts.form_operation(params, *team), this->elided_passes);
+    });
+    if (operation->workspace_req_bytes() > space.size<char>()) {
+      throw "internal_execute: Insufficient workspace";
     }
+    operation->execute(params.handle, Workspace(), space);
+  }
+
+public:
+  void set_team(std::shared_ptr<Device_Team> new_team) {
+    team = new_team;
+    this->formed_operations.clear();
+  }
+  Device_Team& get_team() { return *team; }
+
+  size_t calculate_workspace(GEMM_Inputs<T> params, 
+                             GEMM_Options_Distributed opts) override {
+    auto &sizes = this->workspace_sizes[params];
+    if (auto search = sizes.find(opts); search != sizes.end())
+      return search->second;
+
+    size_t elided = 0;
+    auto operation = optimize(opts.form_operation(params, *team), elided);
+    return sizes[opts] = operation->workspace_req_bytes();
+  }
+};
+
+// Executor for out-of-core plans, where A, B and C are in host memory. 
+// The workspace is device memory for the tile buffers; the pinned 
+// staging is kept by the executor.
+template<typename T>
+class GEMM_Executor_Out_Of_Core 
+    : public Executor<GEMM_Inputs<T>, GEMM_Key, GEMM_Options_Out_Of_Core> {
+  std::shared_ptr<Host_Staging> staging = std::make_shared<Host_Staging>();
+
+protected:
+  void warmup(gpu::blasHandle_t handle) override {
+    gemm_warmup<T>(handle);
+  }
+
+  bool capturable() const override { return false; }
+
+  void internal_execute(GEMM_Inputs<T> params, GEMM_Options_Out_Of_Core opts, 
+                        Workspace space, [[maybe_unused]] Stream s) override {
+    auto &operation = this->formed(params, opts, [&]() {
+      return optimize(opts.form_operation(params, staging), this->elided_passes);
+    });
+    if (operation->workspace_req_bytes() > space.size<char>()) {
+      throw "internal_execute: Insufficient workspace";
+    }
+    operation->execute(params.handle, Workspace(), space);
+  }
+
+public:
+  size_t calculate_workspace(GEMM_Inputs<T> params, 
+                             GEMM_Options_Out_Of_Core opts) override {
+    auto &sizes = this->workspace_sizes[params];
+    if (auto search = sizes.find(opts); search != sizes.end())
+      return search->second;
+
+    size_t elided = 0;
+    auto operation = optimize(opts.form_operation(params, staging), elided);
+    return sizes[opts] = operation->workspace_req_bytes();
+  }
+};
+
+// Executor for reduced precision plans. The first time a problem runs at 
+// a reduced precision, the result is compared against a full precision 
+// GEMM on scratch copies of C, and the relative error 
+// max|C_low - C_ref| / max|C_ref| is recorded. The check is not timed.
+template<typename T>
+class GEMM_Executor_Mixed : public Executor<GEMM_Inputs<T>, GEMM_Key, GEMM_Options_Mixed> {
+  static_assert(std::is_same_v<T,float>, 
+                "Reduced precision GEMM is only available for float");
+
+  std::map<GEMM_Key, std::map<Precision_Op, T>> errors;
+  T tolerance = std::numeric_limits<T>::max();
+
+  T measure_error(GEMM_Inputs<T> params, GEMM_Options_Mixed opts) {
+    size_t m = params.m();
+    size_t n = params.n();
+    T *ref, *low;
+    gpuAssert(gpu::Malloc(&ref, m*n*sizeof(T)));
+    gpuAssert(gpu::Malloc(&low, m*n*sizeof(T)));
+    Matrix<T> R(Workspace(ref, m*n), m, n, m);
+    Matrix<T> L(Workspace(low, m*n), m, n, m);
+
+    // Both start from C so that beta is accounted for
+    gpuTgeam<T>(params.handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, 
+                params.C, R, R, 1.0, 0.0);
+    gpuTgeam<T>(params.handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, 
+                params.C, L, L, 1.0, 0.0);
+    gpuTgemm<T>(params.handle, params.transa, params.transb, 
+                params.A, params.B, R, params.alpha, params.beta);
+    gpuTgemmEx<T>(params.handle, params.transa, params.transb, 
+                  params.A, params.B, L, params.alpha, params.beta,
+                  opts.compute_type());
+    gpuTgeam<T>(params.handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, 
+                R, L, L, -1.0, 1.0);
     gpuAssert(gpu::DeviceSynchronize());
-    gpuAssert(gpu::Free(A));
-    gpuAssert(gpu::Free(B));
-    gpuAssert(gpu::Free(C));
+
+    T diff = gpuTamax<T>(params.handle, L);
+    T scale = gpuTamax<T>(params.handle, R);
+
+    gpuAssert(gpu::Free(ref));
+    gpuAssert(gpu::Free(low));
+    return (scale > 0) ? diff / scale : diff;
+  }
+
+protected:
+  void warmup(gpu::blasHandle_t handle) override {
+    gemm_warmup<T>(handle);
+  }
+
+public:
+  void execute(GEMM_Inputs<T> params, GEMM_Options_Mixed opts, 
+               Workspace space, Stream s, 
+               Device_Timer::Mode sync = Device_Timer::ASYNCHRONOUS) override {
+    auto &key_errors = errors[this->canonical(GEMM_Key(params))];
+    if (!key_errors.count(opts.precision)) {
+      key_errors[opts.precision] = (opts.precision == Precision_Op::FULL)
+                                 ? 0.0 : measure_error(params, opts);
+    }
+
+    // A result outside the tolerance is never returned, the call runs at
+    // full precision instead
+    if (key_errors[opts.precision] > tolerance) 
+      opts.precision = Precision_Op::FULL;
+
+    Executor<GEMM_Inputs<T>, GEMM_Key, GEMM_Options_Mixed>::execute(
+        params, opts, space, s, sync);
   }
+
+  // Largest relative error a call may return, see execute
+  void set_tolerance(T new_tolerance) { tolerance = new_tolerance; }
+
+  // Measured relative error, empty if the precision has not been run 
+  // for this key yet. Errors are kept under canonical keys, see 
+  // Executor::canonical.
+  std::optional<T> error(GEMM_Key key, Precision_Op precision) {
+    if (!errors.count(key) || !errors[key].count(precision)) return {};
+    return errors[key][precision];
+  }
+
+  std::map<GEMM_Key, std::map<Precision_Op, T>>& get_errors() 
+    { return errors; }
 };
 
 }
@@ -5,35 +5,60 @@
 #include "gemm.h"
 #include "syrk.h"
 #include "trsm.h"
+#include "options.h"
 
 namespace rtat {
 
+// Options built from the Options template are encoded as the list of 
+// their factors' levels. Other types specialize from_json.
 template<typename T>
-T from_json(const nlohmann::json);
+T from_json(const nlohmann::json json) {
+  return T::from_factors(json.get<std::vector<std::string>>());
+}
+
+template<typename... Ops>
+nlohmann::json to_json(const Options<Ops...> &opts) {
+  return opts.factors();
+}
 
-template<typename A, typename B, typename C, typename D, typename E>
+template<typename A, typename B, typename C, typename D, typename E,
+  typename F, typename G, typename H, typename I, typename J>
 constexpr bool verify_GEMM_Key_components() {
   return std::is_same_v<A, BLAS_Operation>
       && std::is_same_v<B, BLAS_Operation>
       && std::is_same_v<C, int>
       && std::is_same_v<D, int>
-      && std::is_same_v<E, int>;
+      && std::is_same_v<E, int>
+      && std::is_same_v<F, Stride_Class>
+      && std::is_same_v<G, Stride_Class>
+      && std::is_same_v<H, Stride_Class>
+      && std::is_same_v<I, Align_Class>
+      && std::is_same_v<J, Beta_Class>;
 }
 
 inline nlohmann::json to_json(GEMM_Key key) {
   nlohmann::json json;
-  auto &[opA, opB, m, n, k] = key;
+  auto &[opA, opB, m, n, k, lda, ldb, ldc, align, beta] = key;
   static_assert(verify_GEMM_Key_components<decltype(opA),
-      decltype(opB),decltype(m),decltype(n),decltype(k)>());
+      decltype(opB),decltype(m),decltype(n),decltype(k),
+      decltype(lda),decltype(ldb),decltype(ldc),decltype(align),
+      decltype(beta)>());
 
   json["transA"] = std::string(opA);
   json["transB"] = std::string(opB);
   json["m"] = m;
   json["n"] = n;
   json["k"] = k;
+  json["ldA"] = std::string(lda);
+  json["ldB"] = std::string(ldb);
+  json["ldC"] = std::string(ldc);
+  json["align"] = std::string(align);
+  json["beta"] = std::string(beta);
   return json;
 }
 
+// Keys saved before the layout and beta classes existed are read with 
+// the default classes
 template<>
 inline GEMM_Key from_json(const nlohmann::json json) {
   return GEMM_Key(
@@ -41,7 +66,12 @@ inline GEMM_Key from_json(const nlohmann::json json) {
         BLAS_Operation(json["transB"].get<std::string>()),
         json["m"].get<int>(),
         json["k"].get<int>(),
-        json["n"].get<int>());
+        json["n"].get<int>(),
+        Stride_Class(json.value("ldA", std::string("A"))),
+        Stride_Class(json.value("ldB", std::string("A"))),
+        Stride_Class(json.value("ldC", std::string("A"))),
+        Align_Class(json.value("align", std::string("A"))),
+        Beta_Class(json.value("beta", std::string("0"))));
 }
 
 template<typename A, typename B, typename C>
@@ -108,75 +138,190 @@ inline GEMM_Options_Pad from_json(const nlohmann::json json) {
 }
 
 template<typename A, typename B, typename C, typename D>
+constexpr bool verify_GEMM_Options_Mixed_components() {
+  return std::is_same_v<A, BLAS_Op>
+      && std::is_same_v<B, BLAS_Op>
+      && std::is_same_v<C, BLAS_Op>
+      && std::is_same_v<D, Precision_Op>;
+}
+
+inline nlohmann::json to_json(GEMM_Options_Mixed opts) {
+  nlohmann::json json;
+  auto &[ta, tb, tc, prec] = opts;
+  static_assert(verify_GEMM_Options_Mixed_components<decltype(ta),
+      decltype(tb), decltype(tc), decltype(prec)>());
+
+  json["transA"] = std::string(ta);
+  json["transB"] = std::string(tb);
+  json["transC"] = std::string(tc);
+  json["precision"] = std::string(prec);
+  return json;
+}
+
+template<>
+inline GEMM_Options_Mixed from_json(const nlohmann::json json) {
+  return GEMM_Options_Mixed(
+      BLAS_Op(json["transA"].get<std::string>()),
+      BLAS_Op(json["transB"].get<std::string>()),
+      BLAS_Op(json["transC"].get<std::string>()),
+      Precision_Op(json["precision"].get<std::string>()));
+}
+
+template<typename A, typename B, typename C>
+constexpr bool verify_GEMM_Options_Distributed_components() {
+  return std::is_same_v<A, Split_Op>
+      && std::is_same_v<B, Share_Op>
+      && std::is_same_v<C, Panel_Op>;
+}
+
+inline nlohmann::json to_json(GEMM_Options_Distributed opts) {
+  nlohmann::json json;
+  auto &[split, share, panels] = opts;
+  static_assert(verify_GEMM_Options_Distributed_components<decltype(split),
+      decltype(share), decltype(panels)>());
+
+  json["split"] = std::string(split);
+  json["share"] = std::string(share);
+  json["panels"] = std::string(panels);
+  return json;
+}
+
+template<>
+inline GEMM_Options_Distributed from_json(const nlohmann::json json) {
+  return GEMM_Options_Distributed(
+      Split_Op(json["split"].get<std::string>()),
+      Share_Op(json["share"].get<std::string>()),
+      Panel_Op(json["panels"].get<std::string>()));
+}
+
+template<typename A, typename B>
+constexpr bool verify_GEMM_Options_Out_Of_Core_components() {
+  return std::is_same_v<A, Tile_Op>
+      && std::is_same_v<B, Depth_Op>;
+}
+
+inline nlohmann::json to_json(GEMM_Options_Out_Of_Core opts) {
+  nlohmann::json json;
+  auto &[tile, depth] = opts;
+  static_assert(verify_GEMM_Options_Out_Of_Core_components<decltype(tile),
+      decltype(depth)>());
+
+  json["tile"] = std::string(tile);
+  json["depth"] = std::string(depth);
+  return json;
+}
+
+template<>
+inline GEMM_Options_Out_Of_Core from_json(const nlohmann::json json) {
+  return GEMM_Options_Out_Of_Core(
+      Tile_Op(json["tile"].get<std::string>()),
+      Depth_Op(json["depth"].get<std::string>()));
+}
+
+template<typename A, typename B, typename C, typename D,
+  typename E, typename F, typename G, typename H>
 constexpr bool verify_SYRK_Key_components() {
   return std::is_same_v<A, BLAS_Fill_Mode>
       && std::is_same_v<B, BLAS_Operation>
       && std::is_same_v<C, int>
-      && std::is_same_v<D, int>;
+      && std::is_same_v<D, int>
+      && std::is_same_v<E, Stride_Class>
+      && std::is_same_v<F, Stride_Class>
+      && std::is_same_v<G, Align_Class>
+      && std::is_same_v<H, Beta_Class>;
 }
 
 inline nlohmann::json to_json(SYRK_Key key) {
   nlohmann::json json;
-  auto &[uplo, trans, n, k] = key;
+  auto &[uplo, trans, n, k, lda, ldc, align, beta] = key;
   static_assert(verify_SYRK_Key_components<decltype(uplo),
-      decltype(trans),decltype(n),decltype(k)>());
+      decltype(trans),decltype(n),decltype(k),decltype(lda),
+      decltype(ldc),decltype(align),decltype(beta)>());
 
   json["uplo"] = std::string(uplo);
   json["trans"] = std::string(trans);
   json["n"] = n;
   json["k"] = k;
+  json["ldA"] = std::string(lda);
+  json["ldC"] = std::string(ldc);
+  json["align"] = std::string(align);
+  json["beta"] = std::string(beta);
   return json;
 }
 
+// See from_json<GEMM_Key> for keys saved without classes
 template<>
 inline SYRK_Key from_json(const nlohmann::json json) {
   return SYRK_Key(
         BLAS_Fill_Mode(json["uplo"].get<std::string>()),
         BLAS_Operation(json["trans"].get<std::string>()),
         json["n"].get<int>(),
-        json["k"].get<int>());
+        json["k"].get<int>(),
+        Stride_Class(json.value("ldA", std::string("A"))),
+        Stride_Class(json.value("ldC", std::string("A"))),
+        Align_Class(json.value("align", std::string("A"))),
+        Beta_Class(json.value("beta", std::string("0"))));
 }
 
-template<typename A, typename B>
+// HERK keys are encoded exactly as SYRK keys
+template<>
+inline HERK_Key from_json(const nlohmann::json json) {
+  return HERK_Key(from_json<SYRK_Key>(json));
+}
+
+template<typename A, typename B, typename C, typename D>
 constexpr bool verify_SYRK_Options_components() {
   return std::is_same_v<A, Bool_Op>
-      && std::is_same_v<B, Bool_Op>;
+      && std::is_same_v<B, Bool_Op>
+      && std::is_same_v<C, Bool_Op>
+      && std::is_same_v<D, Bool_Op>;
 }
 
 inline nlohmann::json to_json(SYRK_Options opts) {
   nlohmann::json json;
-  auto &[tA, tC] = opts;
-  static_assert(verify_SYRK_Options_components<decltype(tA),decltype(tC)>());
+  auto &[tA, tC, in_place, triangular] = opts;
+  static_assert(verify_SYRK_Options_components<decltype(tA),decltype(tC),
+      decltype(in_place),decltype(triangular)>());
 
   json["transA"] = std::string(tA);
   json["transC"] = std::string(tC);
+  json["in_place"] = std::string(in_place);
+  json["triangular"] = std::string(triangular);
   return json;
 }
 
+// Plans saved before in_place or triangular existed are read as 
+// full copying plans
 template<>
 inline SYRK_Options from_json(const nlohmann::json json) {
   return SYRK_Options(
       Bool_Op(json["transA"].get<std::string>()),
-      Bool_Op(json["transC"].get<std::string>()));
+      Bool_Op(json["transC"].get<std::string>()),
+      Bool_Op(json.value("in_place", std::string("F"))),
+      Bool_Op(json.value("triangular", std::string("F"))));
 }
 
 template<typename A, typename B, typename C, typename D, 
-  typename E, typename F>
+  typename E, typename F, typename G, typename H, typename I>
 constexpr bool verify_TRSM_Key_components() {
   return std::is_same_v<A, BLAS_Side>
       && std::is_same_v<B, BLAS_Fill_Mode>
       && std::is_same_v<C, BLAS_Operation>
       && std::is_same_v<D, BLAS_Diag>
       && std::is_same_v<E, int>
-      && std::is_same_v<F, int>;
+      && std::is_same_v<F, int>
+      && std::is_same_v<G, Stride_Class>
+      && std::is_same_v<H, Stride_Class>
+      && std::is_same_v<I, Align_Class>;
 }
 
 inline nlohmann::json to_json(TRSM_Key key) {
   nlohmann::json json;
-  auto &[side, uplo, trans, diag, m, n] = key;
+  auto &[side, uplo, trans, diag, m, n, lda, ldb, align] = key;
   static_assert(verify_TRSM_Key_components<decltype(side), 
       decltype(uplo), decltype(trans), decltype(diag),
-      decltype(m), decltype(n)>());
+      decltype(m), decltype(n), decltype(lda), decltype(ldb),
+      decltype(align)>());
 
   json["side"] = std::string(side);
   json["uplo"] = std::string(uplo);
@@ -184,9 +329,13 @@ inline nlohmann::json to_json(TRSM_Key key) {
   json["diag"] = std::string(diag);
   json["m"] = m;
   json["n"] = n;
+  json["ldA"] = std::string(lda);
+  json["ldB"] = std::string(ldb);
+  json["align"] = std::string(align);
   return json;
 }
 
+// See from_json<GEMM_Key> for keys saved without classes
 template<>
 inline TRSM_Key from_json(const nlohmann::json json) {
   return TRSM_Key(
@@ -195,30 +344,42 @@ inline TRSM_Key from_json(const nlohmann::json json) {
       BLAS_Operation(json["trans"].get<std::string>()),
       BLAS_Diag(json["diag"].get<std::string>()),
       json["m"].get<int>(), 
-      json["n"].get<int>());
+      json["n"].get<int>(),
+      Stride_Class(json.value("ldA", std::string("A"))),
+      Stride_Class(json.value("ldB", std::string("A"))),
+      Align_Class(json.value("align", std::string("A"))));
 }
 
-template<typename A, typename B>
+template<typename A, typename B, typename C, typename D>
 constexpr bool verify_TRSM_Options_components() {
   return std::is_same_v<A, Bool_Op>
-      && std::is_same_v<B, Bool_Op>;
+      && std::is_same_v<B, Bool_Op>
+      && std::is_same_v<C, Bool_Op>
+      && std::is_same_v<D, Bool_Op>;
 }
 
 inline nlohmann::json to_json(TRSM_Options opts) {
   nlohmann::json json;
-  auto &[swap_side, tA] = opts;
-  static_assert(verify_TRSM_Options_components<decltype(swap_side),decltype(tA)>());
+  auto &[swap_side, tA, in_place, triangular] = opts;
+  static_assert(verify_TRSM_Options_components<decltype(swap_side),decltype(tA),
+      decltype(in_place),decltype(triangular)>());
 
   json["swap_side"] = std::string(swap_side);
   json["transA"] = std::string(tA);
+  json["in_place"] = std::string(in_place);
+  json["triangular"] = std::string(triangular);
   return json;
 }
 
+// Plans saved before in_place or triangular existed are read as 
+// full copying plans
 template<>
 inline TRSM_Options from_json(const nlohmann::json json) {
   return TRSM_Options(
       Bool_Op(json["swap_side"].get<std::string>()),
-      Bool_Op(json["transA"].get<std::string>()));
+      Bool_Op(json["transA"].get<std::string>()),
+      Bool_Op(json.value("in_place", std::string("F"))),
+      Bool_Op(json.value("triangular", std::string("F"))));
 }
 
 }
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <gpu-api.h>
+#include <matrix.h>
+
+namespace rtat {
+
+// Coarse classes of operand layout and scalars, kept in keys so that
+// problems of one shape which perform differently are planned apart.
+// Defaults describe the common case, and are assumed for keys saved
+// before the classes existed.
+
+// Columns starting on cache lines are read in whole lines. Strides of a
+// multiple of conflict_stride bytes map every column to the same cache
+// sets and memory banks, and are classed apart.
+const size_t cache_line = 128;
+const size_t conflict_stride = 4096;
+
+enum Stride_Class_t { STRIDE_ALIGNED, STRIDE_CONFLICT, STRIDE_UNALIGNED };
+
+struct Stride_Class_Str_Map {
+  static std::map<Stride_Class_t, std::string> map() {
+    return {{STRIDE_ALIGNED,   "A"},
+            {STRIDE_CONFLICT,  "P"},
+            {STRIDE_UNALIGNED, "U"}};
+  }
+};
+using Stride_Class = String_Rep<Stride_Class_Str_Map>;
+
+template<typename T>
+Stride_Class stride_class(const Matrix<T> &A) {
+  size_t bytes = A.dims().ld*sizeof(T);
+  if (bytes % conflict_stride == 0) return STRIDE_CONFLICT;
+  if (bytes % cache_line == 0) return STRIDE_ALIGNED;
+  return STRIDE_UNALIGNED;
+}
+
+// Whether every operand starts on a cache line
+enum Align_Class_t { ALIGN_LINE, ALIGN_ELEMENT };
+
+struct Align_Class_Str_Map {
+  static std::map<Align_Class_t, std::string> map() {
+    return {{ALIGN_LINE,    "A"},
+            {ALIGN_ELEMENT, "U"}};
+  }
+};
+using Align_Class = String_Rep<Align_Class_Str_Map>;
+
+template<typename... T>
+Align_Class align_class(const Matrix<T>&... operands) {
+  bool aligned = ((uintptr_t(operands.ptr()) % cache_line == 0) && ...);
+  return aligned ? ALIGN_LINE : ALIGN_ELEMENT;
+}
+
+// Whether the output is overwritten, accumulated into, or scaled
+enum Beta_Class_t { BETA_ZERO, BETA_ONE, BETA_OTHER };
+
+struct Beta_Class_Str_Map {
+  static std::map<Beta_Class_t, std::string> map() {
+    return {{BETA_ZERO,  "0"},
+            {BETA_ONE,   "1"},
+            {BETA_OTHER, "X"}};
+  }
+};
+using Beta_Class = String_Rep<Beta_Class_Str_Map>;
+
+template<typename T>
+Beta_Class beta_class(T beta) {
+  if (beta == T(0)) return BETA_ZERO;
+  if (beta == T(1)) return BETA_ONE;
+  return BETA_OTHER;
+}
+
+}
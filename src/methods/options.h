@@ -0,0 +1,281 @@
+#pragma once
+#include <array>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace rtat {
+
+// One tuning factor, taking one of the listed values. Values are held by
+// their level, i.e. position in the list, so that options built from
+// factors have a dense index. Values outside the list can be held, e.g.
+// as read from old plans, but have no index.
+template<typename T, T... Values>
+class Option {
+public:
+  using Value = T;
+  static constexpr size_t count = sizeof...(Values);
+  static constexpr std::array<T, count> values = {Values...};
+
+private:
+  size_t lvl = 0;
+  T val = values[0];
+
+  static constexpr size_t find(T value) {
+    for (size_t l = 0; l < count; l++)
+      if (values[l] == value) return l;
+    return count;
+  }
+
+public:
+  constexpr Option() = default;
+  constexpr Option(T value) : lvl(find(value)), val(value) {}
+
+  static constexpr Option from_level(size_t level) {
+    return Option(values[level]);
+  }
+
+  constexpr T value() const { return val; }
+  constexpr operator T() const { return val; }
+  constexpr size_t level() const { return lvl; }
+  constexpr bool valid() const { return lvl < count; }
+
+  // Levels are written as Bool_Op writes bools, characters as
+  // themselves and anything else as an integer
+  std::string str() const { return str(val); }
+
+  static Option parse(const std::string &s) {
+    for (auto &v : values)
+      if (str(v) == s) return Option(v);
+    throw std::runtime_error("Invalid Option string "+s);
+  }
+
+private:
+  static std::string str(T v) {
+    if constexpr (std::is_same_v<T, bool>) {
+      return v ? "T" : "F";
+    } else if constexpr (std::is_same_v<T, char>) {
+      return std::string(1, v);
+    } else {
+      return std::to_string((long long)v);
+    }
+  }
+};
+
+// Options made of independent factors, each an Option. Every
+// combination has a dense index, first factor most significant, so
+// planner tables can be arrays indexed by it rather than maps, see
+// Option_Map. Encoding, ordering, enumeration and JSON (see
+// json_encoding.h) come from the factors.
+//
+// A plan type derives from it, adding form_operation, and is converted
+// from its base:
+//
+//   struct My_Options : Options<Option<int, 16, 32>, Option<bool, 0, 1>> {
+//     using Options::Options;
+//     My_Options(Options o) : Options(o) {}
+//     std::unique_ptr<MatrixOp<T>> form_operation(My_Inputs<T>);
+//   };
+template<typename... Ops>
+class Options {
+  std::tuple<Ops...> ops;
+
+  template<size_t... I>
+  constexpr size_t index(std::index_sequence<I...>) const {
+    size_t idx = 0;
+    ((idx = idx*Ops::count + std::get<I>(ops).level()), ...);
+    return idx;
+  }
+
+  template<size_t... I>
+  static constexpr Options from_index(size_t idx, std::index_sequence<I...>) {
+    Options ret;
+    size_t radix[] = {Ops::count...};
+    size_t level[sizeof...(Ops)] = {};
+    for (size_t f = sizeof...(Ops); f-- > 0;) {
+      level[f] = idx % radix[f];
+      idx /= radix[f];
+    }
+    ((std::get<I>(ret.ops) = Ops::from_level(level[I])), ...);
+    return ret;
+  }
+
+  template<size_t... I>
+  constexpr bool valid(std::index_sequence<I...>) const {
+    return (std::get<I>(ops).valid() && ...);
+  }
+
+  template<size_t... I>
+  static Options parse(const std::vector<std::string> &levels,
+                       std::index_sequence<I...>) {
+    Options ret;
+    ((std::get<I>(ret.ops) = Ops::parse(levels.at(I))), ...);
+    return ret;
+  }
+
+  template<size_t... I>
+  static constexpr std::array<Options, sizeof...(I)> all(
+      std::index_sequence<I...>) {
+    return {from_index(I)...};
+  }
+
+  using Indices = std::index_sequence_for<Ops...>;
+
+public:
+  static constexpr size_t count = (Ops::count * ... * 1);
+
+  constexpr Options() = default;
+  constexpr Options(typename Ops::Value... values) : ops(Ops(values)...) {}
+
+  template<size_t I>
+  constexpr auto get() const { return std::get<I>(ops).value(); }
+
+  constexpr bool valid() const { return valid(Indices()); }
+
+  // Only meaningful for valid options
+  constexpr size_t index() const { return index(Indices()); }
+  static constexpr Options from_index(size_t idx) {
+    return from_index(idx, Indices());
+  }
+
+  static constexpr std::array<Options, count> all() {
+    return all(std::make_index_sequence<count>());
+  }
+
+  static std::vector<Options> enumerate() {
+    auto opts = all();
+    return std::vector<Options>(opts.begin(), opts.end());
+  }
+
+  static constexpr Options default_opts() { return from_index(0); }
+
+  // Ordered by level, factor by factor, which for valid options is
+  // index order
+  constexpr bool operator<(const Options &o) const {
+    return std::apply([&](auto&... a) {
+      return std::apply([&](auto&... b) {
+        return std::make_tuple(a.level()...) < std::make_tuple(b.level()...);
+      }, o.ops);
+    }, ops);
+  }
+
+  // See GEMM_Options::factors
+  std::vector<std::string> factors() const {
+    return std::apply([](auto&... op) {
+      return std::vector<std::string>{op.str()...};
+    }, ops);
+  }
+
+  static Options from_factors(const std::vector<std::string> &levels) {
+    if (levels.size() != sizeof...(Ops))
+      throw std::runtime_error("Wrong number of Options factors");
+    return parse(levels, Indices());
+  }
+
+  operator std::string() const {
+    std::string ret;
+    for (auto &level : factors())
+      ret += (ret.empty() ? "" : ",") + level;
+    return ret;
+  }
+
+  friend std::ostream& operator<<(std::ostream &os, const Options &opts) {
+    os << std::string(opts);
+    return os;
+  }
+};
+
+// Per option values for options with a dense index, held in an array.
+// Behaves as the std::map it stands in for: entries exist once looked up
+// with operator[], and iterate in index order.
+template<typename Opts, typename V>
+class Option_Table {
+  using Entry = std::pair<const Opts, V>;
+  std::array<std::optional<Entry>, Opts::count> entries;
+  size_t used = 0;
+
+public:
+  template<typename Table, typename E>
+  class Iterator {
+    Table *table;
+    size_t i;
+
+    void skip() {
+      while (i < Opts::count && !table->entries[i]) i++;
+    }
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Entry;
+    using difference_type = std::ptrdiff_t;
+    using pointer = E*;
+    using reference = E&;
+
+    Iterator(Table *table, size_t i) : table(table), i(i) { skip(); }
+
+    E& operator*() const { return *table->entries[i]; }
+    E* operator->() const { return &*table->entries[i]; }
+    Iterator& operator++() { i++; skip(); return *this; }
+    bool operator==(const Iterator &o) const { return i == o.i; }
+    bool operator!=(const Iterator &o) const { return i != o.i; }
+  };
+  using iterator = Iterator<Option_Table, Entry>;
+  using const_iterator = Iterator<const Option_Table, const Entry>;
+
+  V& operator[](const Opts &opts) {
+    if (!opts.valid())
+      throw std::out_of_range("Options outside the table "+std::string(opts));
+    auto &entry = entries[opts.index()];
+    if (!entry) {
+      entry.emplace(opts, V());
+      used++;
+    }
+    return entry->second;
+  }
+
+  iterator find(const Opts &opts) {
+    if (!opts.valid() || !entries[opts.index()]) return end();
+    return iterator(this, opts.index());
+  }
+  const_iterator find(const Opts &opts) const {
+    if (!opts.valid() || !entries[opts.index()]) return end();
+    return const_iterator(this, opts.index());
+  }
+
+  size_t count(const Opts &opts) const { return find(opts) != end(); }
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, Opts::count); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, Opts::count); }
+
+  size_t size() const { return used; }
+  bool empty() const { return used == 0; }
+};
+
+// Largest option space held in an Option_Table rather than a map
+const size_t dense_option_limit = 1024;
+
+template<typename Opts, typename V, typename = void>
+struct Option_Map_Select { using type = std::map<Opts, V>; };
+
+template<typename Opts, typename V>
+struct Option_Map_Select<Opts, V, std::enable_if_t<
+    (Opts::count <= dense_option_limit)
+    && std::is_same_v<decltype(std::declval<const Opts&>().index()), size_t>
+    && std::is_same_v<decltype(std::declval<const Opts&>().valid()), bool>>> {
+  using type = Option_Table<Opts, V>;
+};
+
+// Per option values, in an array for options with a dense index (count,
+// index() and valid()) and a map otherwise
+template<typename Opts, typename V>
+using Option_Map = typename Option_Map_Select<Opts, V>::type;
+
+}
@@ -2,12 +2,17 @@
 #include "gpu-api.h"
 #include "matrixop.h"
 #include <sstream>
+#include <tuple>
 using namespace rtat;
 
+// Tile size for in place transposes
+static const size_t transpose_tile = 64;
+
 // SYRK_Key implementation
 SYRK_Key::operator std::string() const {
   std::stringstream ss;
-  ss << uplo << "," << trans << "," << n << "," << k;
+  ss << uplo << "," << trans << "," << n << "," << k << ","
+     << lda << ldc << "," << align << "," << beta;
 
   std::string ret;
   ss >> ret;
@@ -15,7 +20,17 @@ SYRK_Key::operator std::string() const {
 }
 
 bool SYRK_Key::operator<(const SYRK_Key& rhs) const {
-  return std::string(*this) < std::string(rhs);
+  return std::tie(uplo, trans, n, k, lda, ldc, align, beta)
+       < std::tie(rhs.uplo, rhs.trans, rhs.n, rhs.k, 
+                  rhs.lda, rhs.ldc, rhs.align, rhs.beta);
+}
+
+SYRK_Key SYRK_Key::mirror() const {
+  return SYRK_Key(!uplo, trans, n, k, lda, ldc, align, beta);
+}
+
+bool SYRK_Key::canonical() const {
+  return !(mirror() < *this);
 }
 
 std::ostream& operator<<(std::ostream& os, const SYRK_Key& dt) {
@@ -30,7 +45,14 @@ std::vector<SYRK_Options> SYRK_Options::enumerate() {
 
   for (auto transa : {Bool_Op(false), Bool_Op(true)})
     for (auto transc : {Bool_Op(false), Bool_Op(true)})
-      ret.push_back(SYRK_Options(transa,transc));
+      for (auto in_place : {Bool_Op(false), Bool_Op(true)})
+        for (auto tri : {Bool_Op(false), Bool_Op(true)}) {
+          // in_place only changes transposes of C, and triangular only 
+          // copies of C
+          if (in_place && !transc) continue;
+          if (tri && (!transc || in_place)) continue;
+          ret.push_back(SYRK_Options(transa,transc,in_place,tri));
+        }
   return ret;
 }
 
@@ -38,6 +60,8 @@ SYRK_Options::operator std::string() const {
   std::stringstream ss;
   ss << std::string(transpose_A);
   ss << std::string(transpose_C);
+  ss << std::string(in_place);
+  ss << std::string(triangular);
 
   std::string ret;
   ss >> ret;
@@ -45,7 +69,15 @@ SYRK_Options::operator std::string() const {
 }
 
 bool SYRK_Options::operator<(const SYRK_Options& o) const {
-  return std::string(*this) < std::string(o);
+  return std::tie(transpose_A.op, transpose_C.op, in_place.op, triangular.op)
+       < std::tie(o.transpose_A.op, o.transpose_C.op, o.in_place.op, 
+                  o.triangular.op);
+}
+
+// Transposing C computes the mirror's triangle, and vice versa
+SYRK_Options SYRK_Options::mirror() const {
+  Bool_Op tc = transpose_C;
+  return SYRK_Options(transpose_A, !tc, in_place, triangular);
 }
 
 std::ostream& operator<<(std::ostream& os, const SYRK_Options opts) {
@@ -56,13 +88,15 @@ std::ostream& operator<<(std::ostream& os, const SYRK_Options opts) {
 std::istream& operator>>(std::istream &is, SYRK_Options &opts) {
   std::string s;
   is >> s;
-  if (s.size() != 2) {
+  if (s.size() != 4) {
     is.setstate(std::ios::failbit);
     return is;
   }
     
   opts.transpose_A = Bool_Op(s[0]);
   opts.transpose_C = Bool_Op(s[1]);
+  opts.in_place = Bool_Op(s[2]);
+  opts.triangular = Bool_Op(s[3]);
 
   return is;
 }
@@ -73,6 +107,8 @@ std::unique_ptr<MatrixOp<T>> SYRK_Options::form_operation(SYRK_Inputs<T> params)
   std::unique_ptr<MatrixOp<T>> A = std::make_unique<NoOp<T>>(params.A);
   std::unique_ptr<MatrixOp<T>> C = std::make_unique<NoOp<T>>(params.C);
 
+  // A is only read, and may be read concurrently by other calls, so it 
+  // is always transposed into a copy
   if (transpose_A) {
     params.trans = (params.trans == gpu::BLAS_OP_N)
       ? gpu::BLAS_OP_T
@@ -81,32 +117,132 @@ std::unique_ptr<MatrixOp<T>> SYRK_Options::form_operation(SYRK_Inputs<T> params)
         std::move(A), 1.0, true, 1);
   }
 
+  std::unique_ptr<MatrixOp<T>> result;
   if (transpose_C) {
     // Transpose B
     params.uplo = (params.uplo == gpu::BLAS_FILL_MODE_UPPER) 
       ? gpu::BLAS_FILL_MODE_LOWER
       : gpu::BLAS_FILL_MODE_UPPER;
-    std::unique_ptr<MatrixOp<T>> scratch = std::make_unique<MatrixSyrkAlloc<T>>(
-        std::move(A), 
-        params.uplo == gpu::BLAS_FILL_MODE_LOWER,
-        params.trans == gpu::BLAS_OP_T,
-        params.alpha);
-
-    return std::make_unique<MatrixAccumulate<T>>(
-        std::move(scratch), std::move(C), 1.0, params.beta, true);
+    if (in_place) {
+      C = std::make_unique<MatrixTransposeInPlace<T>>(
+          std::move(C), gpu::BLAS_OP_T, transpose_tile);
+      C = std::make_unique<MatrixSyrk<T>>(
+          std::move(A), std::move(C), 
+          params.uplo == gpu::BLAS_FILL_MODE_LOWER,
+          params.trans == gpu::BLAS_OP_T,
+          params.alpha, params.beta);
+      result = std::make_unique<MatrixTransposeInPlace<T>>(
+          std::move(C), gpu::BLAS_OP_T, transpose_tile);
+    } else if (triangular) {
+      // Only the computed triangle is read, so it needs no zero fill
+      std::unique_ptr<MatrixOp<T>> scratch = std::make_unique<MatrixSyrkAlloc<T>>(
+          std::move(A), 
+          params.uplo == gpu::BLAS_FILL_MODE_LOWER,
+          params.trans, params.alpha, 1, false);
+
+      result = std::make_unique<MatrixAccumulateTriangle<T>>(
+          std::move(scratch), std::move(C), 1.0, params.beta, 
+          gpu::BLAS_OP_T, params.uplo == gpu::BLAS_FILL_MODE_UPPER);
+    } else {
+      std::unique_ptr<MatrixOp<T>> scratch = std::make_unique<MatrixSyrkAlloc<T>>(
+          std::move(A), 
+          params.uplo == gpu::BLAS_FILL_MODE_LOWER,
+          params.trans == gpu::BLAS_OP_T,
+          params.alpha);
+
+      result = std::make_unique<MatrixAccumulate<T>>(
+          std::move(scratch), std::move(C), 1.0, params.beta, true);
+    }
   } else {
-    return std::make_unique<MatrixSyrk<T>>(
+    result = std::make_unique<MatrixSyrk<T>>(
         std::move(A), std::move(C), 
         params.uplo == gpu::BLAS_FILL_MODE_LOWER,
         params.trans == gpu::BLAS_OP_T,
         params.alpha, params.beta);
   }
+
+  return result;
 }
 
 template std::unique_ptr<MatrixOp<double>> 
   SYRK_Options::form_operation(SYRK_Inputs<double>);
 
+template<typename T>
+std::unique_ptr<MatrixOp<T>> SYRK_Options::form_operation(HERK_Inputs<T> params) {
+
+  std::unique_ptr<MatrixOp<T>> A = std::make_unique<NoOp<T>>(params.A);
+  std::unique_ptr<MatrixOp<T>> C = std::make_unique<NoOp<T>>(params.C);
+
+  if (transpose_A) {
+    params.trans = compose(params.trans, gpu::BLAS_OP_C);
+    A = std::make_unique<MatrixMove<T>>(
+        std::move(A), 1.0, gpu::BLAS_OP_C, 1);
+  }
+
+  std::unique_ptr<MatrixOp<T>> result;
+  if (transpose_C) {
+    // C is Hermitian, so compute the opposite triangle and 
+    // conjugate transpose it back
+    params.uplo = !params.uplo;
+    if (in_place) {
+      C = std::make_unique<MatrixTransposeInPlace<T>>(
+          std::move(C), gpu::BLAS_OP_C, transpose_tile);
+      C = std::make_unique<MatrixHerk<T>>(
+          std::move(A), std::move(C), 
+          params.uplo == gpu::BLAS_FILL_MODE_LOWER,
+          params.trans,
+          params.alpha, params.beta);
+      result = std::make_unique<MatrixTransposeInPlace<T>>(
+          std::move(C), gpu::BLAS_OP_C, transpose_tile);
+    } else if (triangular) {
+      std::unique_ptr<MatrixOp<T>> scratch = std::make_unique<MatrixHerkAlloc<T>>(
+          std::move(A), 
+          params.uplo == gpu::BLAS_FILL_MODE_LOWER,
+          params.trans, params.alpha, 1, false);
+
+      result = std::make_unique<MatrixAccumulateTriangle<T>>(
+          std::move(scratch), std::move(C), 1.0, params.beta, 
+          gpu::BLAS_OP_C, params.uplo == gpu::BLAS_FILL_MODE_UPPER);
+    } else {
+      std::unique_ptr<MatrixOp<T>> scratch = std::make_unique<MatrixHerkAlloc<T>>(
+          std::move(A), 
+          params.uplo == gpu::BLAS_FILL_MODE_LOWER,
+          params.trans,
+          params.alpha);
+
+      result = std::make_unique<MatrixAccumulate<T>>(
+          std::move(scratch), std::move(C), 1.0, params.beta, gpu::BLAS_OP_C);
+    }
+  } else {
+    result = std::make_unique<MatrixHerk<T>>(
+        std::move(A), std::move(C), 
+        params.uplo == gpu::BLAS_FILL_MODE_LOWER,
+        params.trans,
+        params.alpha, params.beta);
+  }
+
+  return result;
+}
+
 template std::unique_ptr<MatrixOp<float>> 
   SYRK_Options::form_operation(SYRK_Inputs<float>);
 
+template std::unique_ptr<MatrixOp<std::complex<double>>> 
+  SYRK_Options::form_operation(SYRK_Inputs<std::complex<double>>);
+
+template std::unique_ptr<MatrixOp<std::complex<float>>> 
+  SYRK_Options::form_operation(SYRK_Inputs<std::complex<float>>);
+
+template std::unique_ptr<MatrixOp<double>> 
+  SYRK_Options::form_operation(HERK_Inputs<double>);
+
+template std::unique_ptr<MatrixOp<float>> 
+  SYRK_Options::form_operation(HERK_Inputs<float>);
+
+template std::unique_ptr<MatrixOp<std::complex<double>>> 
+  SYRK_Options::form_operation(HERK_Inputs<std::complex<double>>);
+
+template std::unique_ptr<MatrixOp<std::complex<float>>> 
+  SYRK_Options::form_operation(HERK_Inputs<std::complex<float>>);
+
 
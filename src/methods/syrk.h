@@ -4,6 +4,7 @@
 #include <matrixop.h>
 #include <executor.h>
 #include "base_options.h"
+#include "key_classes.h"
 
 namespace rtat {
 
@@ -28,36 +29,116 @@ struct SYRK_Inputs {
 
   size_t n() {return C.dims().m;}
   size_t k() {return trans == gpu::BLAS_OP_N ? A.dims().n : A.dims().m;}
+
+  bool operator==(const SYRK_Inputs &o) const {
+    return handle == o.handle && uplo == o.uplo && trans == o.trans
+        && A == o.A && C == o.C && alpha == o.alpha && beta == o.beta;
+  }
 };
 
+// Hermitian rank-k update, C := alpha op(A) op(A)^H + beta C with trans 
+// either N or C. Shares keys and options with SYRK.
+template<typename T>
+struct HERK_Inputs {
+  using Scalar = T;
 
+  gpu::blasHandle_t handle;
+  BLAS_Fill_Mode uplo;
+  BLAS_Operation trans; 
+  const Matrix<T> A;
+        Matrix<T> C;
+  const Real_T<T> alpha; 
+  const Real_T<T> beta; 
+
+  HERK_Inputs(gpu::blasHandle_t handle, BLAS_Fill_Mode uplo, 
+              BLAS_Operation trans, 
+              const Matrix<T> A, Matrix<T> C, 
+              Real_T<T> alpha, Real_T<T> beta)
+        : handle(handle), uplo(uplo), trans(trans), 
+          A(A), C(C), alpha(alpha), beta(beta) {}
+
+  size_t n() {return C.dims().m;}
+  size_t k() {return trans == gpu::BLAS_OP_N ? A.dims().n : A.dims().m;}
+
+  bool operator==(const HERK_Inputs &o) const {
+    return handle == o.handle && uplo == o.uplo && trans == o.trans
+        && A == o.A && C == o.C && alpha == o.alpha && beta == o.beta;
+  }
+};
+
+
+// Layout and beta classes as for GEMM_Key
 struct SYRK_Key {
   BLAS_Fill_Mode uplo;
   BLAS_Operation trans; 
   int n; int k;
+  Stride_Class lda; Stride_Class ldc;
+  Align_Class align;
+  Beta_Class beta;
 
   SYRK_Key(BLAS_Fill_Mode uplo, BLAS_Operation trans,
-           int n, int k) : uplo(uplo), trans(trans), 
-                           n(n), k(k) {}
+           int n, int k,
+           Stride_Class lda = STRIDE_ALIGNED,
+           Stride_Class ldc = STRIDE_ALIGNED,
+           Align_Class align = ALIGN_LINE,
+           Beta_Class beta = BETA_ZERO) 
+    : uplo(uplo), trans(trans), n(n), k(k), 
+      lda(lda), ldc(ldc), align(align), beta(beta) {}
 
   template<typename T>
   SYRK_Key(SYRK_Inputs<T> i) : 
-    SYRK_Key(i.uplo, i.trans, i.n(), i.k()) {}
-
+    SYRK_Key(i.uplo, i.trans, i.n(), i.k(), stride_class(i.A),
+             stride_class(i.C), align_class(i.A, i.C), 
+             beta_class(i.beta)) {}
+
+  // The other triangle of the same product, see GEMM_Key::mirror
+  SYRK_Key mirror() const;
+  bool canonical() const;
+
+  // See GEMM_Key::map_dims
+  template<typename F>
+  SYRK_Key map_dims(F f) const { 
+    int fn = f(n), fk = f(k);
+    return SYRK_Key(uplo, trans, fn, fk, lda, ldc, align, beta); 
+  }
 
   operator std::string() const;
   bool operator<(const SYRK_Key&) const;
   friend std::ostream& operator<<(std::ostream&, const SYRK_Key&); 
 };
 
+struct HERK_Key : public SYRK_Key {
+  using SYRK_Key::SYRK_Key;
+  HERK_Key(SYRK_Key key) : SYRK_Key(key) {}
+
+  template<typename T>
+  HERK_Key(HERK_Inputs<T> i) : 
+    SYRK_Key(i.uplo, i.trans, i.n(), i.k(), stride_class(i.A),
+             stride_class(i.C), align_class(i.A, i.C), 
+             beta_class(i.beta)) {}
+
+  HERK_Key mirror() const { return SYRK_Key::mirror(); }
+
+  template<typename F>
+  HERK_Key map_dims(F f) const { return SYRK_Key::map_dims(f); }
+};
+
 
+// in_place transposes C in place with O(tile) scratch instead of 
+// copying it, transposing back afterwards. A is only read, so is always
+// copied. triangular accumulates only the referenced triangle of a 
+// transposed C.
 struct SYRK_Options {
   Bool_Op transpose_A;
   Bool_Op transpose_C;
+  Bool_Op in_place;
+  Bool_Op triangular;
 
   SYRK_Options() = default;
-  SYRK_Options(Bool_Op transpose_A, Bool_Op transpose_C) :
-    transpose_A(transpose_A), transpose_C(transpose_C) {}
+  SYRK_Options(Bool_Op transpose_A, Bool_Op transpose_C, 
+               Bool_Op in_place = false, Bool_Op triangular = false) :
+    transpose_A(transpose_A), transpose_C(transpose_C), in_place(in_place),
+    triangular(triangular) {}
 
   static SYRK_Options default_opts() {
     return SYRK_Options();
@@ -65,8 +146,23 @@ struct SYRK_Options {
 
   static std::vector<SYRK_Options> enumerate();
 
+  // The equivalent plan for the mirrored key
+  SYRK_Options mirror() const;
+
   operator std::string() const;
 
+  // See GEMM_Options::factors
+  std::vector<std::string> factors() const {
+    return {transpose_A, transpose_C, in_place, triangular};
+  }
+
+  // See GEMM_Options::index
+  static constexpr size_t count = 16;
+  size_t index() const {
+    return transpose_A.op*8 + transpose_C.op*4 + in_place.op*2 + triangular.op;
+  }
+  bool valid() const { return true; }
+
   bool operator<(const SYRK_Options&) const;
 
   friend std::ostream& operator<<(std::ostream&, const SYRK_Options);
@@ -74,36 +170,32 @@ struct SYRK_Options {
 
   template<typename T>
   std::unique_ptr<MatrixOp<T>> form_operation(SYRK_Inputs<T>);
+
+  template<typename T>
+  std::unique_ptr<MatrixOp<T>> form_operation(HERK_Inputs<T>);
 };
 
 
 template<typename T>
 class SYRK_Executor : public Executor<SYRK_Inputs<T>, SYRK_Key, SYRK_Options> {
 protected:
-  void warmup(SYRK_Inputs<T> params, [[maybe_unused]] SYRK_Options opts,
-              [[maybe_unused]] Stream s) override {
+  void warmup(gpu::blasHandle_t handle) override {
     size_t n = 64;
-    double *A, *C;
-    gpuAssert(gpu::Malloc(&A, n*n*sizeof(double)));
-    gpuAssert(gpu::Malloc(&C, n*n*sizeof(double)));
+    T *A, *C;
+    gpuAssert(gpu::Malloc(&A, n*n*sizeof(T)));
+    gpuAssert(gpu::Malloc(&C, n*n*sizeof(T)));
+    Matrix<T> Am(Workspace(A, n*n), n, n, n);
+    Matrix<T> Cm(Workspace(C, n*n), n, n, n);
 
     for (auto lower : {false,true}) {
-      for (auto trans : {false,true}) {
-        double alpha = 1.0;
-        double beta = 0.0;
-        auto status = gpu::blasDsyrk(params.handle,
-          lower ? gpu::BLAS_FILL_MODE_LOWER : gpu::BLAS_FILL_MODE_UPPER,
-          trans ? gpu::BLAS_OP_T : gpu::BLAS_OP_N,
-          n, n, 
-          &alpha,
-          A, n,
-          &beta,
-          C, n);
+      for (auto trans : {gpu::BLAS_OP_N, gpu::BLAS_OP_T}) {
+        auto status = gpuTsyrk<T>(handle, lower, trans, 
+                                  Am, Cm, 1.0, 0.0);
         if (status != gpu::BLAS_STATUS_SUCCESS) {
           std::cout << "Fuc" << std::endl;
         }
-        status = gpu::blasDgeam(params.handle, gpu::BLAS_OP_N, gpu::BLAS_OP_T, 
-            n,n, &alpha, A, n, &beta, C, n, A, n);
+        status = gpuTgeam<T>(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_T, 
+            Am, Cm, Am, 1.0, 0.0);
         if (status != gpu::BLAS_STATUS_SUCCESS) {
           std::cout << "Fuc" << std::endl;
         }
@@ -115,5 +207,29 @@ protected:
   }
 };
 
+template<typename T>
+class HERK_Executor : public Executor<HERK_Inputs<T>, HERK_Key, SYRK_Options> {
+protected:
+  void warmup(gpu::blasHandle_t handle) override {
+    size_t n = 64;
+    T *A, *C;
+    gpuAssert(gpu::Malloc(&A, n*n*sizeof(T)));
+    gpuAssert(gpu::Malloc(&C, n*n*sizeof(T)));
+    Matrix<T> Am(Workspace(A, n*n), n, n, n);
+    Matrix<T> Cm(Workspace(C, n*n), n, n, n);
+
+    for (auto lower : {false,true}) {
+      for (auto trans : {gpu::BLAS_OP_N, gpu::BLAS_OP_C}) {
+        gpuTherk<T>(handle, lower, trans, Am, Cm, 1.0, 0.0);
+        gpuTgeam<T>(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_C, 
+            Am, Cm, Am, 1.0, 0.0);
+      }
+    }
+    gpuAssert(gpu::DeviceSynchronize());
+    gpuAssert(gpu::Free(A));
+    gpuAssert(gpu::Free(C));
+  }
+};
+
 }
 
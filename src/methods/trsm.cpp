@@ -2,13 +2,17 @@
 #include "gpu-api.h"
 #include "matrixop.h"
 #include <sstream>
+#include <tuple>
 using namespace rtat;
 
+// Tile size for in place transposes
+static const size_t transpose_tile = 64;
+
 // TRSM_Key implementation
 TRSM_Key::operator std::string() const {
   std::stringstream ss;
   ss << side << "," << uplo << "," << trans << "," << diag
-     << "," << m << "," << n;
+     << "," << m << "," << n << "," << lda << ldb << "," << align;
 
   std::string ret;
   ss >> ret;
@@ -16,7 +20,19 @@ TRSM_Key::operator std::string() const {
 }
 
 bool TRSM_Key::operator<(const TRSM_Key& rhs) const {
-  return std::string(*this) < std::string(rhs);
+  return std::tie(side, uplo, trans, diag, m, n, lda, ldb, align)
+       < std::tie(rhs.side, rhs.uplo, rhs.trans, rhs.diag, rhs.m, rhs.n,
+                  rhs.lda, rhs.ldb, rhs.align);
+}
+
+TRSM_Key TRSM_Key::mirror() const {
+  auto t = chain(gpu::BLAS_OP_T, trans);
+  if (!t) return *this;
+  return TRSM_Key(!side, uplo, *t, diag, n, m, lda, ldb, align);
+}
+
+bool TRSM_Key::canonical() const {
+  return !(mirror() < *this);
 }
 
 std::ostream& operator<<(std::ostream& os, const TRSM_Key& dt) {
@@ -31,7 +47,14 @@ std::vector<TRSM_Options> TRSM_Options::enumerate() {
 
   for (auto swap : {Bool_Op(false), Bool_Op(true)})
     for (auto trans : {Bool_Op(false), Bool_Op(true)})
-      ret.push_back(TRSM_Options(swap,trans));
+      for (auto in_place : {Bool_Op(false), Bool_Op(true)})
+        for (auto tri : {Bool_Op(false), Bool_Op(true)}) {
+          // in_place only changes transposes of B, and triangular only 
+          // copies of A
+          if (in_place && !swap) continue;
+          if (tri && !trans) continue;
+          ret.push_back(TRSM_Options(swap,trans,in_place,tri));
+        }
   return ret;
 }
 
@@ -39,6 +62,8 @@ TRSM_Options::operator std::string() const {
   std::stringstream ss;
   ss << std::string(swap_side);
   ss << std::string(transpose_A);
+  ss << std::string(in_place);
+  ss << std::string(triangular);
 
   std::string ret;
   ss >> ret;
@@ -46,7 +71,19 @@ TRSM_Options::operator std::string() const {
 }
 
 bool TRSM_Options::operator<(const TRSM_Options& o) const {
-  return std::string(*this) < std::string(o);
+  return std::tie(swap_side.op, transpose_A.op, in_place.op, triangular.op)
+       < std::tie(o.swap_side.op, o.transpose_A.op, o.in_place.op, 
+                  o.triangular.op);
+}
+
+bool TRSM_Options::applies(const TRSM_Key &key) const {
+  return !in_place.op || key.m == key.n;
+}
+
+// Swapping sides solves the mirror's problem directly, and vice versa
+TRSM_Options TRSM_Options::mirror() const {
+  Bool_Op swap = swap_side;
+  return TRSM_Options(!swap, transpose_A, in_place, triangular);
 }
 
 std::ostream& operator<<(std::ostream& os, const TRSM_Options opts) {
@@ -57,13 +94,15 @@ std::ostream& operator<<(std::ostream& os, const TRSM_Options opts) {
 std::istream& operator>>(std::istream &is, TRSM_Options &opts) {
   std::string s;
   is >> s;
-  if (s.size() != 2) {
+  if (s.size() != 4) {
     is.setstate(std::ios::failbit);
     return is;
   }
     
   opts.swap_side = Bool_Op(s[0]);
   opts.transpose_A = Bool_Op(s[1]);
+  opts.in_place = Bool_Op(s[2]);
+  opts.triangular = Bool_Op(s[3]);
 
   return is;
 }
@@ -74,40 +113,72 @@ std::unique_ptr<MatrixOp<T>> TRSM_Options::form_operation(TRSM_Inputs<T> params)
   std::unique_ptr<MatrixOp<T>> A = std::make_unique<NoOp<T>>(params.A);
   std::unique_ptr<MatrixOp<T>> B = std::make_unique<NoOp<T>>(params.B);
 
+  // A is only read, and may be read concurrently by other calls, so it 
+  // is always transposed into a copy
   if (transpose_A) {
-    params.trans = !params.trans;
+    auto kind = transpose_kind<T>(params.trans);
+    params.trans = compose(params.trans, kind);
     params.uplo = !params.uplo;
-    A = std::make_unique<MatrixMove<T>>(
-        std::move(A), 1.0, true, 1);
+    if (triangular) {
+      A = std::make_unique<MatrixMoveTriangle<T>>(
+          std::move(A), 1.0, kind, 
+          params.uplo == gpu::BLAS_FILL_MODE_LOWER);
+    } else {
+      A = std::make_unique<MatrixMove<T>>(
+          std::move(A), 1.0, kind, 1);
+    }
   }
 
+  std::unique_ptr<MatrixOp<T>> result;
   if (swap_side) {
-    // Transpose B
-    params.trans = !params.trans;
+    // Transpose B. op(A)X = aB becomes X^t op(A)^t = a^t B^t, where t 
+    // is a conjugate transpose if op(A) conjugates.
+    auto kind = transpose_kind<T>(params.trans);
+    params.trans = compose(params.trans, kind);
     params.side = !params.side;
-    std::unique_ptr<MatrixOp<T>> scratch = 
-      std::make_unique<MatrixMove<T>>(std::move(B), 1.0, true, 1);
-    scratch = std::make_unique<MatrixTrsAlloc<T>>(
-        std::move(A), std::move(scratch), 
-        params.side == gpu::BLAS_SIDE_LEFT,
-        params.uplo == gpu::BLAS_FILL_MODE_LOWER,
-        params.trans == gpu::BLAS_OP_T,
-        params.diag == gpu::BLAS_DIAG_UNIT,
-        params.alpha);
-
-    B = std::make_unique<NoOp<T>>(params.B);
-
-    return std::make_unique<MatrixAccumulate<T>>(
-        std::move(scratch), std::move(B), 1.0, 0.0, true);
+    T alpha = (kind == gpu::BLAS_OP_C) ? conjugate(params.alpha) : params.alpha;
+
+    // Only a square B can be transposed in place, see applies. Otherwise
+    // it is transposed into scratch as without in_place.
+    if (in_place && params.m() == params.n()) {
+      B = std::make_unique<MatrixTransposeInPlace<T>>(
+          std::move(B), kind, transpose_tile);
+      B = std::make_unique<MatrixTrs<T>>(
+          std::move(A), std::move(B), 
+          params.side == gpu::BLAS_SIDE_LEFT,
+          params.uplo == gpu::BLAS_FILL_MODE_LOWER,
+          params.trans,
+          params.diag == gpu::BLAS_DIAG_UNIT,
+          alpha);
+      result = std::make_unique<MatrixTransposeInPlace<T>>(
+          std::move(B), kind, transpose_tile);
+    } else {
+      std::unique_ptr<MatrixOp<T>> scratch = 
+        std::make_unique<MatrixMove<T>>(std::move(B), 1.0, kind, 1);
+      scratch = std::make_unique<MatrixTrsAlloc<T>>(
+          std::move(A), std::move(scratch), 
+          params.side == gpu::BLAS_SIDE_LEFT,
+          params.uplo == gpu::BLAS_FILL_MODE_LOWER,
+          params.trans,
+          params.diag == gpu::BLAS_DIAG_UNIT,
+          alpha);
+
+      B = std::make_unique<NoOp<T>>(params.B);
+
+      result = std::make_unique<MatrixAccumulate<T>>(
+          std::move(scratch), std::move(B), 1.0, 0.0, kind);
+    }
   } else {
-    return std::make_unique<MatrixTrs<T>>(
+    result = std::make_unique<MatrixTrs<T>>(
         std::move(A), std::move(B), 
         params.side == gpu::BLAS_SIDE_LEFT,
         params.uplo == gpu::BLAS_FILL_MODE_LOWER,
-        params.trans == gpu::BLAS_OP_T,
+        params.trans,
         params.diag == gpu::BLAS_DIAG_UNIT,
         params.alpha);
   }
+
+  return result;
 }
 
 template std::unique_ptr<MatrixOp<double>> 
@@ -116,3 +187,9 @@ template std::unique_ptr<MatrixOp<double>>
 template std::unique_ptr<MatrixOp<float>> 
   TRSM_Options::form_operation(TRSM_Inputs<float>);
 
+template std::unique_ptr<MatrixOp<std::complex<double>>> 
+  TRSM_Options::form_operation(TRSM_Inputs<std::complex<double>>);
+
+template std::unique_ptr<MatrixOp<std::complex<float>>> 
+  TRSM_Options::form_operation(TRSM_Inputs<std::complex<float>>);
+
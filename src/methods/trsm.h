@@ -4,6 +4,7 @@
 #include <matrixop.h>
 #include <executor.h>
 #include "base_options.h"
+#include "key_classes.h"
 
 namespace rtat {
 
@@ -29,26 +30,52 @@ struct TRSM_Inputs {
 
   size_t m() {return B.dims().m;}
   size_t n() {return B.dims().n;}
+
+  bool operator==(const TRSM_Inputs &o) const {
+    return handle == o.handle && side == o.side && uplo == o.uplo 
+        && trans == o.trans && diag == o.diag 
+        && A == o.A && B == o.B && alpha == o.alpha;
+  }
 };
 
 
+// Layout classes as for GEMM_Key. The solve overwrites B, so it has no
+// beta class.
 struct TRSM_Key {
   BLAS_Side side;
   BLAS_Fill_Mode uplo;
   BLAS_Operation trans; 
   BLAS_Diag diag;
   int m; int n;
+  Stride_Class lda; Stride_Class ldb;
+  Align_Class align;
 
   TRSM_Key(BLAS_Side side, BLAS_Fill_Mode uplo, 
            BLAS_Operation trans, BLAS_Diag diag,
-           int m, int n) : side(side), uplo(uplo),
-                           trans(trans), diag(diag),
-                           m(m), n(n) {}
+           int m, int n,
+           Stride_Class lda = STRIDE_ALIGNED,
+           Stride_Class ldb = STRIDE_ALIGNED,
+           Align_Class align = ALIGN_LINE) 
+    : side(side), uplo(uplo), trans(trans), diag(diag), m(m), n(n),
+      lda(lda), ldb(ldb), align(align) {}
 
   template<typename T>
   TRSM_Key(TRSM_Inputs<T> i) : 
-    TRSM_Key(i.side, i.uplo, i.trans, i.diag, i.m(), i.n()) {}
-
+    TRSM_Key(i.side, i.uplo, i.trans, i.diag, i.m(), i.n(),
+             stride_class(i.A), stride_class(i.B), 
+             align_class(i.A, i.B)) {}
+
+  // The same solve transposed, on the other side of A with op(A) 
+  // transposed, see GEMM_Key::mirror.
+  TRSM_Key mirror() const;
+  bool canonical() const;
+
+  // See GEMM_Key::map_dims
+  template<typename F>
+  TRSM_Key map_dims(F f) const { 
+    int fm = f(m), fn = f(n);
+    return TRSM_Key(side, uplo, trans, diag, fm, fn, lda, ldb, align); 
+  }
 
   operator std::string() const;
   bool operator<(const TRSM_Key&) const;
@@ -56,13 +83,21 @@ struct TRSM_Key {
 };
 
 
+// in_place transposes a square B in place with O(tile) scratch instead 
+// of copying it, transposing back afterwards. A is only read, so is 
+// always copied. triangular copies only the referenced triangle of a 
+// transposed A.
 struct TRSM_Options {
   Bool_Op swap_side;
   Bool_Op transpose_A;
+  Bool_Op in_place;
+  Bool_Op triangular;
 
   TRSM_Options() = default;
-  TRSM_Options(Bool_Op swap_side, Bool_Op transpose_A) :
-    swap_side(swap_side), transpose_A(transpose_A) {}
+  TRSM_Options(Bool_Op swap_side, Bool_Op transpose_A, 
+               Bool_Op in_place = false, Bool_Op triangular = false) :
+    swap_side(swap_side), transpose_A(transpose_A), in_place(in_place),
+    triangular(triangular) {}
 
   static TRSM_Options default_opts() {
     return TRSM_Options();
@@ -70,8 +105,27 @@ struct TRSM_Options {
 
   static std::vector<TRSM_Options> enumerate();
 
+  // The equivalent plan for the mirrored key
+  TRSM_Options mirror() const;
+
+  // Whether the plan differs from the others for key, i.e. B can be 
+  // transposed in place
+  bool applies(const TRSM_Key &key) const;
+
   operator std::string() const;
 
+  // See GEMM_Options::factors
+  std::vector<std::string> factors() const {
+    return {swap_side, transpose_A, in_place, triangular};
+  }
+
+  // See GEMM_Options::index
+  static constexpr size_t count = 16;
+  size_t index() const {
+    return swap_side.op*8 + transpose_A.op*4 + in_place.op*2 + triangular.op;
+  }
+  bool valid() const { return true; }
+
   bool operator<(const TRSM_Options&) const;
 
   friend std::ostream& operator<<(std::ostream&, const TRSM_Options);
@@ -85,25 +139,24 @@ struct TRSM_Options {
 template<typename T>
 class TRSM_Executor : public Executor<TRSM_Inputs<T>, TRSM_Key, TRSM_Options> {
 protected:
-  void warmup(TRSM_Inputs<T> params, [[maybe_unused]] TRSM_Options opts,
-              [[maybe_unused]] Stream s) override {
+  void warmup(gpu::blasHandle_t handle) override {
     size_t n = 128;
-    double *A, *B;
-    gpuAssert(gpu::Malloc(&A, n*n*sizeof(double)));
-    gpuAssert(gpu::Malloc(&B, n*n*sizeof(double)));
+    T *A, *B;
+    gpuAssert(gpu::Malloc(&A, n*n*sizeof(T)));
+    gpuAssert(gpu::Malloc(&B, n*n*sizeof(T)));
+    Matrix<T> Am(Workspace(A, n*n), n, n, n);
+    Matrix<T> Bm(Workspace(B, n*n), n, n, n);
+
+    std::vector<gpu::blasOperation_t> ops = {gpu::BLAS_OP_N, gpu::BLAS_OP_T};
+    if constexpr(is_complex_v<T>) ops.push_back(gpu::BLAS_OP_C);
 
     for (auto side_left : {false,true}) {
       for (auto lower : {false,true}) {
-        for (auto trans : {false,true}) {
-          double alpha = 1.0;
-          double beta = 0.0;
-          gpu::blasDtrsm(params.handle, 
-              side_left ? gpu::BLAS_SIDE_LEFT : gpu::BLAS_SIDE_RIGHT,
-              lower ? gpu::BLAS_FILL_MODE_LOWER : gpu::BLAS_FILL_MODE_UPPER,
-              trans ? gpu::BLAS_OP_T : gpu::BLAS_OP_N,
-              gpu::BLAS_DIAG_NON_UNIT,
-              n,n,&alpha,A,n,B,n);
-          gpu::blasDgeam(params.handle, gpu::BLAS_OP_N, gpu::BLAS_OP_T, n,n, &alpha, A, n, &beta, B, n, A, n);
+        for (auto trans : ops) {
+          gpuTtrsm<T>(handle, side_left, lower, trans, false,
+                      Am, Bm, 1.0);
+          gpuTgeam<T>(handle, gpu::BLAS_OP_N, trans, 
+                      Am, Bm, Am, 1.0, 0.0);
         }
       }
     }
@@ -0,0 +1,316 @@
+#pragma once
+#include <gemm.h>
+#include <syrk.h>
+#include <trsm.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <typeinfo>
+#include <vector>
+
+namespace rtat {
+
+// Memory a matrix spans, from its first element to its last
+struct Region {
+  const char *begin = nullptr;
+  const char *end = nullptr;
+
+  template<typename T>
+  Region(const Matrix<T> &A) {
+    auto dims = A.dims();
+    if (dims.m == 0 || dims.n == 0) return;
+    begin = (const char*)A.ptr();
+    end = begin + (dims.ld*(dims.n-1) + dims.m)*sizeof(T);
+  }
+
+  bool overlaps(const Region &other) const {
+    return begin < other.end && other.begin < end;
+  }
+};
+
+template<typename T>
+std::vector<Region> reads_of(const GEMM_Inputs<T> &p) { return {p.A, p.B, p.C}; }
+template<typename T>
+std::vector<Region> writes_of(const GEMM_Inputs<T> &p) { return {p.C}; }
+
+template<typename T>
+std::vector<Region> reads_of(const TRSM_Inputs<T> &p) { return {p.A, p.B}; }
+template<typename T>
+std::vector<Region> writes_of(const TRSM_Inputs<T> &p) { return {p.B}; }
+
+template<typename T>
+std::vector<Region> reads_of(const SYRK_Inputs<T> &p) { return {p.A, p.C}; }
+template<typename T>
+std::vector<Region> writes_of(const SYRK_Inputs<T> &p) { return {p.C}; }
+
+template<typename T>
+std::vector<Region> reads_of(const HERK_Inputs<T> &p) { return {p.A, p.C}; }
+template<typename T>
+std::vector<Region> writes_of(const HERK_Inputs<T> &p) { return {p.C}; }
+
+// A recorded call, with the memory it reads and writes and the stream and
+// device it was made on
+class Deferred_Call {
+  static int current_device() {
+    int device;
+    gpuAssert(gpu::GetDevice(&device));
+    return device;
+  }
+public:
+  std::vector<Region> reads, writes;
+  gpu::Stream_t stream;
+  int device;
+
+  Deferred_Call(std::vector<Region> reads, std::vector<Region> writes,
+                gpu::Stream_t stream)
+    : reads(reads), writes(writes), stream(stream), 
+      device(current_device()) {}
+  virtual ~Deferred_Call() = default;
+
+  // Issues the call on handle, in place of the one it was made with
+  virtual void run(gpu::blasHandle_t handle) = 0;
+
+  // Calls with the same batch key can be issued together by run_batch on
+  // any one of them, given device arrays of each operand's pointers
+  virtual std::optional<std::string> batch_key() const { return {}; }
+  virtual std::vector<const void*> batch_operands() const { return {}; }
+  virtual void run_batch(gpu::blasHandle_t, const void *const *, size_t) {}
+
+  // Writes of either call touch memory the other uses
+  bool depends_on(const Deferred_Call &earlier) const {
+    for (auto &w : earlier.writes) {
+      for (auto &r : reads) if (w.overlaps(r)) return true;
+      for (auto &o : writes) if (w.overlaps(o)) return true;
+    }
+    for (auto &r : earlier.reads)
+      for (auto &w : writes) if (r.overlaps(w)) return true;
+    return false;
+  }
+};
+
+template<typename Params>
+class Deferred_Params : public Deferred_Call {
+protected:
+  Params params;
+  std::function<void(Params)> issue;
+
+  static gpu::Stream_t stream_of(gpu::blasHandle_t handle) {
+    gpu::Stream_t stream = nullptr;
+    gpu::blasGetStream(handle, &stream);
+    return stream;
+  }
+public:
+  Deferred_Params(Params params, std::function<void(Params)> issue)
+    : Deferred_Call(reads_of(params), writes_of(params),
+                    stream_of(params.handle)),
+      params(params), issue(issue) {}
+
+  void run(gpu::blasHandle_t handle) override {
+    Params on_handle = params;
+    on_handle.handle = handle;
+    issue(on_handle);
+  }
+};
+
+// GEMMs of one type, shape, layout and scalars batch into one launch
+template<typename T>
+class Deferred_GEMM : public Deferred_Params<GEMM_Inputs<T>> {
+public:
+  using Deferred_Params<GEMM_Inputs<T>>::Deferred_Params;
+
+  std::optional<std::string> batch_key() const override {
+    auto p = this->params;
+    std::ostringstream key;
+    key << std::hexfloat << typeid(T).name() << " "
+        << p.transa << p.transb << " " << p.m() << " " << p.n() << " "
+        << p.k() << " " << p.A.dims().ld << " " << p.B.dims().ld << " "
+        << p.C.dims().ld << " " << p.alpha << " " << p.beta;
+    return key.str();
+  }
+
+  std::vector<const void*> batch_operands() const override {
+    auto &p = this->params;
+    return {p.A.ptr(), p.B.ptr(), p.C.ptr()};
+  }
+
+  void run_batch(gpu::blasHandle_t handle, const void *const *operands,
+                 size_t count) override {
+    auto p = this->params;
+    gpuTgemmBatched<T>(handle, p.transa, p.transb, p.m(), p.n(), p.k(),
+        p.alpha, (const T *const *)operands, p.A.dims().ld,
+        (const T *const *)(operands + count), p.B.dims().ld, p.beta,
+        (T *const *)(operands + 2*count), p.C.dims().ld, count);
+  }
+};
+
+// Calls recorded to be issued together on flush. Each call runs after
+// every earlier call whose memory it conflicts with, as if issued
+// eagerly. Independent GEMMs of the same shape are merged into batched
+// launches and other independent calls are spread over the queue's
+// streams. Flushed work starts after earlier work on the streams the
+// calls were made on, and later work on those streams waits for it. 
+// Calls run on the device they were made on, so recording a call on 
+// another device than the queued calls flushes them first.
+class Call_Queue {
+  // Streams and batched pointer arrays of one device, created on the 
+  // device's first flush
+  struct Device_Queue {
+    std::vector<Stream> streams;
+    std::vector<BLAS_Handle> handles;
+    ManagedWorkspace pointers;
+    Event uploaded;
+
+    Device_Queue(size_t stream_count) : pointers(0) {
+      for (size_t i = 0; i < stream_count; i++) {
+        streams.emplace_back();
+        handles.emplace_back(streams.back());
+      }
+    }
+  };
+  size_t stream_count;
+  std::map<int, Device_Queue> device_queues;
+  std::vector<std::unique_ptr<Deferred_Call>> calls;
+
+  // Operand pointer arrays for batched launches, staged for any device
+  Pinned_Buffer<const void*> staging;
+
+  size_t batched_calls = 0;
+  size_t launches = 0;
+
+  // Independent calls issued as one launch, their pointers at offset
+  struct Unit {
+    std::vector<Deferred_Call*> calls;
+    size_t offset = 0;
+  };
+public:
+  Call_Queue(size_t stream_count = 4) : stream_count(stream_count) {}
+
+  ~Call_Queue() { flush(); }
+
+  Call_Queue(const Call_Queue&) = delete;
+  Call_Queue& operator=(const Call_Queue&) = delete;
+
+  void record(std::unique_ptr<Deferred_Call> call) {
+    if (!calls.empty() && calls.back()->device != call->device) flush();
+    calls.push_back(std::move(call));
+  }
+
+  size_t size() const { return calls.size(); }
+
+  // Calls issued inside batched launches, and launches made, so far
+  size_t batched() const { return batched_calls; }
+  size_t launched() const { return launches; }
+
+  void flush() {
+    if (calls.empty()) return;
+
+    int home;
+    gpuAssert(gpu::GetDevice(&home));
+    int device = calls.front()->device;
+    gpuAssert(gpu::SetDevice(device));
+    auto search = device_queues.find(device);
+    if (search == device_queues.end())
+      search = device_queues.try_emplace(device, stream_count).first;
+    auto &[streams, handles, pointers, uploaded] = search->second;
+
+    // A call goes in the level after the last call it depends on, so
+    // calls in a level are independent
+    std::vector<size_t> level(calls.size(), 0);
+    size_t levels = 0;
+    for (size_t i = 0; i < calls.size(); i++) {
+      for (size_t j = 0; j < i; j++)
+        if (calls[i]->depends_on(*calls[j]))
+          level[i] = std::max(level[i], level[j]+1);
+      levels = std::max(levels, level[i]+1);
+    }
+
+    std::vector<std::vector<Unit>> units(levels);
+    size_t pointer_count = 0;
+    for (size_t l = 0; l < levels; l++) {
+      std::map<std::string, std::vector<Deferred_Call*>> batches;
+      for (size_t i = 0; i < calls.size(); i++) {
+        if (level[i] != l) continue;
+        if (auto key = calls[i]->batch_key())
+          batches[*key].push_back(calls[i].get());
+        else
+          units[l].push_back({{calls[i].get()}});
+      }
+      for (auto &[key, batch] : batches) {
+        units[l].push_back({batch, pointer_count});
+        if (batch.size() > 1) pointer_count += 3*batch.size();
+      }
+    }
+
+    // The last flush's upload must finish before staging is rewritten
+    for (auto &[d, queue] : device_queues) queue.uploaded.synchronize();
+    staging.grow_to_fit(pointer_count);
+    pointers.grow_to_fit<const void*>(pointer_count);
+    for (auto &level_units : units) {
+      for (auto &unit : level_units) {
+        size_t count = unit.calls.size();
+        if (count == 1) continue;
+        for (size_t c = 0; c < count; c++) {
+          auto operands = unit.calls[c]->batch_operands();
+          for (size_t o = 0; o < 3; o++)
+            staging[unit.offset + o*count + c] = operands[o];
+        }
+      }
+    }
+
+    // The first stream joins the callers' streams, and has joined every
+    // queue stream at the end of the last flush
+    std::set<gpu::Stream_t> callers;
+    for (auto &call : calls) callers.insert(call->stream);
+    for (auto caller : callers) {
+      Event called;
+      called.record(Stream(caller));
+      streams[0].wait_event(called);
+    }
+    if (pointer_count)
+      gpuAssert(gpu::MemcpyAsync((const void**)pointers, staging.data(),
+                                 pointer_count*sizeof(const void*),
+                                 gpu::MemcpyHostToDevice, streams[0]));
+    uploaded.record(streams[0]);
+
+    std::vector<Event> barrier = {uploaded};
+    for (auto &level_units : units) {
+      std::vector<bool> used(streams.size(), false);
+      for (size_t u = 0; u < level_units.size(); u++) {
+        size_t s = u % streams.size();
+        if (!used[s]) {
+          for (auto &e : barrier) streams[s].wait_event(e);
+          used[s] = true;
+        }
+
+        auto &unit = level_units[u];
+        if (unit.calls.size() == 1) {
+          unit.calls[0]->run(handles[s]);
+        } else {
+          unit.calls[0]->run_batch(handles[s],
+              (const void**)pointers + unit.offset, unit.calls.size());
+          batched_calls += unit.calls.size();
+        }
+        launches++;
+      }
+
+      barrier.clear();
+      for (size_t s = 0; s < streams.size(); s++) {
+        if (!used[s]) continue;
+        barrier.emplace_back();
+        barrier.back().record(streams[s]);
+      }
+    }
+
+    for (auto &e : barrier) streams[0].wait_event(e);
+    Event done;
+    done.record(streams[0]);
+    for (auto caller : callers) Stream(caller).wait_event(done);
+
+    calls.clear();
+    gpuAssert(gpu::SetDevice(home));
+  }
+};
+
+}
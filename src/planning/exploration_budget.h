@@ -0,0 +1,67 @@
+#pragma once
+#include <chrono>
+#include <map>
+#include <optional>
+
+namespace rtat {
+
+// Decides when keys are worth exploring. A key's past calls are taken as
+// a forecast of its future ones, so exploring pays off once the time its
+// calls have taken, times the fraction a better plan is expected to save,
+// exceeds the cost of trying its untried options. Each trial is assumed
+// to cost trial_cost calls on the plan in use. Exploration is also capped
+// at max_fraction of the wall time since the first call. Until a key is
+// explored, the planner runs it on the default plan.
+template<typename Key>
+class Exploration_Budget {
+  using Clock = std::chrono::steady_clock;
+
+  double max_fraction;
+  double expected_gain;
+  double trial_cost;
+
+  std::map<Key, size_t> calls;
+  std::optional<Clock::time_point> start;
+  double spent = 0.0;
+  size_t trials = 0;
+public:
+  Exploration_Budget(double max_fraction = 0.05, double expected_gain = 0.25,
+                     double trial_cost = 2.0)
+    : max_fraction(max_fraction), expected_gain(expected_gain),
+      trial_cost(trial_cost) {}
+
+  // Counts a call of a key that has not converged
+  void called(const Key &key) {
+    if (!start) start = Clock::now();
+    calls[key]++;
+  }
+
+  // Whether to try one of untried options on key, whose calls take mean
+  // milliseconds. If so its projected cost is charged to the budget.
+  bool explore(const Key &key, size_t untried, float mean) {
+    double cumulative = calls[key]*mean;
+    double cost = trial_cost*mean;
+    if (cumulative*expected_gain < untried*cost) return false;
+    if (spent + cost > max_fraction*elapsed()) return false;
+    spent += cost;
+    trials++;
+    return true;
+  }
+
+  // Wall time since the first call, and projected time spent exploring,
+  // in milliseconds
+  double elapsed() const {
+    if (!start) return 0.0;
+    return std::chrono::duration<double, std::milli>(
+        Clock::now() - *start).count();
+  }
+  double explored() const { return spent; }
+
+  size_t call_count(const Key &key) const {
+    auto search = calls.find(key);
+    return search == calls.end() ? 0 : search->second;
+  }
+  size_t trial_count() const { return trials; }
+};
+
+}
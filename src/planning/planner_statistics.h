@@ -11,10 +11,14 @@ class Planner_Statistics {
   std::map<Key, std::map<Opts, std::vector<float>>> floprates; 
   std::map<Key, std::map<Opts, float>> means; 
   std::map<Key, std::map<Opts, size_t>> counts; 
+  std::map<Key, float> saved;
 public:
+  // saved holds, per key, the exploration time skipped by dropping 
+  // clearly slower options early
   Planner_Statistics(
-      std::map<Key, std::map<Opts, std::vector<float>>> times) 
-    : times(times) {
+      std::map<Key, std::map<Opts, std::vector<float>>> times,
+      std::map<Key, float> saved = {}) 
+    : times(times), saved(saved) {
 
     for (auto &[key, opt_map] : times) {
       for (auto &[opt, times] : opt_map) {
@@ -29,6 +33,13 @@ public:
   const std::map<Key, std::map<Opts, std::vector<float>>>& get_times() {return times;}
   const std::map<Key, std::map<Opts, float>>& get_means() {return means;} 
   const std::map<Key, std::map<Opts, size_t>>& get_counts() {return counts;} 
+  const std::map<Key, float>& get_saved() {return saved;}
+
+  float total_saved() {
+    float total = 0.0;
+    for (auto &[key, t] : saved) total += t;
+    return total;
+  }
 
   // FLOP rates are constructed separately for SFINAE reasons
   // Don't want to force Opts to have a flopcount necessarily
@@ -52,6 +63,8 @@ public:
     for (auto &[key, opt_map] : times) {
       nlohmann::json key_json;
       key_json["key"] = to_json(key);
+      if (auto search = saved.find(key); search != saved.end())
+        key_json["saved"] = search->second;
 
       key_json["options"] = nlohmann::json();
       for (auto &[opt, ts] : opt_map) {
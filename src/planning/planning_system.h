@@ -1,15 +1,46 @@
 #pragma once
 
+#include <cmath>
 #include <map>
+#include <set>
 #include <gpu-api.h>
 #include <numeric>
 
 #include <gemm.h>
 #include <predicates.h>
 #include "planner_statistics.h"
+#include "exploration_budget.h"
 
 namespace rtat {
 
+// Options with a factors(), listing one level per independent choice, can
+// be searched by screening, see Planning_System::set_screening
+template<typename T, typename = void>
+struct has_factors : std::false_type {};
+
+template<typename T>
+struct has_factors<T, std::void_t<decltype(
+    std::declval<const T&>().factors())>> : std::true_type {};
+
+// Options with an applies(key) are only offered for the keys where they 
+// differ from the other options, e.g. TRSM_Options::applies
+template<typename Opts, typename Key, typename = void>
+struct has_applies : std::false_type {};
+
+template<typename Opts, typename Key>
+struct has_applies<Opts, Key, std::void_t<decltype(
+    std::declval<const Opts&>().applies(std::declval<const Key&>()))>> 
+    : std::true_type {};
+
+template<typename Opts, typename Key>
+bool applies(const Opts &opts, const Key &key) {
+  if constexpr(has_applies<Opts, Key>::value) {
+    return opts.applies(key);
+  } else {
+    return true;
+  }
+}
+
 
 template<typename Key, typename Opts>
 class Option_Filter {
@@ -26,7 +57,7 @@ public:
     std::vector<Opts> ret;
 
     for (auto &opts : Opts::enumerate()) {
-      if (filter(std::make_pair(opts, key)))
+      if (applies(opts, key) && filter(std::make_pair(opts, key)))
         ret.push_back(opts);
     }
 
@@ -53,29 +84,308 @@ protected:
 
   size_t tests_until_converge = 1;
   std::map<Key, Opts> converged_plans;
+  bool share_mirrors = false;
+
+  // Racing, see set_racing. Options dropped from each key's exploration, 
+  // and the time their skipped samples would have taken.
+  size_t race_samples = 0;
+  float race_z = 2.0;
+  float race_spread = 0.25;
+  std::map<Key, std::set<Opts>> abandoned;
+  std::map<Key, float> saved;
+
+  size_t samples_to_converge() const {
+    return std::max(tests_until_converge, race_samples);
+  }
+
+  // Screening, see set_screening
+  bool screening = false;
+  float screen_threshold = 0.05;
 
   Device_Timer::Mode sync_mode = Device_Timer::ASYNCHRONOUS;
-public:
-  Planning_System() = default;
-  Planning_System(Option_Filter<Key, Opts> opt_filter) 
-      : opt_filter(opt_filter) {}
+  bool graph_replay = false;
 
-  virtual ~Planning_System() = default;
+  bool converged(Key key, Opts opts) {
+    auto chosen = converged_plan(key);
+    return chosen && !(*chosen < opts) && !(opts < *chosen);
+  }
 
-  virtual Opts create_plan(Key key) {
-    if (converged_plans.count(key))
-      return converged_plans[key];
+  std::shared_ptr<Dimension_Buckets> buckets() const {
+    return executor.get_buckets();
+  }
+  float refine_ratio = 2.0;
+  size_t refine_interval = 64;
+  std::map<Key, size_t> lookups;
+
+  // Splits the buckets of a converged key whose members differ in time
+  // per unit of work on its plan by more than refine_ratio, in each
+  // dimension that varies between them. The key's plan and timings are
+  // dropped, so the finer buckets are planned afresh.
+  bool refine(Key key, Opts opts) {
+    if constexpr(has_map_dims<Key>::value) {
+      float fastest = std::numeric_limits<float>::max();
+      float slowest = 0.0;
+      std::vector<std::vector<int>> member_dims;
+      for (auto &[member, banks] : executor.get_member_timings(key)) {
+        auto search = banks.find(opts);
+        if (search == banks.end()) continue;
+        search->second.synchronize();
+        const std::vector<float>& ts = search->second.get_times();
+        if (ts.empty()) continue;
+
+        double work = 1.0;
+        std::vector<int> dims;
+        member.map_dims([&](int d) { work *= d; dims.push_back(d); return d; });
+        float rate = std::accumulate(ts.cbegin(), ts.cend(), 0.0)
+                   / ts.size() / std::max(work, 1.0);
+        fastest = std::min(fastest, rate);
+        slowest = std::max(slowest, rate);
+        member_dims.push_back(dims);
+      }
+      if (member_dims.size() < 2 || slowest < refine_ratio*fastest)
+        return false;
+
+      std::vector<int> varying;
+      for (size_t i = 0; i < member_dims[0].size(); i++) {
+        for (auto &dims : member_dims) {
+          if (dims[i] == member_dims[0][i]) continue;
+          for (auto &all : member_dims) varying.push_back(all[i]);
+          break;
+        }
+      }
+      buckets()->refine(varying);
+
+      converged_plans.erase(key);
+      executor.forget(key);
+      lookups.erase(key);
+      abandoned.erase(key);
+      return true;
+    } else {
+      return false;
+    }
+  }
+
+  std::shared_ptr<Exploration_Budget<Key>> budget;
+
+  // Whether the budget allows trying another option on key, judged by
+  // the mean of its timings completed so far
+  bool explore(const Key &key, Option_Map<Opts, Timer_Bank> &timings,
+               size_t untried) {
+    budget->called(key);
+    double total = 0.0;
+    size_t count = 0;
+    for (auto &[opts, bank] : timings) {
+      auto &ts = bank.get_times();
+      total = std::accumulate(ts.cbegin(), ts.cend(), total);
+      count += ts.size();
+    }
+    if (count == 0) return false;
+    return budget->explore(key, untried, total/count);
+  }
+
+  // Drops options whose timings so far are clearly slower than the best, 
+  // i.e. whose lower confidence bound exceeds its upper one, and returns 
+  // the rest. Bounds are race_z standard errors either side of the mean, 
+  // and at least race_spread of the mean, since a few samples say little 
+  // about the spread.
+  std::vector<Opts> race(const Key &key, 
+                         Option_Map<Opts, Timer_Bank> &timings,
+                         const std::vector<Opts> &opt_set) {
+    size_t cold = executor.get_operand_cache() ? 1 : 0;
+    auto &dropped = abandoned[key];
+    std::map<Opts, std::pair<float, float>> bounds;
+    float best_upper = std::numeric_limits<float>::max();
+    for (auto &opts : opt_set) {
+      auto search = timings.find(opts);
+      if (search == timings.end() || dropped.count(opts)) continue;
+      search->second.synchronize();
+      const std::vector<float>& ts = search->second.get_times();
+      if (ts.size() <= cold) continue;
+
+      auto first = ts.cbegin() + cold;
+      float n = ts.cend() - first;
+      float mean = std::accumulate(first, ts.cend(), 0.0)/n;
+      float var = 0.0;
+      for (auto t = first; t != ts.cend(); t++) 
+        var += (*t - mean)*(*t - mean);
+      float error = (n > 1) ? race_z*std::sqrt(var/(n-1)/n) : 0.0;
+      float half = std::max(error, race_spread*mean);
+      bounds[opts] = {mean - half, mean + half};
+      best_upper = std::min(best_upper, mean + half);
+    }
+
+    std::vector<Opts> survivors;
+    for (auto &opts : opt_set) {
+      if (!dropped.count(opts)) {
+        auto bound = bounds.find(opts);
+        if (bound == bounds.end() || bound->second.first <= best_upper) {
+          survivors.push_back(opts);
+          continue;
+        }
+        Timer_Bank &bank = timings[opts];
+        size_t skipped = samples_to_converge() - std::min(
+            bank.size(), samples_to_converge());
+        auto &ts = bank.get_times();
+        saved[key] += skipped*
+          std::accumulate(ts.cbegin(), ts.cend(), 0.0)/ts.size();
+        dropped.insert(opts);
+      }
+    }
+    return survivors;
+  }
+
+  // The options a factor screening search still needs timed or, once it 
+  // has finished, those it timed. The default option is timed first, 
+  // then each option differing from it in one factor. Factors whose 
+  // change moves the time by more than screen_threshold are promising, 
+  // and the best option so far is improved by coordinate descent over 
+  // them, until no option differing from it in one promising factor is 
+  // left untimed. If the filter excludes the default, factors are 
+  // screened from the best option timed so far instead, the first 
+  // admissible option being timed to start.
+  std::vector<Opts> screen(Option_Map<Opts, Timer_Bank> &timings,
+                           const std::vector<Opts> &opt_set) {
+    if constexpr(has_factors<Opts>::value) {
+      if (opt_set.empty()) return opt_set;
+
+      size_t cold = executor.get_operand_cache() ? 1 : 0;
+      std::vector<std::vector<std::string>> factors;
+      std::vector<std::optional<float>> means(opt_set.size());
+      std::optional<size_t> default_index;
+      for (size_t i = 0; i < opt_set.size(); i++) {
+        auto &opts = opt_set[i];
+        factors.push_back(opts.factors());
+        if (!(opts < Opts::default_opts()) && !(Opts::default_opts() < opts))
+          default_index = i;
+
+        auto search = timings.find(opts);
+        if (search == timings.end() 
+            || search->second.size() < samples_to_converge()) continue;
+        search->second.synchronize();
+        const std::vector<float>& ts = search->second.get_times();
+        auto first = ts.cbegin() + std::min(cold, ts.size() - 1);
+        means[i] = std::accumulate(first, ts.cend(), 0.0)/(ts.cend() - first);
+      }
 
-    std::map<Opts, Timer_Bank> &timings = executor.get_timings(key);
+      // Options differing from option i in factor f alone
+      auto along = [&](size_t i, size_t f, std::vector<size_t> &ret) {
+        for (size_t j = 0; j < opt_set.size(); j++) {
+          if (factors[j][f] == factors[i][f]) continue;
+          bool alone = true;
+          for (size_t g = 0; g < factors[i].size() && alone; g++)
+            alone = (g == f) || factors[j][g] == factors[i][g];
+          if (alone) ret.push_back(j);
+        }
+      };
+      auto untimed = [&](const std::vector<size_t> &candidates) {
+        std::vector<Opts> ret;
+        for (auto j : candidates) 
+          if (!means[j]) ret.push_back(opt_set[j]);
+        return ret;
+      };
+
+      size_t base = 0;
+      if (default_index) {
+        base = *default_index;
+      } else {
+        for (size_t i = 0; i < opt_set.size(); i++)
+          if (means[i] && (!means[base] || *means[i] < *means[base])) 
+            base = i;
+      }
+      if (!means[base]) return {opt_set[base]};
+
+      // One factor at a time from the default
+      size_t factor_count = factors[base].size();
+      std::vector<std::vector<size_t>> screened(factor_count);
+      std::vector<size_t> all_screened;
+      for (size_t f = 0; f < factor_count; f++) {
+        along(base, f, screened[f]);
+        all_screened.insert(all_screened.end(), 
+                            screened[f].begin(), screened[f].end());
+      }
+      if (auto wanted = untimed(all_screened); !wanted.empty()) 
+        return wanted;
+
+      std::vector<bool> promising(factor_count, false);
+      for (size_t f = 0; f < factor_count; f++)
+        for (auto j : screened[f])
+          if (std::abs(*means[j] - *means[base]) 
+              > screen_threshold * *means[base])
+            promising[f] = true;
+
+      // Coordinate descent from the best so far
+      size_t best = base;
+      for (size_t i = 0; i < opt_set.size(); i++)
+        if (means[i] && *means[i] < *means[best]) best = i;
+      std::vector<size_t> moves;
+      for (size_t f = 0; f < factor_count; f++)
+        if (promising[f]) along(best, f, moves);
+      if (auto wanted = untimed(moves); !wanted.empty()) 
+        return wanted;
+
+      std::vector<Opts> timed;
+      for (size_t i = 0; i < opt_set.size(); i++)
+        if (means[i]) timed.push_back(opt_set[i]);
+      return timed;
+    } else {
+      return opt_set;
+    }
+  }
+
+  // Converges key on the mirror of the plan its mirror converged on, if 
+  // key has not converged yet
+  void adopt_mirror(Key key) {
+    if constexpr(has_mirror<Key>::value && has_mirror<Opts>::value) {
+      auto mirror = mirror_key<Key, Opts>(key);
+      if (!mirror || converged_plans.count(executor.canonical(key))) return;
+      auto search = converged_plans.find(executor.canonical(*mirror));
+      if (search != converged_plans.end())
+        converged_plans[executor.canonical(key)] = search->second.mirror();
+    }
+  }
+
+  // Plans a canonical key
+  Opts plan(Key key) {
+    if (auto search = converged_plans.find(key);
+        search != converged_plans.end()) {
+      Opts opts = search->second;
+      if (buckets() && ++lookups[key] % refine_interval == 0)
+        refine(key, opts);
+      return opts;
+    }
+
+    Option_Map<Opts, Timer_Bank> &timings = executor.get_timings()[key];
 
     // Find un-used times
     auto opt_set = opt_filter.apply(key);
+    if (race_samples) opt_set = race(key, timings, opt_set);
+    if (screening) opt_set = screen(timings, opt_set);
+    // When racing, the least sampled option is run next, so that every 
+    // option is timed early and losers are dropped early
+    std::optional<Opts> next;
+    size_t untried = 0;
+    size_t fewest = 0;
     for (auto &opts : opt_set) {
-      if (timings[opts].size() < tests_until_converge)
-        return opts;
+      auto search = timings.find(opts);
+      size_t tests = (search == timings.end()) ? 0 : search->second.size();
+      if (tests < samples_to_converge()) {
+        if (!next || (race_samples && tests < fewest)) {
+          next = opts;
+          fewest = tests;
+        }
+        untried++;
+      }
+    }
+    if (next) {
+      if (budget && !explore(key, timings, untried))
+        return Opts::default_opts();
+      return *next;
     }
 
-    // Choose best time 
+    // Choose best time. With operands cached, the first run of each 
+    // option pays for its transforms and later ones reuse them, so the 
+    // first is left out to rank options by their steady state cost.
+    size_t cold = executor.get_operand_cache() ? 1 : 0;
     Opts best_opts;
     float best_time = std::numeric_limits<float>::max();
     for (auto &opts : opt_set) {
@@ -83,8 +393,9 @@ public:
       time_bank.synchronize();
 
       const std::vector<float>& ts = time_bank.get_times();
+      auto first = ts.cbegin() + std::min(cold, ts.size() - 1);
       float mean = 
-        std::accumulate(ts.cbegin(), ts.cend(), 0.0)/ts.size();
+        std::accumulate(first, ts.cend(), 0.0)/(ts.cend() - first);
 
       if (mean < best_time) {
         best_opts = opts;
@@ -94,11 +405,89 @@ public:
     converged_plans[key] = best_opts;
     return converged_plans[key];
   }
+public:
+  // Keys in one dimension bucket are planned as one, see set_bucketing.
+  // When sharing mirrors, a key adopts the plan its mirror converged on,
+  // see set_share_mirrors.
+  virtual Opts create_plan(Key key) {
+    if (share_mirrors) adopt_mirror(key);
+    return plan(executor.canonical(key));
+  }
+
+  Planning_System() = default;
+  Planning_System(Option_Filter<Key, Opts> opt_filter)
+      : opt_filter(opt_filter) {}
+
+  virtual ~Planning_System() = default;
+
+  // The plan key has converged on, if it has
+  std::optional<Opts> converged_plan(Key key) const {
+    auto search = converged_plans.find(executor.canonical(key));
+    if (search == converged_plans.end()) return {};
+    return search->second;
+  }
+
+  // The key that timings and plans of key are kept under
+  Key canonical(Key key) const { return executor.canonical(key); }
+
+  // Plans keys by the buckets of their dimensions, so that nearly equal
+  // shapes share timings and a plan. Every refine_interval lookups of a
+  // converged bucket, it is split if its members perform differently,
+  // see refine. Set before planning, as existing timings and plans are
+  // not moved.
+  void set_bucketing(std::shared_ptr<Dimension_Buckets> new_buckets,
+                     float ratio = 2.0, size_t interval = 64) {
+    executor.set_buckets(new_buckets);
+    refine_ratio = ratio;
+    refine_interval = interval;
+  }
+
+  // Explores keys only once the budget deems it worthwhile, running them 
+  // on the default plan until then, see Exploration_Budget. Keys are 
+  // explored as soon as they are seen without a budget.
+  void set_exploration_budget(
+      std::shared_ptr<Exploration_Budget<Key>> new_budget) {
+    budget = new_budget;
+  }
+  std::shared_ptr<Exploration_Budget<Key>> get_exploration_budget() const {
+    return budget;
+  }
+
+  // Samples each option samples times before converging, racing them: 
+  // options clearly slower than the best so far are dropped, and the 
+  // rest sampled further, see race. The time dropped options would have 
+  // taken is reported in the statistics.
+  void set_racing(size_t samples, float z = 2.0, float spread = 0.25) {
+    race_samples = samples;
+    race_z = z;
+    race_spread = spread;
+  }
+
+  // Searches options made of independent factors by screening them 
+  // rather than timing every combination, see screen. Options without 
+  // factors are still searched exhaustively.
+  void set_screening(bool screen, float threshold = 0.05) {
+    screening = screen;
+    screen_threshold = threshold;
+  }
+
+  // Converges a key on the mirror of its mirror's converged plan, so one
+  // exploration serves both. A plan and its mirror do different work, 
+  // e.g. one transposes C and the other does not, so each key is timed 
+  // on its own and only the converged choice is shared. Off unless 
+  // enabled.
+  void set_share_mirrors(bool share) { share_mirrors = share; }
 
   void set_sync_mode(Device_Timer::Mode new_sync_mode) {
     sync_mode = new_sync_mode;
   }
 
+  // Replays converged plans from captured graphs, see Executor::replay.
+  // Off unless enabled.
+  void set_graph_replay(bool replay) {
+    graph_replay = replay;
+  }
+
   void execute(Params params, Opts opts, Workspace space, Stream s) {
     if (space.size<char>() < executor.calculate_workspace(params, opts)) {
       opts = degrade_plan(params, opts, space);
@@ -106,17 +495,57 @@ public:
 
     auto sync = sync_mode;
     // Prevent asynchronous execution before convergence
-    if (executor.get_timings(params)[opts].size() < tests_until_converge
+    if (executor.get_timings(params, opts).size() < samples_to_converge()
         && sync == Device_Timer::ASYNCHRONOUS)
       sync = Device_Timer::SEMI_SYNCHRONOUS;
 
-    executor.execute(params, opts, space, s, sync);
+    if (graph_replay && converged(params, opts))
+      executor.replay(params, opts, space, s, sync);
+    else
+      executor.execute(params, opts, space, s, sync);
   }
 
+  // Keeps transformed copies of operands tagged with a generation (see 
+  // Matrix::with_generation) between calls. Each option is then timed 
+  // twice before converging, so that it is ranked by its cost once its 
+  // transforms are cached.
+  void set_operand_cache(std::shared_ptr<Operand_Cache> cache) {
+    executor.set_operand_cache(cache);
+    tests_until_converge = cache ? 2 : 1;
+  }
+
+  // Warms up the executor on the current device, see Executor::prepare
+  void prepare() { executor.prepare(); }
+  bool is_warm() { return executor.is_warm(); }
+
   size_t calculate_workspace(Params params, Opts opts) {
     return executor.calculate_workspace(params, opts);
   }
 
+  size_t elided_passes() const {
+    return executor.get_elided_passes();
+  }
+
+  // Converged plans, so that a later run can start from them
+  nlohmann::json save_plans() const {
+    nlohmann::json json = nlohmann::json::array();
+    for (auto &[key, opts] : converged_plans) {
+      nlohmann::json plan_json;
+      plan_json["key"] = to_json(key);
+      plan_json["option"] = to_json(opts);
+      json.push_back(plan_json);
+    }
+    return json;
+  }
+
+  void load_plans(const nlohmann::json &json) {
+    for (auto &plan_json : json) {
+      auto key = from_json<Key>(plan_json["key"]);
+      converged_plans[executor.canonical(key)] = 
+        from_json<Opts>(plan_json["option"]);
+    }
+  }
+
   Planner_Statistics<Key,Opts> make_statistics() {
     std::map<Key, std::map<Opts, std::vector<float>>> times;
     auto &timings = executor.get_timings();
@@ -126,11 +555,50 @@ public:
         times[key][opt] = timer_bank.get_times();
       }
     }
-    return Planner_Statistics(times);
+    return Planner_Statistics(times, saved);
+  }
+};
+
+
+// Planner for reduced precision GEMM. Options whose measured relative 
+// error exceeds the tolerance are dropped once their accuracy is known, 
+// so the fastest plan within the accuracy budget is chosen, and the call
+// that measured it runs at full precision. Full precision plans are 
+// always admissible.
+template<typename T>
+class Mixed_Precision_Planner : public Planning_System<GEMM_Executor_Mixed<T>> {
+  using Base = Planning_System<GEMM_Executor_Mixed<T>>;
+  T tolerance;
+public:
+  Mixed_Precision_Planner(T tolerance = 1e-3) 
+    : Base(Option_Filter<GEMM_Key, GEMM_Options_Mixed>(
+          [this](std::pair<GEMM_Options_Mixed, GEMM_Key> p) {
+            auto err = this->executor.error(p.second, p.first.precision);
+            return !err || *err <= this->tolerance;
+          })),
+      tolerance(tolerance) {
+    this->executor.set_tolerance(tolerance);
+  }
+
+  T get_tolerance() { return tolerance; }
+
+  std::map<GEMM_Key, std::map<Precision_Op, T>>& get_errors() {
+    return this->executor.get_errors();
   }
 };
 
+// Planner for GEMM spread over a team of devices, by default every 
+// device starting from the current one
+template<typename T>
+class Distributed_GEMM_Planner : public Planning_System<GEMM_Executor_Distributed<T>> {
+public:
+  Distributed_GEMM_Planner() = default;
+  Distributed_GEMM_Planner(std::shared_ptr<Device_Team> team) {
+    this->executor.set_team(team);
+  }
 
+  Device_Team& get_team() { return this->executor.get_team(); }
+};
 
 template class Planning_System<GEMM_Executor<double>>;
 using GEMM_Planner = Planning_System<GEMM_Executor<double>>;
@@ -138,5 +606,19 @@ using GEMM_Planner = Planning_System<GEMM_Executor<double>>;
 template class Planning_System<GEMM_Executor<float>>;
 using SGEMM_Planner = Planning_System<GEMM_Executor<float>>;
 
-}
+template class Planning_System<GEMM_Executor<std::complex<double>>>;
+using ZGEMM_Planner = Planning_System<GEMM_Executor<std::complex<double>>>;
 
+template class Planning_System<GEMM_Executor<std::complex<float>>>;
+using CGEMM_Planner = Planning_System<GEMM_Executor<std::complex<float>>>;
+
+template class Distributed_GEMM_Planner<double>;
+using Distributed_DGEMM_Planner = Distributed_GEMM_Planner<double>;
+
+template class Planning_System<GEMM_Executor_Out_Of_Core<double>>;
+using Out_Of_Core_DGEMM_Planner = Planning_System<GEMM_Executor_Out_Of_Core<double>>;
+
+template class Mixed_Precision_Planner<float>;
+using SGEMM_Mixed_Planner = Mixed_Precision_Planner<float>;
+
+}
@@ -1,8 +1,19 @@
+#pragma once
 #include <gemm.h>
 #include <syrk.h>
 #include <trsm.h>
 #include <planning_system.h>
+#include <lazy_matrix.h>
+#include <call_queue.h>
+#include <chrono>
+#include <complex>
+#include <functional>
+#include <future>
+#include <map>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 
 namespace rtat {
@@ -15,47 +26,369 @@ public:
     if (!val) val = std::make_unique<T>();
     return *val;
   }
+
+  bool constructed() const { return val != nullptr; }
+  const T* operator->() const { return val.get(); }
 };
 
 class rtat {
-  Lazy<Planning_System<GEMM_Executor<double>>> dgemm_planner;
-  Lazy<Planning_System<GEMM_Executor<float>>> sgemm_planner;
-  Lazy<Planning_System<TRSM_Executor<double>>> dtrsm_planner;
-  Lazy<Planning_System<TRSM_Executor<float>>> strsm_planner;
-  Lazy<Planning_System<SYRK_Executor<double>>> dsyrk_planner;
-  Lazy<Planning_System<SYRK_Executor<float>>> ssyrk_planner;
+  // One lazily constructed planner per supported scalar type
+  template<template<typename> typename Executor>
+  class Planner_Set {
+    Lazy<Planning_System<Executor<double>>> d;
+    Lazy<Planning_System<Executor<float>>> s;
+    Lazy<Planning_System<Executor<std::complex<double>>>> z;
+    Lazy<Planning_System<Executor<std::complex<float>>>> c;
+  public:
+    template<typename T>
+    Planning_System<Executor<T>>& get() {
+      if constexpr(std::is_same_v<T,double>) {
+        return d;
+      } else if constexpr(std::is_same_v<T,float>) {
+        return s;
+      } else if constexpr(std::is_same_v<T,std::complex<double>>) {
+        return z;
+      } else if constexpr(std::is_same_v<T,std::complex<float>>) {
+        return c;
+      } else {
+        static_assert(!sizeof(T), "Planners are only double, float and complex");
+      }
+    }
+
+    // Plans are stored per scalar type, using the BLAS prefix letters. 
+    // Planners that were never used are not saved, or constructed.
+    nlohmann::json save_plans() const {
+      nlohmann::json json = nlohmann::json::object();
+      if (d.constructed()) json["d"] = d->save_plans();
+      if (s.constructed()) json["s"] = s->save_plans();
+      if (z.constructed()) json["z"] = z->save_plans();
+      if (c.constructed()) json["c"] = c->save_plans();
+      return json;
+    }
+
+    void load_plans(const nlohmann::json &json) {
+      if (json.contains("d")) get<double>().load_plans(json["d"]);
+      if (json.contains("s")) get<float>().load_plans(json["s"]);
+      if (json.contains("z")) get<std::complex<double>>().load_plans(json["z"]);
+      if (json.contains("c")) get<std::complex<float>>().load_plans(json["c"]);
+    }
+  };
+
+  struct Planners {
+    Planner_Set<GEMM_Executor> gemm;
+    Planner_Set<TRSM_Executor> trsm;
+    Planner_Set<SYRK_Executor> syrk;
+    Planner_Set<HERK_Executor> herk;
+    Planner_Set<GEMM_Executor_Distributed> distributed_gemm;
+    Planner_Set<GEMM_Executor_Out_Of_Core> out_of_core_gemm;
+  };
+
+  // Planners are kept per device, so each device converges on its own
+  // plans. With share_plans, devices of the same model share one set of
+  // planners and are tuned once between them.
+  std::shared_ptr<Device_Layer> devices;
+  bool share_plans;
+  std::map<std::string, Planners> planner_sets;
+  std::map<int, Planners*> device_planners;
+
+  Planners& planners() {
+    int device = devices->current();
+    auto search = device_planners.find(device);
+    if (search == device_planners.end()) {
+      auto key = share_plans ? devices->model(device) : std::to_string(device);
+      search = device_planners.emplace(device, &planner_sets[key]).first;
+    }
+    return *search->second;
+  }
+
+  // Workspace leased to one-call dispatches, one per device and stream so
+  // that concurrent streams never share it. Arenas only grow, so once every 
+  // problem on a stream has been seen no more memory is allocated.
+  struct Arena {
+    Stream s;
+    ManagedWorkspace space;
+    Arena(gpu::Stream_t stream) : s(stream), space(0) {}
+  };
+  std::map<std::pair<int, gpu::Stream_t>, Arena> arenas;
+
+  Arena& arena(gpu::blasHandle_t handle) {
+    gpu::Stream_t stream;
+    gpu::blasGetStream(handle, &stream);
+    auto key = std::make_pair(devices->current(), stream);
+    auto search = arenas.find(key);
+    if (search == arenas.end())
+      search = arenas.try_emplace(key, stream).first;
+    return search->second;
+  }
+
+  // Warmups started by initialize, waited for on destruction as they 
+  // refer to the planners
+  std::vector<std::shared_future<double>> warming;
+
+  template<typename T>
+  std::function<void()> warmup_task(const std::string &routine) {
+    auto warm = [](auto &planner) { 
+      return std::function<void()>([&planner]() { planner.prepare(); }); 
+    };
+    if (routine == "gemm") return warm(gemm_planner<T>());
+    if (routine == "trsm") return warm(trsm_planner<T>());
+    if (routine == "syrk") return warm(syrk_planner<T>());
+    if (routine == "distributed_gemm") return warm(distributed_gemm_planner<T>());
+    if (routine == "out_of_core_gemm") return warm(out_of_core_gemm_planner<T>());
+    if constexpr(is_complex_v<T>) {
+      if (routine == "herk") return warm(herk_planner<T>());
+    }
+    throw std::runtime_error("initialize: Unknown routine " + routine);
+  }
+
+  std::function<void()> warmup_task(const std::string &routine) {
+    std::string rest = routine.substr(1);
+    switch (routine.empty() ? ' ' : routine[0]) {
+      case 'd': return warmup_task<double>(rest);
+      case 's': return warmup_task<float>(rest);
+      case 'z': return warmup_task<std::complex<double>>(rest);
+      case 'c': return warmup_task<std::complex<float>>(rest);
+    }
+    throw std::runtime_error("initialize: Unknown routine " + routine);
+  }
+
+  template<typename Planner, typename Params>
+  void dispatch(Planner &planner, Params params) {
+    Arena &leased = arena(params.handle);
+    auto plan = planner.create_plan(params);
+    leased.space.grow_to_fit<char>(planner.calculate_workspace(params, plan));
+    planner.execute(params, plan, leased.space, leased.s);
+  }
+
+  // Calls recorded in deferred mode. Destroyed first, as flushing on 
+  // destruction uses the planners and arenas.
+  std::unique_ptr<Call_Queue> queue;
+
+  template<typename Call, typename Planner, typename Params>
+  void submit(Planner &planner, Params params) {
+    if (!queue) return dispatch(planner, params);
+    queue->record(std::make_unique<Call>(params, 
+        [this, &planner](Params p) { dispatch(planner, p); }));
+  }
 public:
+  rtat(std::shared_ptr<Device_Layer> devices = std::make_shared<Device_Layer>(),
+       bool share_plans = false)
+    : devices(devices), share_plans(share_plans) {}
+
+  ~rtat() {
+    for (auto &ready : warming) ready.wait();
+  }
+
+  static std::vector<std::string> default_routines() {
+    return {"dgemm", "sgemm", "zgemm", "cgemm", 
+            "dtrsm", "strsm", "ztrsm", "ctrsm",
+            "dsyrk", "ssyrk", "zsyrk", "csyrk", 
+            "zherk", "cherk"};
+  }
+
+  // Warms up the planners for the given routines on the current device, 
+  // each on a background thread, so that the first calls do not pay for 
+  // library initialization. Routines are named BLAS style, a scalar 
+  // prefix then gemm, trsm, syrk, herk, distributed_gemm or 
+  // out_of_core_gemm. The planners are constructed before returning. 
+  // Each future holds the seconds its routine took to warm up; calls 
+  // made before it is ready wait for it.
+  std::map<std::string, std::shared_future<double>> 
+  initialize(const std::vector<std::string> &routines = default_routines()) {
+    int device;
+    gpuAssert(gpu::GetDevice(&device));
+
+    std::map<std::string, std::shared_future<double>> ready;
+    for (auto &routine : routines) {
+      auto task = warmup_task(routine);
+      ready[routine] = std::async(std::launch::async, [device, task]() {
+        auto start = std::chrono::steady_clock::now();
+        gpuAssert(gpu::SetDevice(device));
+        task();
+        std::chrono::duration<double> elapsed = 
+          std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+      }).share();
+      warming.push_back(ready[routine]);
+    }
+    return ready;
+  }
+
+  // One-call entry points. Each plans the problem, leases workspace on 
+  // the stream of the BLAS handle, executes and records the timing.
+  template<typename T>
+  void gemm(GEMM_Inputs<T> params) { 
+    submit<Deferred_GEMM<T>>(gemm_planner<T>(), params); 
+  }
+
+  // GEMM spread over every device, starting from the current one
+  template<typename T>
+  void distributed_gemm(GEMM_Inputs<T> params) { 
+    flush();
+    dispatch(distributed_gemm_planner<T>(), params); 
+  }
+
+  // GEMM on host resident A, B and C, streamed through the device
+  template<typename T>
+  void out_of_core_gemm(GEMM_Inputs<T> params) { 
+    flush();
+    dispatch(out_of_core_gemm_planner<T>(), params); 
+  }
+
   template<typename T>
-  Planning_System<GEMM_Executor<T>>& gemm_planner();
-  template<>
-  Planning_System<GEMM_Executor<double>>& gemm_planner() {
-    return dgemm_planner;
+  void trsm(TRSM_Inputs<T> params) { 
+    submit<Deferred_Params<TRSM_Inputs<T>>>(trsm_planner<T>(), params); 
   }
-  template<>
-  Planning_System<GEMM_Executor<float>>& gemm_planner() {
-    return sgemm_planner;
+
+  template<typename T>
+  void syrk(SYRK_Inputs<T> params) { 
+    submit<Deferred_Params<SYRK_Inputs<T>>>(syrk_planner<T>(), params); 
+  }
+
+  template<typename T>
+  void herk(HERK_Inputs<T> params) { 
+    submit<Deferred_Params<HERK_Inputs<T>>>(herk_planner<T>(), params); 
+  }
+
+  // In deferred mode gemm, trsm, syrk and herk are recorded rather than 
+  // issued, until flush, so that independent calls can be batched and 
+  // spread over the queue's streams (see Call_Queue). The other calls 
+  // flush first and run eagerly. Turning deferred mode off flushes.
+  void set_deferred(bool deferred, size_t streams = 4) {
+    if (deferred && !queue) queue = std::make_unique<Call_Queue>(streams);
+    if (!deferred) queue.reset();
+  }
+
+  void flush() { if (queue) queue->flush(); }
+
+  const Call_Queue* call_queue() const { return queue.get(); }
+
+  // GEMM on layout-lazy matrices. Operands held transposed are read 
+  // through the transpose. C stays transposed when it already is, or when
+  // beta is zero and the converged plan computes C transposed, in place 
+  // of that plan's transpose back. With beta zero, transposed contents 
+  // of C that cannot be accumulated into are dropped rather than 
+  // transposed back.
+  template<typename T>
+  void gemm(gpu::blasHandle_t handle, 
+            BLAS_Operation transa, BLAS_Operation transb,
+            Lazy_Matrix<T> &A, Lazy_Matrix<T> &B, Lazy_Matrix<T> &C, 
+            T alpha, T beta) {
+    flush();
+    auto ta = A.through(transa);
+    if (!ta) { A.materialize(handle); ta = transa; }
+    auto tb = B.through(transb);
+    if (!tb) { B.materialize(handle); tb = transb; }
+
+    // C^T = alpha op(B)^T op(A)^T + beta C^T
+    auto tat = chain(gpu::BLAS_OP_T, *ta);
+    auto tbt = chain(gpu::BLAS_OP_T, *tb);
+    auto into_transpose = [&](Matrix<T> Ct) {
+      dispatch(gemm_planner<T>(), GEMM_Inputs<T>(handle, *tbt, *tat, 
+               B.physical(), A.physical(), Ct, alpha, beta));
+    };
+
+    if (C.transposed()) {
+      if (tat && tbt) return into_transpose(C.physical());
+      if (beta == T(0.0)) C.discard();
+      else C.materialize(handle);
+    }
+
+    GEMM_Inputs<T> params(handle, *ta, *tb, A.physical(), B.physical(), 
+                          C.matrix(), alpha, beta);
+    auto plan = gemm_planner<T>().converged_plan(params);
+    if (plan && plan->transc == BLAS_Op::TRANS && beta == T(0.0) 
+        && tat && tbt)
+      return into_transpose(C.hold_transposed());
+    dispatch(gemm_planner<T>(), params);
+  }
+
+  // TRSM with a layout-lazy A, read through the transpose when held 
+  // transposed. B is solved in place, so is materialized first.
+  template<typename T>
+  void trsm(gpu::blasHandle_t handle, BLAS_Side side, BLAS_Fill_Mode uplo,
+            BLAS_Operation trans, BLAS_Diag diag, 
+            Lazy_Matrix<T> &A, Lazy_Matrix<T> &B, T alpha) {
+    flush();
+    auto ta = A.through(trans);
+    if (!ta) { A.materialize(handle); ta = trans; }
+
+    // The lower triangle of A is the upper triangle of its transpose
+    BLAS_Fill_Mode fill = uplo;
+    if (A.transposed())
+      fill = (uplo == gpu::BLAS_FILL_MODE_LOWER) ? 
+        gpu::BLAS_FILL_MODE_UPPER : gpu::BLAS_FILL_MODE_LOWER;
+
+    dispatch(trsm_planner<T>(), TRSM_Inputs<T>(handle, side, fill, *ta, diag,
+             A.physical(), B.read(handle), alpha));
+  }
+
+  // A handle bound to s on the current device, for building inputs. 
+  // Handles come from the process wide pool and are reused on each call.
+  gpu::blasHandle_t handle(gpu::Stream_t s) {
+    return Handle_Pool::shared().get(s);
+  }
+
+  // Total workspace currently held by the arenas, on all devices
+  size_t arena_bytes() {
+    size_t bytes = 0;
+    for (auto &[key, leased] : arenas) bytes += leased.space.size<char>();
+    return bytes;
   }
 
   template<typename T>
-  Planning_System<TRSM_Executor<T>>& trsm_planner();
-  template<>
-  Planning_System<TRSM_Executor<double>>& trsm_planner() {
-    return dtrsm_planner;
+  Planning_System<GEMM_Executor<T>>& gemm_planner() {
+    return planners().gemm.get<T>();
   }
-  template<>
-  Planning_System<TRSM_Executor<float>>& trsm_planner() {
-    return strsm_planner;
+
+  template<typename T>
+  Planning_System<GEMM_Executor_Distributed<T>>& distributed_gemm_planner() {
+    return planners().distributed_gemm.get<T>();
+  }
+
+  template<typename T>
+  Planning_System<GEMM_Executor_Out_Of_Core<T>>& out_of_core_gemm_planner() {
+    return planners().out_of_core_gemm.get<T>();
   }
 
   template<typename T>
-  Planning_System<SYRK_Executor<T>>& syrk_planner();
-  template<>
-  Planning_System<SYRK_Executor<double>>& syrk_planner() {
-    return dsyrk_planner;
+  Planning_System<TRSM_Executor<T>>& trsm_planner() {
+    return planners().trsm.get<T>();
   }
-  template<>
-  Planning_System<SYRK_Executor<float>>& syrk_planner() {
-    return ssyrk_planner;
+
+  template<typename T>
+  Planning_System<SYRK_Executor<T>>& syrk_planner() {
+    return planners().syrk.get<T>();
+  }
+
+  template<typename T>
+  Planning_System<HERK_Executor<T>>& herk_planner() {
+    return planners().herk.get<T>();
+  }
+
+  // Plans of the current device
+  nlohmann::json save_plans() {
+    Planners &current = planners();
+    nlohmann::json json;
+    json["gemm"] = current.gemm.save_plans();
+    json["trsm"] = current.trsm.save_plans();
+    json["syrk"] = current.syrk.save_plans();
+    json["herk"] = current.herk.save_plans();
+    json["distributed_gemm"] = current.distributed_gemm.save_plans();
+    json["out_of_core_gemm"] = current.out_of_core_gemm.save_plans();
+    return json;
+  }
+
+  void load_plans(const nlohmann::json &json) {
+    Planners &current = planners();
+    if (json.contains("gemm")) current.gemm.load_plans(json["gemm"]);
+    if (json.contains("trsm")) current.trsm.load_plans(json["trsm"]);
+    if (json.contains("syrk")) current.syrk.load_plans(json["syrk"]);
+    if (json.contains("herk")) current.herk.load_plans(json["herk"]);
+    if (json.contains("distributed_gemm")) 
+      current.distributed_gemm.load_plans(json["distributed_gemm"]);
+    if (json.contains("out_of_core_gemm")) 
+      current.out_of_core_gemm.load_plans(json["out_of_core_gemm"]);
   }
 };
 
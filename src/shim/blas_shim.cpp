@@ -0,0 +1,356 @@
+#include "blas_shim.h"
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+
+namespace rtat {
+
+std::ostream& operator<<(std::ostream& os, const Shim_Overhead& o) {
+  os << "rtatblas shim: " << o.calls << " calls, planning overhead mean "
+     << o.mean_us() << "us max " << o.max_us << "us, "
+     << o.over_budget << " calls over the " << o.budget_us << "us budget";
+  return os;
+}
+
+namespace {
+double env_double(const char *name, double fallback) {
+  const char *val = std::getenv(name);
+  return val ? std::atof(val) : fallback;
+}
+}
+
+BLAS_Shim::BLAS_Shim()
+    : handle(s), operand_space(0), work_space(0),
+      overhead(env_double("RTAT_SHIM_BUDGET_US", 10.0)),
+      report(std::getenv("RTAT_SHIM_REPORT") != nullptr) {
+  if (const char *file = std::getenv("RTAT_PLAN_FILE")) {
+    plan_file = file;
+    std::ifstream is(plan_file);
+    if (is.good()) {
+      try {
+        planners.load_plans(nlohmann::json::parse(is));
+      } catch (const std::exception &e) {
+        std::cerr << "rtatblas shim: ignoring unreadable plan file "
+                  << plan_file << ": " << e.what() << std::endl;
+      }
+    }
+  }
+}
+
+BLAS_Shim::~BLAS_Shim() {
+  if (!plan_file.empty()) {
+    std::ofstream os(plan_file);
+    os << std::setw(2) << planners.save_plans() << std::endl;
+  }
+  if (report) std::cerr << overhead << std::endl;
+}
+
+BLAS_Shim& BLAS_Shim::instance() {
+  static BLAS_Shim shim;
+  return shim;
+}
+
+Shim_Overhead BLAS_Shim::get_overhead() {
+  std::lock_guard<std::mutex> guard(lock);
+  return overhead;
+}
+
+nlohmann::json BLAS_Shim::save_plans() {
+  std::lock_guard<std::mutex> guard(lock);
+  return planners.save_plans();
+}
+
+// Copies a column major host matrix into the next part of the arena.
+// Only the ld*(n-1)+m elements BLAS may touch are read.
+template<typename T>
+Matrix<T> BLAS_Shim::upload(Workspace &arena, const T *A,
+                            int m, int n, int ld) {
+  Matrix<T> dA(arena.peel<T>((size_t)ld*n), m, n, ld);
+  if (m > 0 && n > 0) {
+    gpuAssert(gpu::Memcpy(dA.ptr(), A, ((size_t)ld*(n-1)+m)*sizeof(T),
+                          gpu::MemcpyHostToDevice));
+  }
+  return dA;
+}
+
+template<typename T>
+void BLAS_Shim::download(T *A, Matrix<T> dA) {
+  auto dims = dA.dims();
+  s.synchronize();
+  if (dims.m > 0 && dims.n > 0) {
+    gpuAssert(gpu::Memcpy(A, dA.ptr(),
+                          (dims.ld*(dims.n-1)+dims.m)*sizeof(T),
+                          gpu::MemcpyDeviceToHost));
+  }
+}
+
+template<typename Planner, typename Params>
+void BLAS_Shim::run(Planner &planner, Params params) {
+  auto start = Clock::now();
+  auto plan = planner.create_plan(params);
+  work_space.grow_to_fit<char>(planner.calculate_workspace(params, plan));
+  overhead.record(
+      std::chrono::duration<double, std::micro>(Clock::now()-start).count());
+
+  planner.execute(params, plan, work_space, s);
+}
+
+template<typename T>
+void BLAS_Shim::gemm(BLAS_Operation transa, BLAS_Operation transb,
+                     int m, int n, int k, T alpha, const T *A, int lda,
+                     const T *B, int ldb, T beta, T *C, int ldc) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (m == 0 || n == 0) return;
+
+  bool ta = transa != gpu::BLAS_OP_N;
+  bool tb = transb != gpu::BLAS_OP_N;
+  operand_space.grow_to_fit<T>(
+      (size_t)lda*(ta ? m : k) + (size_t)ldb*(tb ? k : n) + (size_t)ldc*n);
+  Workspace arena = operand_space;
+  auto dA = upload(arena, A, ta ? k : m, ta ? m : k, lda);
+  auto dB = upload(arena, B, tb ? n : k, tb ? k : n, ldb);
+  auto dC = upload(arena, (const T*)C, m, n, ldc);
+
+  run(planners.gemm_planner<T>(),
+      GEMM_Inputs<T>(handle, transa, transb, dA, dB, dC, alpha, beta));
+  download(C, dC);
+}
+
+template<typename T>
+void BLAS_Shim::trsm(BLAS_Side side, BLAS_Fill_Mode uplo,
+                     BLAS_Operation trans, BLAS_Diag diag, int m, int n,
+                     T alpha, const T *A, int lda, T *B, int ldb) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (m == 0 || n == 0) return;
+
+  int a = (side == gpu::BLAS_SIDE_LEFT) ? m : n;
+  operand_space.grow_to_fit<T>((size_t)lda*a + (size_t)ldb*n);
+  Workspace arena = operand_space;
+  auto dA = upload(arena, A, a, a, lda);
+  auto dB = upload(arena, (const T*)B, m, n, ldb);
+
+  run(planners.trsm_planner<T>(),
+      TRSM_Inputs<T>(handle, side, uplo, trans, diag, dA, dB, alpha));
+  download(B, dB);
+}
+
+template<typename T>
+void BLAS_Shim::syrk(BLAS_Fill_Mode uplo, BLAS_Operation trans,
+                     int n, int k, T alpha, const T *A, int lda,
+                     T beta, T *C, int ldc) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (n == 0) return;
+
+  bool t = trans != gpu::BLAS_OP_N;
+  operand_space.grow_to_fit<T>((size_t)lda*(t ? n : k) + (size_t)ldc*n);
+  Workspace arena = operand_space;
+  auto dA = upload(arena, A, t ? k : n, t ? n : k, lda);
+  auto dC = upload(arena, (const T*)C, n, n, ldc);
+
+  run(planners.syrk_planner<T>(),
+      SYRK_Inputs<T>(handle, uplo, trans, dA, dC, alpha, beta));
+  download(C, dC);
+}
+
+template<typename T>
+void BLAS_Shim::herk(BLAS_Fill_Mode uplo, BLAS_Operation trans,
+                     int n, int k, Real_T<T> alpha, const T *A, int lda,
+                     Real_T<T> beta, T *C, int ldc) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (n == 0) return;
+
+  bool t = trans != gpu::BLAS_OP_N;
+  operand_space.grow_to_fit<T>((size_t)lda*(t ? n : k) + (size_t)ldc*n);
+  Workspace arena = operand_space;
+  auto dA = upload(arena, A, t ? k : n, t ? n : k, lda);
+  auto dC = upload(arena, (const T*)C, n, n, ldc);
+
+  run(planners.herk_planner<T>(),
+      HERK_Inputs<T>(handle, uplo, trans, dA, dC, alpha, beta));
+  download(C, dC);
+}
+
+}
+
+
+// CBLAS entry points. Row major calls are turned into the equivalent
+// column major call on the transposed matrices.
+namespace {
+using namespace rtat;
+using Complex_D = std::complex<double>;
+using Complex_F = std::complex<float>;
+
+BLAS_Operation op(CBLAS_TRANSPOSE trans) {
+  switch (trans) {
+    case CblasNoTrans: return gpu::BLAS_OP_N;
+    case CblasTrans: return gpu::BLAS_OP_T;
+    case CblasConjTrans: return gpu::BLAS_OP_C;
+  }
+  __builtin_unreachable();
+}
+
+BLAS_Fill_Mode fill(CBLAS_UPLO uplo, bool flip) {
+  bool lower = (uplo == CblasLower) != flip;
+  return lower ? gpu::BLAS_FILL_MODE_LOWER : gpu::BLAS_FILL_MODE_UPPER;
+}
+
+BLAS_Side side_mode(CBLAS_SIDE side, bool flip) {
+  bool left = (side == CblasLeft) != flip;
+  return left ? gpu::BLAS_SIDE_LEFT : gpu::BLAS_SIDE_RIGHT;
+}
+
+BLAS_Diag diag_type(CBLAS_DIAG diag) {
+  return diag == CblasUnit ? gpu::BLAS_DIAG_UNIT : gpu::BLAS_DIAG_NON_UNIT;
+}
+
+// Row major rank-k updates swap N with T (SYRK) or C (HERK)
+BLAS_Operation flip_op(CBLAS_TRANSPOSE trans, gpu::blasOperation_t other) {
+  return trans == CblasNoTrans ? BLAS_Operation(other)
+                               : BLAS_Operation(gpu::BLAS_OP_N);
+}
+
+template<typename T>
+void gemm(CBLAS_ORDER order, CBLAS_TRANSPOSE transa, CBLAS_TRANSPOSE transb,
+          int m, int n, int k, T alpha, const T *A, int lda,
+          const T *B, int ldb, T beta, T *C, int ldc) {
+  if (order == CblasColMajor) {
+    BLAS_Shim::instance().gemm<T>(op(transa), op(transb), m, n, k,
+                                  alpha, A, lda, B, ldb, beta, C, ldc);
+  } else {
+    BLAS_Shim::instance().gemm<T>(op(transb), op(transa), n, m, k,
+                                  alpha, B, ldb, A, lda, beta, C, ldc);
+  }
+}
+
+template<typename T>
+void trsm(CBLAS_ORDER order, CBLAS_SIDE side, CBLAS_UPLO uplo,
+          CBLAS_TRANSPOSE trans, CBLAS_DIAG diag, int m, int n,
+          T alpha, const T *A, int lda, T *B, int ldb) {
+  bool row = order == CblasRowMajor;
+  BLAS_Shim::instance().trsm<T>(side_mode(side, row), fill(uplo, row),
+                                op(trans), diag_type(diag),
+                                row ? n : m, row ? m : n,
+                                alpha, A, lda, B, ldb);
+}
+
+template<typename T>
+void syrk(CBLAS_ORDER order, CBLAS_UPLO uplo, CBLAS_TRANSPOSE trans,
+          int n, int k, T alpha, const T *A, int lda, T beta, T *C, int ldc) {
+  bool row = order == CblasRowMajor;
+  BLAS_Operation t = row ? flip_op(trans, gpu::BLAS_OP_T) : op(trans);
+  BLAS_Shim::instance().syrk<T>(fill(uplo, row), t, n, k,
+                                alpha, A, lda, beta, C, ldc);
+}
+
+template<typename T>
+void herk(CBLAS_ORDER order, CBLAS_UPLO uplo, CBLAS_TRANSPOSE trans,
+          int n, int k, Real_T<T> alpha, const T *A, int lda,
+          Real_T<T> beta, T *C, int ldc) {
+  bool row = order == CblasRowMajor;
+  BLAS_Operation t = row ? flip_op(trans, gpu::BLAS_OP_C) : op(trans);
+  BLAS_Shim::instance().herk<T>(fill(uplo, row), t, n, k,
+                                alpha, A, lda, beta, C, ldc);
+}
+}
+
+extern "C" {
+
+void cblas_dgemm(CBLAS_ORDER order, CBLAS_TRANSPOSE transa, CBLAS_TRANSPOSE transb,
+                 int m, int n, int k, double alpha, const double *A, int lda,
+                 const double *B, int ldb, double beta, double *C, int ldc) {
+  gemm<double>(order, transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void cblas_sgemm(CBLAS_ORDER order, CBLAS_TRANSPOSE transa, CBLAS_TRANSPOSE transb,
+                 int m, int n, int k, float alpha, const float *A, int lda,
+                 const float *B, int ldb, float beta, float *C, int ldc) {
+  gemm<float>(order, transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void cblas_zgemm(CBLAS_ORDER order, CBLAS_TRANSPOSE transa, CBLAS_TRANSPOSE transb,
+                 int m, int n, int k, const void *alpha, const void *A, int lda,
+                 const void *B, int ldb, const void *beta, void *C, int ldc) {
+  gemm<Complex_D>(order, transa, transb, m, n, k, *(const Complex_D*)alpha,
+                  (const Complex_D*)A, lda, (const Complex_D*)B, ldb,
+                  *(const Complex_D*)beta, (Complex_D*)C, ldc);
+}
+
+void cblas_cgemm(CBLAS_ORDER order, CBLAS_TRANSPOSE transa, CBLAS_TRANSPOSE transb,
+                 int m, int n, int k, const void *alpha, const void *A, int lda,
+                 const void *B, int ldb, const void *beta, void *C, int ldc) {
+  gemm<Complex_F>(order, transa, transb, m, n, k, *(const Complex_F*)alpha,
+                  (const Complex_F*)A, lda, (const Complex_F*)B, ldb,
+                  *(const Complex_F*)beta, (Complex_F*)C, ldc);
+}
+
+void cblas_dtrsm(CBLAS_ORDER order, CBLAS_SIDE side, CBLAS_UPLO uplo,
+                 CBLAS_TRANSPOSE trans, CBLAS_DIAG diag, int m, int n,
+                 double alpha, const double *A, int lda, double *B, int ldb) {
+  trsm<double>(order, side, uplo, trans, diag, m, n, alpha, A, lda, B, ldb);
+}
+
+void cblas_strsm(CBLAS_ORDER order, CBLAS_SIDE side, CBLAS_UPLO uplo,
+                 CBLAS_TRANSPOSE trans, CBLAS_DIAG diag, int m, int n,
+                 float alpha, const float *A, int lda, float *B, int ldb) {
+  trsm<float>(order, side, uplo, trans, diag, m, n, alpha, A, lda, B, ldb);
+}
+
+void cblas_ztrsm(CBLAS_ORDER order, CBLAS_SIDE side, CBLAS_UPLO uplo,
+                 CBLAS_TRANSPOSE trans, CBLAS_DIAG diag, int m, int n,
+                 const void *alpha, const void *A, int lda, void *B, int ldb) {
+  trsm<Complex_D>(order, side, uplo, trans, diag, m, n,
+                  *(const Complex_D*)alpha, (const Complex_D*)A, lda,
+                  (Complex_D*)B, ldb);
+}
+
+void cblas_ctrsm(CBLAS_ORDER order, CBLAS_SIDE side, CBLAS_UPLO uplo,
+                 CBLAS_TRANSPOSE trans, CBLAS_DIAG diag, int m, int n,
+                 const void *alpha, const void *A, int lda, void *B, int ldb) {
+  trsm<Complex_F>(order, side, uplo, trans, diag, m, n,
+                  *(const Complex_F*)alpha, (const Complex_F*)A, lda,
+                  (Complex_F*)B, ldb);
+}
+
+void cblas_dsyrk(CBLAS_ORDER order, CBLAS_UPLO uplo, CBLAS_TRANSPOSE trans,
+                 int n, int k, double alpha, const double *A, int lda,
+                 double beta, double *C, int ldc) {
+  syrk<double>(order, uplo, trans, n, k, alpha, A, lda, beta, C, ldc);
+}
+
+void cblas_ssyrk(CBLAS_ORDER order, CBLAS_UPLO uplo, CBLAS_TRANSPOSE trans,
+                 int n, int k, float alpha, const float *A, int lda,
+                 float beta, float *C, int ldc) {
+  syrk<float>(order, uplo, trans, n, k, alpha, A, lda, beta, C, ldc);
+}
+
+void cblas_zsyrk(CBLAS_ORDER order, CBLAS_UPLO uplo, CBLAS_TRANSPOSE trans,
+                 int n, int k, const void *alpha, const void *A, int lda,
+                 const void *beta, void *C, int ldc) {
+  syrk<Complex_D>(order, uplo, trans, n, k, *(const Complex_D*)alpha,
+                  (const Complex_D*)A, lda, *(const Complex_D*)beta,
+                  (Complex_D*)C, ldc);
+}
+
+void cblas_csyrk(CBLAS_ORDER order, CBLAS_UPLO uplo, CBLAS_TRANSPOSE trans,
+                 int n, int k, const void *alpha, const void *A, int lda,
+                 const void *beta, void *C, int ldc) {
+  syrk<Complex_F>(order, uplo, trans, n, k, *(const Complex_F*)alpha,
+                  (const Complex_F*)A, lda, *(const Complex_F*)beta,
+                  (Complex_F*)C, ldc);
+}
+
+void cblas_zherk(CBLAS_ORDER order, CBLAS_UPLO uplo, CBLAS_TRANSPOSE trans,
+                 int n, int k, double alpha, const void *A, int lda,
+                 double beta, void *C, int ldc) {
+  herk<Complex_D>(order, uplo, trans, n, k, alpha, (const Complex_D*)A, lda,
+                  beta, (Complex_D*)C, ldc);
+}
+
+void cblas_cherk(CBLAS_ORDER order, CBLAS_UPLO uplo, CBLAS_TRANSPOSE trans,
+                 int n, int k, float alpha, const void *A, int lda,
+                 float beta, void *C, int ldc) {
+  herk<Complex_F>(order, uplo, trans, n, k, alpha, (const Complex_F*)A, lda,
+                  beta, (Complex_F*)C, ldc);
+}
+
+}
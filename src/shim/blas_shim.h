@@ -0,0 +1,153 @@
+#pragma once
+#include <rtat.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+
+// Drop-in BLAS shim. The shared library exports the CBLAS GEMM, TRSM,
+// SYRK and HERK symbols, so an unmodified application can be tuned by
+// preloading it (LD_PRELOAD) or linking it ahead of the host BLAS. Each
+// call stages its operands on the device, runs the autotuned plan and
+// copies the result back.
+//
+// Environment:
+//   RTAT_PLAN_FILE       converged plans are read from and saved to it
+//   RTAT_SHIM_BUDGET_US  per call planning overhead budget, default 10us
+//   RTAT_SHIM_REPORT     if set, the overhead report is printed at exit
+
+namespace rtat {
+
+// Host time spent choosing a plan and sizing its workspace, which is
+// what the shim adds to each call beyond the transfers and the BLAS
+// work itself
+struct Shim_Overhead {
+  double budget_us;
+  size_t calls = 0;
+  size_t over_budget = 0;
+  double total_us = 0.0;
+  double max_us = 0.0;
+
+  Shim_Overhead(double budget_us) : budget_us(budget_us) {}
+
+  void record(double us) {
+    calls++;
+    total_us += us;
+    max_us = std::max(max_us, us);
+    if (us > budget_us) over_budget++;
+  }
+
+  double mean_us() const { return calls ? total_us/calls : 0.0; }
+
+  friend std::ostream& operator<<(std::ostream&, const Shim_Overhead&);
+};
+
+class BLAS_Shim {
+  using Clock = std::chrono::steady_clock;
+
+  std::mutex lock;
+  rtat planners;
+  Stream s;
+  BLAS_Handle handle;
+  ManagedWorkspace operand_space;
+  ManagedWorkspace work_space;
+  std::string plan_file;
+  Shim_Overhead overhead;
+  bool report;
+
+  template<typename T>
+  Matrix<T> upload(Workspace &arena, const T *A, int m, int n, int ld);
+  template<typename T>
+  void download(T *A, Matrix<T> dA);
+
+  template<typename Planner, typename Params>
+  void run(Planner &planner, Params params);
+
+public:
+  BLAS_Shim();
+  ~BLAS_Shim();
+
+  // The process wide shim used by the exported symbols
+  static BLAS_Shim& instance();
+
+  // Column major only, the exported symbols translate row major calls
+  template<typename T>
+  void gemm(BLAS_Operation transa, BLAS_Operation transb,
+            int m, int n, int k, T alpha, const T *A, int lda,
+            const T *B, int ldb, T beta, T *C, int ldc);
+
+  template<typename T>
+  void trsm(BLAS_Side side, BLAS_Fill_Mode uplo, BLAS_Operation trans,
+            BLAS_Diag diag, int m, int n, T alpha,
+            const T *A, int lda, T *B, int ldb);
+
+  template<typename T>
+  void syrk(BLAS_Fill_Mode uplo, BLAS_Operation trans, int n, int k,
+            T alpha, const T *A, int lda, T beta, T *C, int ldc);
+
+  template<typename T>
+  void herk(BLAS_Fill_Mode uplo, BLAS_Operation trans, int n, int k,
+            Real_T<T> alpha, const T *A, int lda,
+            Real_T<T> beta, T *C, int ldc);
+
+  Shim_Overhead get_overhead();
+  nlohmann::json save_plans();
+};
+
+}
+
+// The standard CBLAS interface. Declared here for callers of the shim,
+// do not include alongside another cblas.h.
+extern "C" {
+enum CBLAS_ORDER { CblasRowMajor = 101, CblasColMajor = 102 };
+enum CBLAS_TRANSPOSE { CblasNoTrans = 111, CblasTrans = 112,
+                       CblasConjTrans = 113 };
+enum CBLAS_UPLO { CblasUpper = 121, CblasLower = 122 };
+enum CBLAS_DIAG { CblasNonUnit = 131, CblasUnit = 132 };
+enum CBLAS_SIDE { CblasLeft = 141, CblasRight = 142 };
+
+void cblas_dgemm(CBLAS_ORDER, CBLAS_TRANSPOSE, CBLAS_TRANSPOSE,
+                 int m, int n, int k, double alpha, const double *A, int lda,
+                 const double *B, int ldb, double beta, double *C, int ldc);
+void cblas_sgemm(CBLAS_ORDER, CBLAS_TRANSPOSE, CBLAS_TRANSPOSE,
+                 int m, int n, int k, float alpha, const float *A, int lda,
+                 const float *B, int ldb, float beta, float *C, int ldc);
+void cblas_zgemm(CBLAS_ORDER, CBLAS_TRANSPOSE, CBLAS_TRANSPOSE,
+                 int m, int n, int k, const void *alpha, const void *A, int lda,
+                 const void *B, int ldb, const void *beta, void *C, int ldc);
+void cblas_cgemm(CBLAS_ORDER, CBLAS_TRANSPOSE, CBLAS_TRANSPOSE,
+                 int m, int n, int k, const void *alpha, const void *A, int lda,
+                 const void *B, int ldb, const void *beta, void *C, int ldc);
+
+void cblas_dtrsm(CBLAS_ORDER, CBLAS_SIDE, CBLAS_UPLO, CBLAS_TRANSPOSE,
+                 CBLAS_DIAG, int m, int n, double alpha,
+                 const double *A, int lda, double *B, int ldb);
+void cblas_strsm(CBLAS_ORDER, CBLAS_SIDE, CBLAS_UPLO, CBLAS_TRANSPOSE,
+                 CBLAS_DIAG, int m, int n, float alpha,
+                 const float *A, int lda, float *B, int ldb);
+void cblas_ztrsm(CBLAS_ORDER, CBLAS_SIDE, CBLAS_UPLO, CBLAS_TRANSPOSE,
+                 CBLAS_DIAG, int m, int n, const void *alpha,
+                 const void *A, int lda, void *B, int ldb);
+void cblas_ctrsm(CBLAS_ORDER, CBLAS_SIDE, CBLAS_UPLO, CBLAS_TRANSPOSE,
+                 CBLAS_DIAG, int m, int n, const void *alpha,
+                 const void *A, int lda, void *B, int ldb);
+
+void cblas_dsyrk(CBLAS_ORDER, CBLAS_UPLO, CBLAS_TRANSPOSE, int n, int k,
+                 double alpha, const double *A, int lda,
+                 double beta, double *C, int ldc);
+void cblas_ssyrk(CBLAS_ORDER, CBLAS_UPLO, CBLAS_TRANSPOSE, int n, int k,
+                 float alpha, const float *A, int lda,
+                 float beta, float *C, int ldc);
+void cblas_zsyrk(CBLAS_ORDER, CBLAS_UPLO, CBLAS_TRANSPOSE, int n, int k,
+                 const void *alpha, const void *A, int lda,
+                 const void *beta, void *C, int ldc);
+void cblas_csyrk(CBLAS_ORDER, CBLAS_UPLO, CBLAS_TRANSPOSE, int n, int k,
+                 const void *alpha, const void *A, int lda,
+                 const void *beta, void *C, int ldc);
+
+void cblas_zherk(CBLAS_ORDER, CBLAS_UPLO, CBLAS_TRANSPOSE, int n, int k,
+                 double alpha, const void *A, int lda,
+                 double beta, void *C, int ldc);
+void cblas_cherk(CBLAS_ORDER, CBLAS_UPLO, CBLAS_TRANSPOSE, int n, int k,
+                 float alpha, const void *A, int lda,
+                 float beta, void *C, int ldc);
+}
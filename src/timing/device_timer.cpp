@@ -1,7 +1,49 @@
 #include "device_timer.h"
+#include <map>
+#include <vector>
 
 namespace rtat {
 
+namespace {
+
+// Events of one device, each free once the pool holds the only reference
+class Event_Pool {
+  std::vector<std::shared_ptr<Event>> events;
+  size_t next = 0;
+public:
+  std::shared_ptr<Event> acquire() {
+    for (size_t i = 0; i < events.size(); i++) {
+      size_t e = (next + i) % events.size();
+      if (events[e].use_count() == 1) {
+        next = (e + 1) % events.size();
+        return events[e];
+      }
+    }
+    events.push_back(std::make_shared<Event>());
+    return events.back();
+  }
+
+  size_t size() const { return events.size(); }
+};
+
+// Never destroyed, as the runtime may be unloaded before thread locals
+Event_Pool& pool() {
+  thread_local auto *pools = new std::map<int, Event_Pool>();
+  int device;
+  gpuAssert(gpu::GetDevice(&device));
+  return (*pools)[device];
+}
+
+}
+
+std::shared_ptr<Event> Device_Timer::pooled_event() {
+  return pool().acquire();
+}
+
+size_t Device_Timer::pooled_events() {
+  return pool().size();
+}
+
 std::optional<float> Device_Timer::query_time() {
   if (!start->query() || !end->query())
     return {};
@@ -16,8 +16,8 @@ public:
 public:
   template<typename Func>
   Device_Timer(Func f, Stream s, Mode mode = ASYNCHRONOUS) :
-      start(std::make_unique<Event>()),
-      end(std::make_unique<Event>())
+      start(pooled_event()),
+      end(pooled_event())
   {
     if (mode == SEMI_SYNCHRONOUS || mode == SYNCHRONOUS)
       gpuAssert(gpu::DeviceSynchronize());
@@ -33,8 +33,15 @@ public:
   std::optional<float> query_time();
   float time();
 
+  // Events held by the calling thread's pool for the current device
+  static size_t pooled_events();
+
 private:
-  std::unique_ptr<Event> start, end;
+  // Shared, so copies of a timer read the same events. Events come from a
+  // pool, per thread and device, and are reused once no timer holds them,
+  // so timing a call does not create events.
+  std::shared_ptr<Event> start, end;
+  static std::shared_ptr<Event> pooled_event();
   float t = -1.0;
 };
 
@@ -17,6 +17,11 @@ void Timer_Bank::append(Device_Timer &timer) {
   timers.push(std::move(timer));
 }
 
+void Timer_Bank::append(float time) {
+  synchronize();
+  times.push_back(time);
+}
+
 void Timer_Bank::synchronize() {
   while (!timers.empty()) {
     auto& timer = timers.front();
@@ -12,6 +12,8 @@ class Timer_Bank {
   void update();
 public:
   void append(Device_Timer &timer);
+  // A time taken other than by a device timer, kept after those pending
+  void append(float time);
   const std::vector<float>& get_times();
   void synchronize();
 
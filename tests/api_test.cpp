@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include <iostream>
+#include <thread>
 #include "gpu-api.h"
 
 using namespace rtat;
@@ -24,3 +25,91 @@ TEST(API_Test, Elapsed_Time) {
 
   SUCCEED();
 }
+
+TEST(API_Test, Pinned_Transfers) {
+  const size_t n = 1000;
+  Pinned_Buffer<double> pinned(n);
+  std::vector<double> registered(n, 0.0);
+  Host_Registration pin(registered.data(), n*sizeof(double));
+  for (size_t i = 0; i < n; i++) pinned[i] = i;
+
+  double *x;
+  gpuAssert(gpu::Malloc(&x, n*sizeof(double)));
+
+  // The download waits for the upload, on another stream
+  Copy_Engine copies;
+  copies.download_after(copies.to_device(x, pinned.data(), n*sizeof(double)));
+  copies.to_host(registered.data(), x, n*sizeof(double)).synchronize();
+  for (size_t i = 0; i < n; i++) ASSERT_EQ(registered[i], i);
+
+  Pinned_Buffer<double> moved = std::move(pinned);
+  ASSERT_EQ(moved.size(), n);
+  ASSERT_EQ(pinned.size(), 0);
+
+  // Growing reallocates only when too small
+  double *data = moved.data();
+  moved.grow_to_fit(n/2);
+  ASSERT_EQ(moved.data(), data);
+  moved.grow_to_fit(2*n);
+  ASSERT_EQ(moved.size(), 2*n);
+  gpuAssert(gpu::Free(x));
+}
+
+TEST(API_Test, Execution_Graph) {
+  const size_t n = 100;
+  std::vector<double> in(n, 1.0), out(n, 0.0);
+  double *x, *y;
+  gpuAssert(gpu::Malloc(&x, n*sizeof(double)));
+  gpuAssert(gpu::Malloc(&y, n*sizeof(double)));
+
+  // Nothing runs while capturing
+  Stream s;
+  gpuAssert(gpu::Memcpy(x, in.data(), n*sizeof(double), gpu::MemcpyHostToDevice));
+  gpuAssert(gpu::Memset(y, 0, n*sizeof(double)));
+  Execution_Graph graph;
+  graph.capture(s, [&]() {
+    gpuAssert(gpu::MemcpyAsync(y, x, n*sizeof(double), gpu::MemcpyDeviceToDevice, s));
+  });
+  gpuAssert(gpu::Memcpy(out.data(), y, n*sizeof(double), gpu::MemcpyDeviceToHost));
+  ASSERT_EQ(out[0], 0.0);
+
+  // Replays read the operands as they are at launch
+  for (double v : {2.0, 3.0}) {
+    std::fill(in.begin(), in.end(), v);
+    gpuAssert(gpu::Memcpy(x, in.data(), n*sizeof(double), gpu::MemcpyHostToDevice));
+    graph.launch(s);
+    s.synchronize();
+    gpuAssert(gpu::Memcpy(out.data(), y, n*sizeof(double), gpu::MemcpyDeviceToHost));
+    for (auto o : out) ASSERT_EQ(o, v);
+  }
+
+  gpuAssert(gpu::Free(x));
+  gpuAssert(gpu::Free(y));
+}
+
+// Each stream gets one handle, bound to it, however many threads ask
+TEST(API_Test, Handle_Pool) {
+  Handle_Pool pool;
+  Stream s1, s2;
+
+  std::vector<std::thread> threads;
+  std::vector<gpu::blasHandle_t> fetched(8);
+  for (size_t i = 0; i < fetched.size(); i++)
+    threads.emplace_back([&, i]() { fetched[i] = pool.get(i%2 ? s2 : s1); });
+  for (auto &t : threads) t.join();
+
+  ASSERT_EQ(pool.size(), 2);
+  for (size_t i = 0; i < fetched.size(); i++)
+    ASSERT_EQ(fetched[i], fetched[i%2]);
+  ASSERT_NE(fetched[0], fetched[1]);
+
+  gpu::Stream_t bound;
+  gpu::blasGetStream(pool.get(s2), &bound);
+  ASSERT_EQ(bound, (gpu::Stream_t)s2);
+
+  // A handle keeps its stream alive, and copies share it
+  BLAS_Handle handle(Stream{});
+  BLAS_Handle copy = handle;
+  copy.set_stream(s1);
+  ASSERT_EQ((gpu::Stream_t)handle.get_stream(), (gpu::Stream_t)s1);
+}
@@ -21,13 +21,26 @@ protected:
   }
 };
 
+// A team of three. With the host backend the members are distinct 
+// simulated devices; otherwise devices are repeated as needed.
+inline std::shared_ptr<Device_Team> test_team() {
+#if defined(_RTAT_HOST)
+  setenv("RTAT_HOST_DEVICES", "3", 1);
+#endif
+  auto devices = Device_Team::all_devices();
+  devices.resize(3, devices[0]);
+  return std::make_shared<Device_Team>(devices);
+}
+
 template<typename T>
 class TestMatrix {
+  using Real = decltype(std::abs(T()));
 public:
   TestMatrix(size_t m, size_t n) : TestMatrix(m,n,m) {}
 
   TestMatrix(size_t m, size_t n, size_t ld) : m(m), n(n), ld(ld), space(footprint()*sizeof(T)), 
-                                              host_vector(footprint()) {
+                                              host_vector(footprint()),
+                                              pinned(host_vector.data(), footprint()*sizeof(T)) {
     if (ld < m) throw "Bad matrix ld";
 
     randomize_host();
@@ -41,23 +54,35 @@ public:
 
   size_t footprint() {return ld*n;}
 
+  // Only ever assigned vectors of the same size, so it is never 
+  // reallocated and stays pinned
   std::vector<T> host_vector;
+  Host_Registration pinned;
+  Copy_Engine copies;
 
+  // Transfers follow all work on the device, as tests check results 
+  // produced on any stream
   void upload() {
-    gpuAssert(gpu::Memcpy(space, host_vector.data(), host_vector.size()*sizeof(T), 
-                         gpu::MemcpyHostToDevice));
+    gpuAssert(gpu::DeviceSynchronize());
+    copies.to_device(space, host_vector.data(), host_vector.size()*sizeof(T)).synchronize();
   }
 
   void download() {
-    gpuAssert(gpu::Memcpy(host_vector.data(), space, host_vector.size()*sizeof(T), 
-                         gpu::MemcpyDeviceToHost));
+    gpuAssert(gpu::DeviceSynchronize());
+    copies.to_host(host_vector.data(), space, host_vector.size()*sizeof(T)).synchronize();
   }
 
   void randomize_host() {
-    std::uniform_real_distribution<T> unif(-1.0, 1.0);
+    std::uniform_real_distribution<Real> unif(-1.0, 1.0);
     static std::default_random_engine re;
 
-    for (auto &x : host_vector) x = unif(re);
+    for (auto &x : host_vector) {
+      if constexpr(is_complex_v<T>) {
+        x = T(unif(re), unif(re));
+      } else {
+        x = unif(re);
+      }
+    }
   }
   
   void zero_host() {
@@ -112,10 +137,10 @@ public:
   }
 
   friend bool operator==(const TestMatrix &A, const TestMatrix &B) {
-    T epsilon = 0;
-    if constexpr(std::is_same_v<T,float>) {
+    Real epsilon = 0;
+    if constexpr(std::is_same_v<Real,float>) {
       epsilon = 1e-4;
-    } else if constexpr(std::is_same_v<T,double>) {
+    } else if constexpr(std::is_same_v<Real,double>) {
       epsilon = 1e-10;
     }
 
@@ -129,10 +154,10 @@ public:
   }
 
   bool is_zero() {
-    T epsilon = 0;
-    if constexpr(std::is_same_v<T,float>) {
+    Real epsilon = 0;
+    if constexpr(std::is_same_v<Real,float>) {
       epsilon = 1e-4;
-    } else if constexpr(std::is_same_v<T,double>) {
+    } else if constexpr(std::is_same_v<Real,double>) {
       epsilon = 1e-10;
     }
     for (size_t i = 0; i < m; i++) 
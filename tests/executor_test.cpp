@@ -288,3 +288,209 @@ TEST_F(SYRK_Executor_Test, SYRK_Correctness_Double) {
     }
   }
 }
+
+// Every plan must agree with a direct library call, including 
+// conjugate-transposed inputs
+TEST_F(GEMM_Executor_Test, Correctness_Complex_Double) {
+  using T = std::complex<double>;
+  GEMM_Executor<T> exec;
+
+  int m = 37;
+  int n = 45;
+  int k = 29;
+
+  T alpha(0.5, -1.25);
+  T beta(0.75, 0.5);
+
+  auto ops = {gpu::BLAS_OP_N, gpu::BLAS_OP_T, gpu::BLAS_OP_C};
+  for (auto opA : ops) {
+    for (auto opB : ops) {
+      for (auto &opts : GEMM_Options::enumerate()) {
+        int Am = (opA != gpu::BLAS_OP_N) ? k : m;
+        int An = (opA != gpu::BLAS_OP_N) ? m : k;
+        int Bm = (opB != gpu::BLAS_OP_N) ? n : k;
+        int Bn = (opB != gpu::BLAS_OP_N) ? k : n;
+
+        TestMatrix<T> A(Am,An,Am);
+        TestMatrix<T> B(Bm,Bn,Bm);
+        TestMatrix<T> C(m,n,m);
+        TestMatrix<T> C_ref(m,n,m);
+        C_ref.host_vector = C.host_vector;
+        C_ref.upload();
+
+        gpuTgemm<T>(handle, opA, opB, A, B, C_ref, alpha, beta);
+
+        GEMM_Inputs<T> inputs(handle, opA, opB, A, B, C, alpha, beta);
+
+        size_t ws = exec.calculate_workspace(inputs, opts);
+        ManagedWorkspace space(ws);
+
+        exec.execute(inputs, opts, space, s);
+
+        C.download();
+        C_ref.download();
+        EXPECT_TRUE(C == C_ref);
+      }
+    }
+  }
+}
+
+TEST_F(SYRK_Executor_Test, HERK_Correctness_Complex_Double) {
+  using T = std::complex<double>;
+  HERK_Executor<T> exec;
+
+  int n = 53;
+  int k = 31;
+
+  for (auto lower : {false,true}) {
+    for (auto trans : {gpu::BLAS_OP_N, gpu::BLAS_OP_C}) {
+      for (auto &opts : SYRK_Options::enumerate()) {
+        int m_A = (trans != gpu::BLAS_OP_N) ? k : n;
+        int n_A = (trans != gpu::BLAS_OP_N) ? n : k;
+        TestMatrix<T> A(m_A,n_A,m_A);
+        TestMatrix<T> C(n,n,n);
+        TestMatrix<T> C_ref(n,n,n);
+        C_ref.host_vector = C.host_vector;
+        C_ref.upload();
+
+        gpuTherk<T>(handle, lower, trans, A, C_ref, 1.5, 0.0);
+
+        HERK_Inputs<T> inputs(handle, 
+          lower ? gpu::BLAS_FILL_MODE_LOWER : gpu::BLAS_FILL_MODE_UPPER,
+          trans, A, C, 1.5, 0.0);
+
+        size_t ws = exec.calculate_workspace(inputs, opts);
+        ManagedWorkspace space(ws);
+
+        exec.execute(inputs, opts, space, s);
+
+        C.download();
+        C_ref.download();
+        // Only the referenced triangle is defined
+        for (int i=0; i<n; i++) {
+          for (int j=0; j<n; j++) {
+            if ((lower && i < j) || (!lower && i > j)) {
+              C.host_vector[j*C.ld+i] = 0.0;
+              C_ref.host_vector[j*C.ld+i] = 0.0;
+            }
+          }
+        }
+        EXPECT_TRUE(C == C_ref);
+      }
+    }
+  }
+}
+
+// In place plans on square operands must match the default plan, leave 
+// A untouched and only need a tile of workspace beyond a copy of A
+TEST_F(TRSM_Executor_Test, TRSM_In_Place_Square) {
+  TRSM_Executor<double> trsm_exec;
+
+  int n = 150;
+  size_t tile_bytes = 64*64*sizeof(double);
+
+  for (auto side_left : {false,true}) {
+    for (auto lower : {false,true}) {
+      for (auto trans : {false,true}) {
+        for (auto &opts : TRSM_Options::enumerate()) {
+          if (!opts.in_place) continue;
+
+          TestMatrix<double> A(n,n,n);
+          for (int i=0; i<n; i++)
+            A.host_vector[i*A.ld+i] += n+1;
+          A.upload();
+          TestMatrix<double> B(n,n,n);
+          TestMatrix<double> Ref(n,n,n);
+          Ref.host_vector = B.host_vector;
+          Ref.upload();
+          auto A_host = A.host_vector;
+
+          for (auto *X : {&B, &Ref}) {
+            TRSM_Inputs<double> inputs(handle, 
+              side_left ? gpu::BLAS_SIDE_LEFT : gpu::BLAS_SIDE_RIGHT, 
+              lower ? gpu::BLAS_FILL_MODE_LOWER : gpu::BLAS_FILL_MODE_UPPER,
+              trans ? gpu::BLAS_OP_T : gpu::BLAS_OP_N, 
+              gpu::BLAS_DIAG_NON_UNIT, A, *X, 0.5);
+            TRSM_Options plan = (X == &B) ? opts : TRSM_Options();
+
+            size_t ws = trsm_exec.calculate_workspace(inputs, plan);
+            if (X == &B && !opts.transpose_A) {
+              EXPECT_LE(ws, tile_bytes);
+            }
+            ManagedWorkspace space(ws);
+
+            trsm_exec.execute(inputs, plan, space, s);
+          }
+
+          B.download();
+          Ref.download();
+          A.download();
+          EXPECT_TRUE(B == Ref);
+          EXPECT_EQ(A.host_vector, A_host);
+        }
+      }
+    }
+  }
+}
+
+// in_place is only offered where it transposes the output, and for TRSM
+// only where B is square, so no two options form the same operation
+TEST(Options_Test, In_Place_Distinct) {
+  for (auto &opts : TRSM_Options::enumerate())
+    EXPECT_TRUE(!opts.in_place || opts.swap_side);
+  for (auto &opts : SYRK_Options::enumerate())
+    EXPECT_TRUE(!opts.in_place || opts.transpose_C);
+
+  TRSM_Options in_place(true, false, true);
+  TRSM_Key square(gpu::BLAS_SIDE_LEFT, gpu::BLAS_FILL_MODE_LOWER,
+                  gpu::BLAS_OP_N, gpu::BLAS_DIAG_UNIT, 5, 5);
+  TRSM_Key wide(gpu::BLAS_SIDE_LEFT, gpu::BLAS_FILL_MODE_LOWER,
+                gpu::BLAS_OP_N, gpu::BLAS_DIAG_UNIT, 5, 7);
+  EXPECT_TRUE(in_place.applies(square));
+  EXPECT_FALSE(in_place.applies(wide));
+}
+
+TEST_F(SYRK_Executor_Test, SYRK_In_Place_Square) {
+  SYRK_Executor<double> syrk_exec;
+
+  int n = 150;
+  size_t tile_bytes = 64*64*sizeof(double);
+
+  for (auto lower : {false,true}) {
+    for (auto trans : {false,true}) {
+      for (auto &opts : SYRK_Options::enumerate()) {
+        if (!opts.in_place) continue;
+
+        TestMatrix<double> A(n,n,n);
+        TestMatrix<double> C(n,n,n);
+        TestMatrix<double> Ref(n,n,n);
+        Ref.host_vector = C.host_vector;
+        Ref.upload();
+        auto A_host = A.host_vector;
+
+        for (auto *X : {&C, &Ref}) {
+          SYRK_Inputs<double> inputs(handle, 
+            lower ? gpu::BLAS_FILL_MODE_LOWER : gpu::BLAS_FILL_MODE_UPPER,
+            trans ? gpu::BLAS_OP_T : gpu::BLAS_OP_N, 
+            A, *X, 0.5, 2.0);
+          SYRK_Options plan = (X == &C) ? opts : SYRK_Options();
+
+          size_t ws = syrk_exec.calculate_workspace(inputs, plan);
+          if (X == &C && !opts.transpose_A) {
+            EXPECT_LE(ws, tile_bytes);
+          }
+          ManagedWorkspace space(ws);
+
+          syrk_exec.execute(inputs, plan, space, s);
+        }
+
+        C.download();
+        Ref.download();
+        A.download();
+        // Includes the unreferenced triangle, which must be untouched
+        EXPECT_TRUE(C == Ref);
+        EXPECT_EQ(A.host_vector, A_host);
+      }
+    }
+  }
+}
@@ -18,6 +18,10 @@ TEST(JSON_Test, SYRK_Key) {
       key_json["trans"] = trans;
       key_json["n"] = n;
       key_json["k"] = k;
+      key_json["ldA"] = "P";
+      key_json["ldC"] = "U";
+      key_json["align"] = "U";
+      key_json["beta"] = "X";
 
       SYRK_Key key = from_json<SYRK_Key>(key_json);
       nlohmann::json test_json = to_json(key);
@@ -39,25 +43,42 @@ TEST(JSON_Test, SYRK_Key) {
 TEST(JSON_Test, SYRK_Options) {
   for (auto &transA : {"T","F"}) {
     for (auto &transC : {"T","F"}) {
-      nlohmann::json opts_json;
-      opts_json["transA"] = transA;
-      opts_json["transC"] = transC;
+      for (auto &in_place : {"T","F"}) {
+       for (auto &triangular : {"T","F"}) {
+        nlohmann::json opts_json;
+        opts_json["transA"] = transA;
+        opts_json["transC"] = transC;
+        opts_json["in_place"] = in_place;
+        opts_json["triangular"] = triangular;
 
-      SYRK_Options opts = from_json<SYRK_Options>(opts_json);
-      nlohmann::json test_json = to_json(opts);
+        SYRK_Options opts = from_json<SYRK_Options>(opts_json);
+        nlohmann::json test_json = to_json(opts);
 
-      ASSERT_EQ(test_json, opts_json);
+        ASSERT_EQ(test_json, opts_json);
+       }
+      }
     }
   }
   for (auto &transA : {false,true}) {
     for (auto &transC : {false,true}) {
-      SYRK_Options opts(transA, transC);
-      nlohmann::json json = to_json(opts);
-      SYRK_Options test_opts = from_json<SYRK_Options>(json);
+      for (auto &in_place : {false,true}) {
+       for (auto &triangular : {false,true}) {
+        SYRK_Options opts(transA, transC, in_place, triangular);
+        nlohmann::json json = to_json(opts);
+        SYRK_Options test_opts = from_json<SYRK_Options>(json);
 
-      ASSERT_TRUE(!(test_opts < opts) && !(opts < test_opts));
+        ASSERT_TRUE(!(test_opts < opts) && !(opts < test_opts));
+       }
+      }
     }
   }
+  // Older plans without in_place or triangular
+  nlohmann::json old_json;
+  old_json["transA"] = "T";
+  old_json["transC"] = "F";
+  SYRK_Options old_opts = from_json<SYRK_Options>(old_json);
+  ASSERT_EQ(std::string(old_opts.in_place), "F");
+  ASSERT_EQ(std::string(old_opts.triangular), "F");
 }
 
 TEST(JSON_Test, TRSM_Key) {
@@ -74,6 +95,9 @@ TEST(JSON_Test, TRSM_Key) {
           key_json["diag"] = diag;
           key_json["m"] = m;
           key_json["n"] = n;
+          key_json["ldA"] = "U";
+          key_json["ldB"] = "P";
+          key_json["align"] = "A";
 
           TRSM_Key key = from_json<TRSM_Key>(key_json);
           nlohmann::json test_json = to_json(key);
@@ -106,25 +130,42 @@ TEST(JSON_Test, TRSM_Key) {
 TEST(JSON_Test, TRSM_Options) {
   for (auto &transA : {"T","F"}) {
     for (auto &swap_side : {"T","F"}) {
-      nlohmann::json opts_json;
-      opts_json["swap_side"] = swap_side;
-      opts_json["transA"] = transA;
+      for (auto &in_place : {"T","F"}) {
+       for (auto &triangular : {"T","F"}) {
+        nlohmann::json opts_json;
+        opts_json["swap_side"] = swap_side;
+        opts_json["transA"] = transA;
+        opts_json["in_place"] = in_place;
+        opts_json["triangular"] = triangular;
 
-      TRSM_Options opts = from_json<TRSM_Options>(opts_json);
-      nlohmann::json test_json = to_json(opts);
+        TRSM_Options opts = from_json<TRSM_Options>(opts_json);
+        nlohmann::json test_json = to_json(opts);
 
-      ASSERT_EQ(test_json, opts_json);
+        ASSERT_EQ(test_json, opts_json);
+       }
+      }
     }
   }
   for (auto &transA : {false,true}) {
     for (auto &swap_side : {false,true}) {
-      TRSM_Options opts(swap_side, transA);
-      nlohmann::json json = to_json(opts);
-      TRSM_Options test_opts = from_json<TRSM_Options>(json);
+      for (auto &in_place : {false,true}) {
+       for (auto &triangular : {false,true}) {
+        TRSM_Options opts(swap_side, transA, in_place, triangular);
+        nlohmann::json json = to_json(opts);
+        TRSM_Options test_opts = from_json<TRSM_Options>(json);
 
-      ASSERT_TRUE(!(test_opts < opts) && !(opts < test_opts));
+        ASSERT_TRUE(!(test_opts < opts) && !(opts < test_opts));
+       }
+      }
     }
   }
+  // Older plans without in_place or triangular
+  nlohmann::json old_json;
+  old_json["swap_side"] = "T";
+  old_json["transA"] = "T";
+  TRSM_Options old_opts = from_json<TRSM_Options>(old_json);
+  ASSERT_EQ(std::string(old_opts.in_place), "F");
+  ASSERT_EQ(std::string(old_opts.triangular), "F");
 }
 
 TEST(JSON_Test, GEMM_Key) {
@@ -139,6 +180,11 @@ TEST(JSON_Test, GEMM_Key) {
        key_json["m"] = m;
        key_json["n"] = n;
        key_json["k"] = k;
+       key_json["ldA"] = "A";
+       key_json["ldB"] = "U";
+       key_json["ldC"] = "P";
+       key_json["align"] = "U";
+       key_json["beta"] = "1";
 
        GEMM_Key key = from_json<GEMM_Key>(key_json);
        nlohmann::json test_json = to_json(key);
@@ -158,7 +204,18 @@ TEST(JSON_Test, GEMM_Key) {
       ASSERT_TRUE(!(test_key < key) && !(key < test_key));
     }
   }
-  
+
+  // Older keys without layout or beta classes
+  nlohmann::json old_json;
+  old_json["transA"] = "N";
+  old_json["transB"] = "T";
+  old_json["m"] = m;
+  old_json["n"] = n;
+  old_json["k"] = k;
+  GEMM_Key old_key = from_json<GEMM_Key>(old_json);
+  ASSERT_EQ(std::string(old_key.ldc), "A");
+  ASSERT_EQ(std::string(old_key.align), "A");
+  ASSERT_EQ(std::string(old_key.beta), "0");
 }
 
 TEST(JSON_Test, GEMM_Options_Pad) {
@@ -207,3 +264,45 @@ TEST(JSON_Test, GEMM_Options_Pad) {
     }
   }
 }
+
+TEST(JSON_Test, GEMM_Options_Mixed) {
+  for (auto &opts : GEMM_Options_Mixed::enumerate()) {
+    nlohmann::json json = to_json(opts);
+    GEMM_Options_Mixed test_opts = from_json<GEMM_Options_Mixed>(json);
+
+    ASSERT_TRUE(!(test_opts < opts) && !(opts < test_opts));
+    ASSERT_EQ(to_json(test_opts), json);
+  }
+}
+
+TEST(JSON_Test, GEMM_Options_Distributed) {
+  for (auto &opts : GEMM_Options_Distributed::enumerate()) {
+    nlohmann::json json = to_json(opts);
+    GEMM_Options_Distributed test_opts = from_json<GEMM_Options_Distributed>(json);
+
+    ASSERT_TRUE(!(test_opts < opts) && !(opts < test_opts));
+    ASSERT_EQ(to_json(test_opts), json);
+  }
+}
+
+TEST(JSON_Test, GEMM_Options_Out_Of_Core) {
+  for (auto &opts : GEMM_Options_Out_Of_Core::enumerate()) {
+    nlohmann::json json = to_json(opts);
+    GEMM_Options_Out_Of_Core test_opts = from_json<GEMM_Options_Out_Of_Core>(json);
+
+    ASSERT_TRUE(!(test_opts < opts) && !(opts < test_opts));
+    ASSERT_EQ(to_json(test_opts), json);
+  }
+}
+
+TEST(JSON_Test, Options) {
+  using Test_Ops = Options<Option<int, 16, 32>, Option<bool, false, true>>;
+  for (auto &opts : Test_Ops::enumerate()) {
+    nlohmann::json json = to_json(opts);
+    ASSERT_EQ(json.size(), 2);
+    Test_Ops test_opts = from_json<Test_Ops>(json);
+    ASSERT_EQ(test_opts.index(), opts.index());
+  }
+  ASSERT_EQ(to_json(Test_Ops(32, true)), 
+            nlohmann::json(std::vector<std::string>{"32", "T"}));
+}
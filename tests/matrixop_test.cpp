@@ -301,6 +301,282 @@ TEST_F(MatrixOp_Test, TTMulTest) {
   ASSERT_TRUE(C.is_zero());
 }
 
+// Two transposing moves feeding an accumulate collapse into one GEAM
+TEST_F(MatrixOp_Test, OptimizeMoves) {
+  int m = 17;
+  int n = 23;
+
+  TestMatrix<double> A(m,n,m);
+  TestMatrix<double> C(m,n,m);
+  TestMatrix<double> Ref(m,n,m);
+  Ref.host_vector = C.host_vector;
+
+  std::unique_ptr<MatrixOp<double>> Aop = std::make_unique<NoOp<double>>(A);
+  std::unique_ptr<MatrixOp<double>> Cop = std::make_unique<NoOp<double>>(C);
+  Aop = std::make_unique<MatrixMove<double>>(std::move(Aop), 2.0, true, 1);
+  Aop = std::make_unique<MatrixMove<double>>(std::move(Aop), 0.5, true, 1);
+  std::unique_ptr<MatrixOp<double>> acc = std::make_unique<MatrixAccumulate<double>>(
+      std::move(Aop), std::move(Cop), 1.0, 1.0, false);
+  ASSERT_GT(acc->workspace_req(), 0);
+
+  size_t elided = 0;
+  acc = optimize(std::move(acc), elided);
+  EXPECT_EQ(elided, 2);
+  EXPECT_EQ(acc->workspace_req(), 0);
+
+  acc->execute(handle, Workspace(), Workspace());
+  C.download();
+
+  for (size_t i = 0; i < Ref.host_vector.size(); i++)
+    Ref.host_vector[i] += A.host_vector[i];
+  EXPECT_TRUE(C == Ref);
+}
+
+// Scaling moves are folded into alpha and then dropped
+TEST_F(MatrixOp_Test, OptimizeScalars) {
+  int m = 26;
+  int k = 34;
+  int n = 27;
+
+  TestMatrix<double> A(m,k,m);
+  TestMatrix<double> B(k,n,k);
+  TestMatrix<double> C(m,n,m);
+
+  std::unique_ptr<MatrixOp<double>> Aop = std::make_unique<NoOp<double>>(A);
+  std::unique_ptr<MatrixOp<double>> Bop = std::make_unique<NoOp<double>>(B);
+  std::unique_ptr<MatrixOp<double>> Cop = std::make_unique<NoOp<double>>(C);
+  Aop = std::make_unique<MatrixMove<double>>(std::move(Aop), 2.0, false, 1);
+  std::unique_ptr<MatrixOp<double>> mult = std::make_unique<MatrixMult<double>>(
+      std::move(Aop), std::move(Bop), std::move(Cop), false, false, 1.5, 0.0);
+
+  size_t elided = 0;
+  mult = optimize(std::move(mult), elided);
+  EXPECT_EQ(elided, 1);
+  EXPECT_EQ(mult->workspace_req(), 0);
+
+  mult->execute(handle, Workspace(), Workspace());
+  C.download();
+
+  test_gemm(A, B, C, -3.0, 1.0, false, false);
+  ASSERT_TRUE(C.is_zero());
+}
+
+// A transposed SYRK result overwriting C needs neither the zero 
+// fill nor the accumulate, and leaves the other triangle alone
+TEST_F(MatrixOp_Test, OptimizeSyrkZeroFill) {
+  int k = 31;
+  int n = 40;
+
+  for (auto lower : {false,true}) {
+    TestMatrix<double> A(n,k,n);
+    TestMatrix<double> C(n,n,n);
+    TestMatrix<double> Ref(n,n,n);
+    Ref.host_vector = C.host_vector;
+
+    std::unique_ptr<MatrixOp<double>> Aop = std::make_unique<NoOp<double>>(A);
+    std::unique_ptr<MatrixOp<double>> Cop = std::make_unique<NoOp<double>>(C);
+    std::unique_ptr<MatrixOp<double>> scratch = 
+      std::make_unique<MatrixSyrkAlloc<double>>(std::move(Aop), !lower, false, 2.0);
+    std::unique_ptr<MatrixOp<double>> acc = std::make_unique<MatrixAccumulate<double>>(
+        std::move(scratch), std::move(Cop), 1.0, 0.0, true);
+
+    size_t elided = 0;
+    acc = optimize(std::move(acc), elided);
+    EXPECT_EQ(elided, 2);
+    EXPECT_EQ(acc->workspace_req(), 0);
+
+    acc->execute(handle, Workspace(), Workspace());
+    C.download();
+
+    TestMatrix<double> AAt(n,n,n);
+    test_gemm(A, A, AAt, 2.0, 0.0, false, true);
+    for (int i=0; i<n; i++) {
+      for (int j=0; j<n; j++) {
+        bool referenced = lower ? (i >= j) : (i <= j);
+        if (referenced) Ref.host_vector[j*n+i] = AAt.host_vector[j*n+i];
+      }
+    }
+    EXPECT_TRUE(C == Ref);
+  }
+}
+
+TEST_F(MatrixOp_Test, TransposeInPlaceTest) {
+  using T = std::complex<double>;
+  const int n = 150;
+  const int ld = 160;
+  TestMatrix<T> A(n,n,ld);
+  auto A_host = A.host_vector;
+
+  std::unique_ptr<MatrixOp<T>> Aop = std::make_unique<NoOp<T>>(A);
+  MatrixTransposeInPlace<T> At(std::move(Aop), gpu::BLAS_OP_C, 64);
+  ASSERT_EQ(At.workspace_req(), 64*64);
+
+  ManagedWorkspace scratch(At.scratch_space_req_bytes());
+  At.execute(handle, Workspace(), scratch);
+  A.download();
+
+  for (int i=0; i<n; i++)
+    for (int j=0; j<n; j++)
+      ASSERT_EQ(A.host_vector[j*ld+i], std::conj(A_host[i*ld+j]));
+}
+
+TEST_F(MatrixOp_Test, TriangleTest) {
+  using T = std::complex<double>;
+  const int n = 150;
+  const int ld = 160;
+  const T alpha = 2.0;
+  const T beta = 0.5;
+  TestMatrix<T> A(n,n,ld);
+  TestMatrix<T> B(n,n,ld);
+  auto B_host = B.host_vector;
+
+  // Move the upper triangle of A^H, accumulate it into the lower of B^H
+  std::unique_ptr<MatrixOp<T>> Aop = std::make_unique<NoOp<T>>(A);
+  std::unique_ptr<MatrixOp<T>> move = std::make_unique<MatrixMoveTriangle<T>>(
+      std::move(Aop), 1.0, gpu::BLAS_OP_C, false);
+  std::unique_ptr<MatrixOp<T>> Bop = std::make_unique<NoOp<T>>(B);
+  MatrixAccumulateTriangle<T> acc(std::move(move), std::move(Bop),
+                                  alpha, beta, gpu::BLAS_OP_C, true);
+  // The moved triangle, and diagonal blocks staged 32 wide
+  ASSERT_EQ(acc.workspace_req(), n*n + 32*n);
+
+  ManagedWorkspace scratch(acc.scratch_space_req_bytes());
+  acc.execute(handle, Workspace(), scratch);
+  B.download();
+
+  for (int i=0; i<n; i++) {
+    for (int j=0; j<n; j++) {
+      T expected = (i >= j)
+        ? alpha*A.host_vector[j*ld+i] + beta*B_host[j*ld+i]
+        : B_host[j*ld+i];
+      ASSERT_NEAR(std::abs(B.host_vector[j*ld+i]-expected), 0.0, 1e-12);
+    }
+  }
+}
+
+// Triangle blocks and diagonal columns cover each element of the 
+// triangle once, in a number of calls growing with n/leaf + leaf
+TEST(Triangle_Blocks, Coverage) {
+  const int leaf = 32;
+  for (int n : {1, 31, 64, 150, 4096}) {
+    for (bool lower : {true, false}) {
+      std::vector<int> hits((size_t)n*n, 0);
+      size_t calls = 0;
+      for_each_triangle_block(n, lower, leaf, false, 
+          [&](int r, int c, int rows, int cols) {
+        calls++;
+        for (int j = c; j < c+cols; j++)
+          for (int i = r; i < r+rows; i++) hits[(size_t)j*n+i]++;
+      });
+      size_t diagonal_blocks = (n+leaf-1)/leaf;
+      for_each_diagonal_column(n, lower, leaf, 
+          [&](int r, int c, int rows, int count) {
+        calls++;
+        for (int b = 0; b < count; b++)
+          for (int i = r; i < r+rows; i++) 
+            hits[(size_t)(c+b*leaf)*n + i+b*leaf]++;
+      });
+
+      for (int j = 0; j < n; j++)
+        for (int i = 0; i < n; i++)
+          ASSERT_EQ(hits[(size_t)j*n+i], (lower ? i >= j : i <= j) ? 1 : 0);
+      ASSERT_LE(calls + diagonal_blocks, 2*(size_t)n/leaf + 2*leaf);
+    }
+  }
+}
+
+TEST_F(MatrixOp_Test, DistributedMatMulTest) {
+  const int m = 45;
+  const int k = 23;
+  const int n = 38;
+  const double alpha = 1.5;
+  const double beta = 0.5;
+  auto team = test_team();
+
+  for (bool transa : {false, true}) {
+    for (bool transb : {false, true}) {
+      TestMatrix<double> A(transa ? k : m, transa ? m : k, (transa ? k : m) + 2);
+      TestMatrix<double> B(transb ? n : k, transb ? k : n);
+      TestMatrix<double> C(m, n, m + 3);
+      auto C_init = C.host_vector;
+
+      for (bool split_rows : {false, true}) {
+        for (double share : {0.5, 1.0, 2.0}) {
+          for (int panels : {1, 2, 4}) {
+            C.host_vector = C_init;
+            C.upload();
+
+            std::unique_ptr<MatrixOp<double>> Aop = std::make_unique<NoOp<double>>(A);
+            std::unique_ptr<MatrixOp<double>> Bop = std::make_unique<NoOp<double>>(B);
+            std::unique_ptr<MatrixOp<double>> Cop = std::make_unique<NoOp<double>>(C);
+            DistributedMatrixMult<double> mult(std::move(Aop), std::move(Bop), std::move(Cop),
+                blas_op(transa), blas_op(transb), alpha, beta, 
+                *team, split_rows, share, panels);
+            ASSERT_EQ(mult.workspace_req(), 0);
+            mult.execute(handle, Workspace(), Workspace());
+            gpuAssert(gpu::DeviceSynchronize());
+            C.download();
+
+            test_gemm(A, B, C, -alpha, 1.0, transa, transb);
+            for (int j = 0; j < n; j++) {
+              for (int i = 0; i < m; i++) {
+                ASSERT_NEAR(C.host_vector[j*C.ld+i], beta*C_init[j*C.ld+i], 1e-12);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+// Operands stay on the host, tiles smaller than the problem exercise 
+// the edge tiles and the buffer rings
+TEST_F(MatrixOp_Test, OutOfCoreMatMulTest) {
+  const int m = 45;
+  const int k = 37;
+  const int n = 29;
+  const double alpha = 1.5;
+  auto staging = std::make_shared<Host_Staging>();
+
+  for (bool transa : {false, true}) {
+    for (bool transb : {false, true}) {
+      TestMatrix<double> A(transa ? k : m, transa ? m : k, (transa ? k : m) + 2);
+      TestMatrix<double> B(transb ? n : k, transb ? k : n);
+      TestMatrix<double> C(m, n, m + 3);
+      auto host = [](TestMatrix<double> &M) {
+        return Matrix<double>(Workspace(M.host_vector.data(), M.footprint()), M.m, M.n, M.ld);
+      };
+      auto C_init = C.host_vector;
+
+      for (double beta : {0.0, 0.5}) {
+        for (int depth : {2, 3}) {
+          C.host_vector = C_init;
+
+          std::unique_ptr<MatrixOp<double>> Aop = std::make_unique<NoOp<double>>(host(A));
+          std::unique_ptr<MatrixOp<double>> Bop = std::make_unique<NoOp<double>>(host(B));
+          std::unique_ptr<MatrixOp<double>> Cop = std::make_unique<NoOp<double>>(host(C));
+          OutOfCoreMatrixMult<double> mult(std::move(Aop), std::move(Bop), std::move(Cop),
+              blas_op(transa), blas_op(transb), alpha, beta, staging, 16, depth);
+          ASSERT_EQ(mult.workspace_req(), depth*2*16*16 + 2*16*16);
+
+          ManagedWorkspace scratch(mult.scratch_space_req_bytes());
+          mult.execute(handle, Workspace(), scratch);
+
+          TestMatrix<double> C_ref(m, n, m + 3);
+          C_ref.host_vector = C_init;
+          test_gemm(A, B, C_ref, alpha, beta, transa, transb);
+          for (int j = 0; j < n; j++) {
+            for (int i = 0; i < m; i++) {
+              ASSERT_NEAR(C.host_vector[j*C.ld+i], C_ref.host_vector[j*C.ld+i], 1e-12);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
 //TEST_F(MatrixOp_Test, TiledMatMulTest) {
 //  int m = 1024;
 //  int k = 1024;
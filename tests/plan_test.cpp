@@ -1,47 +1,105 @@
-//#include <algorithm>
-//#include <gtest/gtest.h>
-//#include <set>
-//#include "../src/plan.h"
-//#include "../src/planning_system.h"
-//
-//using namespace rtat;
-//
-//using Test_Op1 = Option<int, 16, 32, 64>;
-//using Test_Op2 = Option<bool, true, false>;
-//using Test_Op3 = Option<char, 'a', 'b', 'c'>;
-//
-//using Test_Ops = Options<Test_Op1, Test_Op2, Test_Op3>;
-//
-//TEST(Plan_Test, Enumerate) {
-//  std::set<Test_Ops> enum_ops;
-//  for (auto &op : Test_Ops::enumerate())
-//    enum_ops.insert(op);
-//
-//  std::set<Test_Ops> expected_ops;
-//  expected_ops.emplace(16, true , 'a');
-//  expected_ops.emplace(16, true , 'b');
-//  expected_ops.emplace(16, true , 'c');
-//  expected_ops.emplace(16, false, 'a');
-//  expected_ops.emplace(16, false, 'b');
-//  expected_ops.emplace(16, false, 'c');
-//  expected_ops.emplace(32, true , 'a');
-//  expected_ops.emplace(32, true , 'b');
-//  expected_ops.emplace(32, true , 'c');
-//  expected_ops.emplace(32, false, 'a');
-//  expected_ops.emplace(32, false, 'b');
-//  expected_ops.emplace(32, false, 'c');
-//  expected_ops.emplace(64, true , 'a');
-//  expected_ops.emplace(64, true , 'b');
-//  expected_ops.emplace(64, true , 'c');
-//  expected_ops.emplace(64, false, 'a');
-//  expected_ops.emplace(64, false, 'b');
-//  expected_ops.emplace(64, false, 'c');
-//  expected_ops.emplace(65, false, 'c');
-//
-//  std::set<Test_Ops> intersection;
-//  std::set_intersection(expected_ops.begin(), expected_ops.end(), 
-//                        enum_ops.begin(),     enum_ops.end(), 
-//                        std::inserter(intersection, intersection.begin()));
-//
-//  ASSERT_EQ(enum_ops.size(), intersection.size());
-//}
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <set>
+#include <options.h>
+
+using namespace rtat;
+
+using Test_Op1 = Option<int, 16, 32, 64>;
+using Test_Op2 = Option<bool, true, false>;
+using Test_Op3 = Option<char, 'a', 'b', 'c'>;
+
+using Test_Ops = Options<Test_Op1, Test_Op2, Test_Op3>;
+
+TEST(Plan_Test, Enumerate) {
+  std::set<Test_Ops> enum_ops;
+  for (auto &op : Test_Ops::enumerate())
+    enum_ops.insert(op);
+
+  std::set<Test_Ops> expected_ops;
+  expected_ops.emplace(16, true , 'a');
+  expected_ops.emplace(16, true , 'b');
+  expected_ops.emplace(16, true , 'c');
+  expected_ops.emplace(16, false, 'a');
+  expected_ops.emplace(16, false, 'b');
+  expected_ops.emplace(16, false, 'c');
+  expected_ops.emplace(32, true , 'a');
+  expected_ops.emplace(32, true , 'b');
+  expected_ops.emplace(32, true , 'c');
+  expected_ops.emplace(32, false, 'a');
+  expected_ops.emplace(32, false, 'b');
+  expected_ops.emplace(32, false, 'c');
+  expected_ops.emplace(64, true , 'a');
+  expected_ops.emplace(64, true , 'b');
+  expected_ops.emplace(64, true , 'c');
+  expected_ops.emplace(64, false, 'a');
+  expected_ops.emplace(64, false, 'b');
+  expected_ops.emplace(64, false, 'c');
+  expected_ops.emplace(65, false, 'c');
+
+  std::set<Test_Ops> intersection;
+  std::set_intersection(expected_ops.begin(), expected_ops.end(), 
+                        enum_ops.begin(),     enum_ops.end(), 
+                        std::inserter(intersection, intersection.begin()));
+
+  ASSERT_EQ(enum_ops.size(), intersection.size());
+  ASSERT_EQ(enum_ops.size(), 18);
+}
+
+// Indices are dense and worked out at compile time
+static_assert(Test_Ops::count == 18);
+static_assert(Test_Ops(16, true, 'a').index() == 0);
+static_assert(Test_Ops(32, false, 'b').index() == 10);
+static_assert(Test_Ops::from_index(10).get<0>() == 32);
+static_assert(!Test_Ops::from_index(10).get<1>());
+static_assert(Test_Ops::from_index(10).get<2>() == 'b');
+static_assert(Test_Ops::all()[17].index() == 17);
+static_assert(Test_Ops(32, true, 'c') < Test_Ops(64, true, 'a'));
+static_assert(!Test_Ops(65, true, 'a').valid());
+
+TEST(Plan_Test, Index) {
+  auto all = Test_Ops::enumerate();
+  for (size_t i = 0; i < all.size(); i++) {
+    EXPECT_EQ(all[i].index(), i);
+    EXPECT_EQ(Test_Ops::from_index(i).index(), i);
+  }
+  EXPECT_EQ(Test_Ops::default_opts().index(), 0);
+}
+
+TEST(Plan_Test, Encoding) {
+  Test_Ops opts(32, false, 'b');
+  std::vector<std::string> factors = {"32", "F", "b"};
+  EXPECT_EQ(opts.factors(), factors);
+  EXPECT_EQ(std::string(opts), "32,F,b");
+  EXPECT_EQ(Test_Ops::from_factors(factors).index(), opts.index());
+  EXPECT_THROW(Test_Ops::from_factors({"65", "F", "b"}), std::runtime_error);
+  EXPECT_THROW(Test_Ops::from_factors({"32", "F"}), std::runtime_error);
+}
+
+TEST(Plan_Test, Option_Table) {
+  static_assert(std::is_same_v<Option_Map<Test_Ops, int>,
+                               Option_Table<Test_Ops, int>>);
+  static_assert(std::is_same_v<Option_Map<std::string, int>,
+                               std::map<std::string, int>>);
+
+  Option_Table<Test_Ops, int> table;
+  EXPECT_TRUE(table.empty());
+  table[Test_Ops(64, false, 'c')] = 3;
+  table[Test_Ops(16, true, 'a')] = 1;
+  table[Test_Ops(32, true, 'b')]++;
+  EXPECT_EQ(table.size(), 3);
+  EXPECT_EQ(table.count(Test_Ops(32, true, 'b')), 1);
+  EXPECT_EQ(table.count(Test_Ops(32, true, 'c')), 0);
+  EXPECT_TRUE(table.find(Test_Ops(65, true, 'c')) == table.end());
+  EXPECT_THROW(table[Test_Ops(65, true, 'c')], std::out_of_range);
+
+  // Entries iterate in index order
+  std::vector<size_t> indices;
+  std::vector<int> values;
+  for (auto &[opts, value] : table) {
+    indices.push_back(opts.index());
+    values.push_back(value);
+  }
+  EXPECT_EQ(indices, std::vector<size_t>({0, 7, 17}));
+  EXPECT_EQ(values, std::vector<int>({1, 1, 3}));
+}
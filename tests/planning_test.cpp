@@ -1,6 +1,31 @@
 #include <gtest/gtest.h>
 #include <planning_system.h>
+#include <rtat.h>
 #include "common.h"
+#include <cstdlib>
+#include <new>
+
+// Heap allocations made by this thread while counting, see 
+// Converged_Dispatch_Allocations
+static thread_local bool counting_allocations = false;
+static thread_local size_t allocations = 0;
+
+void* operator new(size_t size) {
+  if (counting_allocations) allocations++;
+  if (void *ptr = std::malloc(size ? size : 1)) return ptr;
+  throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+
+template<typename F>
+size_t count_allocations(F f) {
+  allocations = 0;
+  counting_allocations = true;
+  f();
+  counting_allocations = false;
+  return allocations;
+}
 
 class Planning_Test : public BLAS_Test {};
 
@@ -22,6 +47,8 @@ struct Dummy_Params {
   int i;
   Dummy_Params(gpu::blasHandle_t handle, int i) 
     : handle(handle), i(i) {}
+  bool operator==(const Dummy_Params& o) const 
+    {return handle == o.handle && i == o.i;}
 };
 
 
@@ -58,7 +85,7 @@ struct Dummy_Opts {
 
 
 class Dummy_Executor : public Executor<Dummy_Params, Dummy_Key, Dummy_Opts> {
-  void warmup(Dummy_Params, Dummy_Opts, Stream) override {};
+  void warmup(gpu::blasHandle_t) override {};
 };
 
 
@@ -83,6 +110,180 @@ TEST_F(Planning_Test, Dummy_Planner) {
   }
 }
 
+// Plans options on their costs rather than on measured times, so tests 
+// of the search are deterministic
+template<typename Executor_Type>
+class Costed_Planner : public Planning_System<Executor_Type> {
+public:
+  using Planning_System<Executor_Type>::Planning_System;
+
+  void plan_until_converged(Dummy_Params params, int calls) {
+    for (int i = 0; i < calls; i++) {
+      auto opts = this->create_plan(params);
+      if (this->converged_plan(params)) return;
+      this->executor.get_timings(Dummy_Key(params), opts).append(opts.cost());
+    }
+  }
+};
+
+// Option 3 clearly loses
+struct Race_Opts : public Dummy_Opts {
+  using Dummy_Opts::Dummy_Opts;
+
+  static std::vector<Race_Opts> enumerate() {
+    return {Race_Opts(1), Race_Opts(2), Race_Opts(3)};
+  }
+  static Race_Opts default_opts() {return Race_Opts(1);}
+
+  float cost() const { return i == 3 ? 16 : 2; }
+
+  std::unique_ptr<MatrixOp<double>> form_operation(Dummy_Params) {
+    return std::make_unique<Dummy_Op<double>>();
+  }
+};
+
+class Race_Executor : public Executor<Dummy_Params, Dummy_Key, Race_Opts> {
+  void warmup(gpu::blasHandle_t) override {};
+};
+
+TEST_F(Planning_Test, Racing) {
+  Costed_Planner<Race_Executor> planner;
+  planner.set_racing(4);
+
+  Dummy_Params params(handle, 0);
+  planner.plan_until_converged(params, 20);
+  ASSERT_TRUE(planner.converged_plan(params));
+  EXPECT_NE(planner.converged_plan(params)->i, 3);
+
+  // The slow option is dropped after its first sample, the rest sampled
+  // until converging
+  auto stats = planner.make_statistics();
+  auto &counts = stats.get_counts().at(Dummy_Key(params));
+  EXPECT_EQ(counts.at(Race_Opts(1)), 4);
+  EXPECT_EQ(counts.at(Race_Opts(2)), 4);
+  EXPECT_EQ(counts.at(Race_Opts(3)), 1);
+  EXPECT_FLOAT_EQ(stats.total_saved(), 3*16);
+  EXPECT_EQ(stats.get_saved().at(Dummy_Key(params)), stats.total_saved());
+}
+
+// Four two-level factors, the bits of i. The first two each add 6ms when 
+// clear and the others have no effect, so the default is slow. Times are
+// given by cost rather than measured, see Costed_Planner.
+struct Factor_Opts : public Dummy_Opts {
+  using Dummy_Opts::Dummy_Opts;
+
+  static std::vector<Factor_Opts> enumerate() {
+    std::vector<Factor_Opts> ret;
+    for (int i = 0; i < 16; i++) ret.emplace_back(i);
+    return ret;
+  }
+  static Factor_Opts default_opts() {return Factor_Opts(0);}
+
+  std::vector<std::string> factors() const {
+    std::vector<std::string> ret;
+    for (int bit = 0; bit < 4; bit++)
+      ret.push_back(std::to_string((i >> bit) & 1));
+    return ret;
+  }
+
+  float cost() const { return 1 + 6*!(i & 1) + 6*!(i & 2); }
+
+  std::unique_ptr<MatrixOp<double>> form_operation(Dummy_Params) {
+    return std::make_unique<Dummy_Op<double>>();
+  }
+};
+
+class Factor_Executor 
+  : public Executor<Dummy_Params, Dummy_Key, Factor_Opts> {
+  void warmup(gpu::blasHandle_t) override {};
+};
+
+using Factor_Planner = Costed_Planner<Factor_Executor>;
+
+TEST_F(Planning_Test, Factor_Screening) {
+  Factor_Planner planner;
+  planner.set_screening(true, 0.2);
+
+  Dummy_Params params(handle, 0);
+  planner.plan_until_converged(params, 16);
+  ASSERT_TRUE(planner.converged_plan(params));
+  EXPECT_EQ(planner.converged_plan(params)->i, 3);
+
+  // The default, one option per factor, then the pair of influential 
+  // factors together
+  auto stats = planner.make_statistics();
+  EXPECT_EQ(stats.get_counts().at(Dummy_Key(params)).size(), 6);
+}
+
+// Without the default, factors are screened from the best option timed
+TEST_F(Planning_Test, Factor_Screening_Filtered_Default) {
+  Factor_Planner planner(Option_Filter<Dummy_Key, Factor_Opts>(
+      [](std::pair<Factor_Opts, Dummy_Key> p) { return p.first.i != 0; }));
+  planner.set_screening(true, 0.2);
+
+  Dummy_Params params(handle, 0);
+  planner.plan_until_converged(params, 16);
+  ASSERT_TRUE(planner.converged_plan(params));
+  EXPECT_EQ(planner.converged_plan(params)->i, 3);
+
+  // The first option and its first neighbour, which is faster, then the
+  // neighbours of that, which leave no promising move untimed
+  auto stats = planner.make_statistics();
+  auto &counts = stats.get_counts().at(Dummy_Key(params));
+  EXPECT_EQ(counts.count(Factor_Opts(0)), 0);
+  EXPECT_EQ(counts.size(), 5);
+}
+
+// Options from the product template, planned with array tables
+struct Product_Opts 
+  : public Options<Option<int, 1, 2, 3>, Option<bool, false, true>> {
+  using Options::Options;
+  Product_Opts(Options opts) : Options(opts) {}
+
+  std::unique_ptr<MatrixOp<double>> form_operation(Dummy_Params) {
+    return std::make_unique<Dummy_Op<double>>();
+  }
+};
+
+class Product_Executor 
+  : public Executor<Dummy_Params, Dummy_Key, Product_Opts> {
+  void warmup(gpu::blasHandle_t) override {};
+};
+
+TEST_F(Planning_Test, Product_Options) {
+  static_assert(std::is_same_v<Option_Map<Product_Opts, Timer_Bank>,
+                               Option_Table<Product_Opts, Timer_Bank>>);
+  static_assert(std::is_same_v<Option_Map<GEMM_Options_Pad, Timer_Bank>,
+                               Option_Table<GEMM_Options_Pad, Timer_Bank>>);
+
+  Planning_System<Product_Executor> planner;
+  Dummy_Params params(handle, 0);
+  size_t converged = Product_Opts::count;
+  for (size_t i = 0; i < converged + 1; i++)
+    planner.execute(params, planner.create_plan(params), Workspace(), s);
+  ASSERT_TRUE(planner.converged_plan(params));
+
+  auto stats = planner.make_statistics();
+  EXPECT_EQ(stats.get_counts().at(Dummy_Key(params)).size(), converged);
+  auto plans = nlohmann::json::array();
+  for (auto &[opts, count] : stats.get_counts().at(Dummy_Key(params)))
+    plans.push_back(to_json(opts));
+  EXPECT_EQ(from_json<Product_Opts>(plans[3]).index(), 3);
+}
+
+// In place TRSM plans are only explored for a square B
+TEST_F(Planning_Test, Options_Applying) {
+  Option_Filter<TRSM_Key, TRSM_Options> filter;
+  auto in_place_count = [&](int m, int n) {
+    auto opt_set = filter.apply(TRSM_Key(gpu::BLAS_SIDE_LEFT, 
+        gpu::BLAS_FILL_MODE_LOWER, gpu::BLAS_OP_N, gpu::BLAS_DIAG_UNIT, m, n));
+    return std::count_if(opt_set.begin(), opt_set.end(), 
+                         [](auto &opts) { return bool(opts.in_place); });
+  };
+  EXPECT_GT(in_place_count(5, 5), 0);
+  EXPECT_EQ(in_place_count(5, 7), 0);
+}
+
 TEST_F(Planning_Test, GEMM_Correctness) {
   GEMM_Planner planner;
 
@@ -113,6 +314,427 @@ TEST_F(Planning_Test, GEMM_Correctness) {
   }
 }
 
+class Replay_Planner : public GEMM_Planner {
+public:
+  size_t captures() const { return executor.get_captures(); }
+};
+
+TEST_F(Planning_Test, Graph_Replay) {
+  Replay_Planner planner;
+
+  int m = 23;
+  int n = 16;
+  int k = 35;
+
+  TestMatrix<double> A(k,m,k);
+  TestMatrix<double> B(k,n,k);
+  TestMatrix<double> C(m,n,m);
+  TestMatrix<double> D(m,n,m);
+
+  double alpha = 1.0;
+  GEMM_Inputs<double> into_C(handle, gpu::BLAS_OP_T, gpu::BLAS_OP_N, A, B, C, alpha, 0.0);
+  GEMM_Inputs<double> into_D(handle, gpu::BLAS_OP_T, gpu::BLAS_OP_N, A, B, D, alpha, 0.0);
+
+  size_t ws = 0;
+  for (auto &plan : GEMM_Options::enumerate())
+    ws = std::max(ws, planner.calculate_workspace(into_C, plan));
+  ManagedWorkspace space(ws);
+
+  auto check = [&](GEMM_Inputs<double> inputs, TestMatrix<double> &out) {
+    planner.execute(inputs, planner.create_plan(inputs), space, s);
+    out.download();
+    test_gemm(A, B, out, -alpha, 1.0, true, false);
+    EXPECT_TRUE(out.is_zero());
+  };
+
+  // Replay is off unless enabled
+  for (size_t i = 0; i < 2*GEMM_Options::enumerate().size(); i++)
+    check(into_C, C);
+  EXPECT_EQ(planner.captures(), 0);
+
+  // The graph is captured once a call repeats, and replayed with new 
+  // data in place
+  planner.set_graph_replay(true);
+  check(into_C, C);
+  EXPECT_EQ(planner.captures(), 0);
+  check(into_C, C);
+  EXPECT_EQ(planner.captures(), 1);
+  A.randomize_host();
+  A.upload();
+  check(into_C, C);
+
+  // Alternating outputs run directly rather than recapturing
+  for (int i = 0; i < 3; i++) {
+    check(into_D, D);
+    check(into_C, C);
+  }
+  EXPECT_EQ(planner.captures(), 1);
+  check(into_D, D);
+  check(into_D, D);
+  EXPECT_EQ(planner.captures(), 2);
+
+  planner.set_graph_replay(false);
+  check(into_C, C);
+}
+
+class Forming_Planner : public GEMM_Planner {
+public:
+  size_t formed() const { return executor.get_formed_count(); }
+};
+
+// Calls repeating the last call's operands and plan reuse its operation
+TEST_F(Planning_Test, Formed_Operations) {
+  Forming_Planner planner;
+
+  int m = 23;
+  int n = 16;
+  int k = 35;
+
+  TestMatrix<double> A(k,m,k);
+  TestMatrix<double> B(k,n,k);
+  TestMatrix<double> C(m,n,m);
+  TestMatrix<double> D(m,n,m);
+
+  double alpha = 1.0;
+  GEMM_Inputs<double> into_C(handle, gpu::BLAS_OP_T, gpu::BLAS_OP_N, A, B, C, alpha, 0.0);
+  GEMM_Inputs<double> into_D(handle, gpu::BLAS_OP_T, gpu::BLAS_OP_N, A, B, D, alpha, 0.0);
+
+  size_t ws = 0;
+  for (auto &plan : GEMM_Options::enumerate())
+    ws = std::max(ws, planner.calculate_workspace(into_C, plan));
+  ManagedWorkspace space(ws);
+
+  auto check = [&](GEMM_Inputs<double> inputs, TestMatrix<double> &out) {
+    planner.execute(inputs, planner.create_plan(inputs), space, s);
+    out.download();
+    test_gemm(A, B, out, -alpha, 1.0, true, false);
+    EXPECT_TRUE(out.is_zero());
+  };
+  for (size_t i = 0; i < GEMM_Options::enumerate().size() + 1; i++)
+    check(into_C, C);
+  ASSERT_TRUE(planner.converged_plan(into_C));
+  size_t formed = planner.formed();
+
+  A.randomize_host();
+  A.upload();
+  for (int i = 0; i < 3; i++) check(into_C, C);
+  EXPECT_EQ(planner.formed(), formed);
+
+  check(into_D, D);
+  check(into_D, D);
+  EXPECT_EQ(planner.formed(), formed + 1);
+}
+
+// Dispatching a call on a converged plan allocates no more than timing 
+// the same library call directly, which the backend may allocate for
+TEST_F(Planning_Test, Converged_Dispatch_Allocations) {
+  GEMM_Planner planner;
+
+  int m = 23;
+  int n = 16;
+  int k = 35;
+
+  TestMatrix<double> A(m,k,m);
+  TestMatrix<double> B(k,n,k);
+  TestMatrix<double> C(m,n,m);
+  GEMM_Inputs<double> inputs(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, 
+                             A, B, C, 1.0, 0.0);
+
+  nlohmann::json plan;
+  plan["key"] = to_json(GEMM_Key(inputs));
+  plan["option"] = to_json(GEMM_Options());
+  planner.load_plans(nlohmann::json::array({plan}));
+  ManagedWorkspace space(planner.calculate_workspace(inputs, GEMM_Options()));
+
+  // Past the timing log's limit, which keeps the first calls' timings
+  const int calls = 64;
+  for (int i = 0; i < 200; i++)
+    planner.execute(inputs, planner.create_plan(inputs), space, s);
+  gpuAssert(gpu::StreamSynchronize(s));
+
+  size_t dispatched = count_allocations([&]() {
+    for (int i = 0; i < calls; i++)
+      planner.execute(inputs, planner.create_plan(inputs), space, s);
+  });
+  gpuAssert(gpu::StreamSynchronize(s));
+
+  std::vector<Device_Timer> timers;
+  timers.reserve(calls);
+  size_t direct = count_allocations([&]() {
+    for (int i = 0; i < calls; i++) {
+      timers.emplace_back([&](const Stream &) {
+        gpuTgemm<double>(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, 
+                         A, B, C, 1.0, 0.0);
+      }, s);
+      // Released like the planner's timings past the log's limit
+      timers.pop_back();
+    }
+  });
+  gpuAssert(gpu::StreamSynchronize(s));
+
+  EXPECT_LE(dispatched, direct);
+}
+
+TEST_F(Planning_Test, Operand_Cache) {
+  GEMM_Planner planner;
+  auto cache = std::make_shared<Operand_Cache>(1 << 20);
+  planner.set_operand_cache(cache);
+
+  int m = 23;
+  int n = 16;
+  int k = 35;
+
+  TestMatrix<double> A(k,m,k);
+  TestMatrix<double> B(k,n,k);
+  TestMatrix<double> C(m,n,m);
+
+  double alpha = 1.0;
+  auto inputs = [&](uint64_t generation) {
+    return GEMM_Inputs<double>(handle, gpu::BLAS_OP_T, gpu::BLAS_OP_N, 
+        A.matrix().with_generation(generation), B, C, alpha, 0.0);
+  };
+
+  size_t ws = 0;
+  for (auto &plan : GEMM_Options::enumerate())
+    ws = std::max(ws, planner.calculate_workspace(inputs(0), plan));
+  ManagedWorkspace space(ws);
+
+  auto check = [&](uint64_t generation) {
+    planner.execute(inputs(generation), planner.create_plan(inputs(generation)), 
+                    space, s);
+    C.download();
+    test_gemm(A, B, C, -alpha, 1.0, true, false);
+    EXPECT_TRUE(C.is_zero());
+  };
+  for (size_t i = 0; i < 3*GEMM_Options::enumerate().size(); i++)
+    check(0);
+  EXPECT_GT(cache->hits(), 0);
+  EXPECT_LE(cache->bytes(), size_t(1 << 20));
+
+  // New data under a new generation is transformed again
+  A.randomize_host();
+  A.upload();
+  check(1);
+  check(1);
+
+  Operand_Cache small(2*sizeof(double)*m*k);
+  Operand_Key key{0, A.matrix().ptr(), size_t(k), size_t(m), size_t(k), 0, 0, 1, 0};
+  EXPECT_TRUE(small.insert(key, sizeof(double)*m*k));
+  key.generation = 1;
+  EXPECT_TRUE(small.insert(key, sizeof(double)*m*k));
+  key.generation = 2;
+  EXPECT_TRUE(small.insert(key, sizeof(double)*m*k));
+  EXPECT_EQ(small.size(), 2);
+  key.generation = 0;
+  EXPECT_FALSE(small.find(key));
+  key.generation = 2;
+  EXPECT_TRUE(small.find(key));
+  EXPECT_FALSE(small.insert(key, 3*sizeof(double)*m*k));
+}
+
+// C^T = B^T*A^T adopts the plan C = A*B converged on when sharing, and 
+// each keeps its own timings
+TEST_F(Planning_Test, Mirrored_Keys) {
+  GEMM_Planner planner, unshared;
+  planner.set_share_mirrors(true);
+
+  int m = 19;
+  int n = 27;
+  int k = 12;
+
+  TestMatrix<double> A(m,k,m);
+  TestMatrix<double> B(k,n,k);
+  TestMatrix<double> C(m,n,m);
+  TestMatrix<double> D(n,m,n);
+
+  GEMM_Inputs<double> forward(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, 
+                              A, B, C, 1.0, 0.0);
+  GEMM_Inputs<double> mirrored(handle, gpu::BLAS_OP_T, gpu::BLAS_OP_T, 
+                               B, A, D, 1.0, 0.0);
+  GEMM_Key key(forward);
+  EXPECT_EQ(std::string(key.mirror()), std::string(GEMM_Key(mirrored)));
+  EXPECT_EQ(std::string(key.mirror().mirror()), std::string(key));
+  EXPECT_NE(key.canonical(), key.mirror().canonical());
+
+  size_t ws = 0;
+  for (auto &plan : GEMM_Options::enumerate())
+    ws = std::max({ws, planner.calculate_workspace(forward, plan),
+                       planner.calculate_workspace(mirrored, plan)});
+  ManagedWorkspace space(ws);
+
+  size_t converged = GEMM_Options::enumerate().size();
+  for (size_t i = 0; i < converged + 1; i++) {
+    planner.execute(forward, planner.create_plan(forward), space, s);
+    unshared.execute(forward, unshared.create_plan(forward), space, s);
+  }
+  ASSERT_TRUE(planner.converged_plan(forward));
+  EXPECT_FALSE(planner.converged_plan(mirrored));
+  planner.execute(mirrored, planner.create_plan(mirrored), space, s);
+  ASSERT_TRUE(planner.converged_plan(mirrored));
+  EXPECT_EQ(std::string(planner.converged_plan(forward)->mirror()), 
+            std::string(*planner.converged_plan(mirrored)));
+
+  // Sharing is opt-in
+  unshared.create_plan(mirrored);
+  EXPECT_FALSE(unshared.converged_plan(mirrored));
+
+  // The mirrored call is timed under its own key, not blended in
+  auto stats = planner.make_statistics();
+  EXPECT_EQ(stats.get_counts().at(key).size(), converged);
+  EXPECT_EQ(stats.get_counts().at(GEMM_Key(mirrored)).size(), 1);
+
+  C.download();
+  D.download();
+  test_gemm(A, B, C, -1.0, 1.0, false, false);
+  EXPECT_TRUE(C.is_zero());
+  test_gemm(B, A, D, -1.0, 1.0, true, true);
+  EXPECT_TRUE(D.is_zero());
+
+  EXPECT_EQ(std::string(TRSM_Key(gpu::BLAS_SIDE_LEFT, gpu::BLAS_FILL_MODE_LOWER,
+      gpu::BLAS_OP_N, gpu::BLAS_DIAG_UNIT, 5, 7).mirror()), 
+      std::string(TRSM_Key(gpu::BLAS_SIDE_RIGHT, gpu::BLAS_FILL_MODE_LOWER,
+      gpu::BLAS_OP_T, gpu::BLAS_DIAG_UNIT, 7, 5)));
+  SYRK_Key syrk(gpu::BLAS_FILL_MODE_LOWER, gpu::BLAS_OP_N, 5, 7);
+  EXPECT_EQ(std::string(syrk.mirror().mirror()), std::string(syrk));
+  EXPECT_NE(syrk.canonical(), syrk.mirror().canonical());
+}
+
+TEST_F(Planning_Test, Exploration_Budget) {
+  GEMM_Planner planner;
+  auto budget = std::make_shared<Exploration_Budget<GEMM_Key>>(0.5);
+  planner.set_exploration_budget(budget);
+
+  int m = 21;
+  int n = 14;
+  int k = 9;
+
+  TestMatrix<double> A(m,k,m);
+  TestMatrix<double> B(k,n,k);
+  TestMatrix<double> C(m,n,m);
+  GEMM_Inputs<double> inputs(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N,
+                             A, B, C, 1.0, 0.0);
+  auto key = planner.canonical(GEMM_Key(inputs));
+
+  size_t ws = 0;
+  for (auto &plan : GEMM_Options::enumerate())
+    ws = std::max(ws, planner.calculate_workspace(inputs, plan));
+  ManagedWorkspace space(ws);
+
+  // A rarely called key runs on the default plan
+  for (int i = 0; i < 10; i++)
+    planner.execute(inputs, planner.create_plan(inputs), space, s);
+  EXPECT_EQ(budget->call_count(key), 10);
+  EXPECT_EQ(budget->trial_count(), 0);
+  EXPECT_EQ(planner.make_statistics().get_counts().at(key).size(), 1);
+
+  // A frequent one is explored, within the share of wall time. With 
+  // the default plan timed, the rest cost twice a call each, and are 
+  // expected to save a quarter of the calls' time.
+  size_t untried = GEMM_Options::enumerate().size() - 1;
+  for (int i = 0; i < 10000 && !planner.converged_plan(inputs); i++)
+    planner.execute(inputs, planner.create_plan(inputs), space, s);
+  ASSERT_TRUE(planner.converged_plan(inputs));
+  EXPECT_GE(budget->call_count(key), 8*untried);
+  EXPECT_LE(budget->explored(), 0.5*budget->elapsed());
+
+  C.download();
+  test_gemm(A, B, C, -1.0, 1.0, false, false);
+  EXPECT_TRUE(C.is_zero());
+}
+
+TEST_F(Planning_Test, Key_Classes) {
+  int m = 32;
+  int n = 16;
+  int k = 24;
+
+  TestMatrix<double> A(m,k,512);
+  TestMatrix<double> B(k,n,k);
+  TestMatrix<double> C(m,n,m);
+  TestMatrix<double> C_odd(m,n,m+1);
+
+  GEMM_Key key(GEMM_Inputs<double>(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N,
+                                   A, B, C, 1.0, 0.0));
+  EXPECT_EQ(std::string(key.lda), "P");
+  EXPECT_EQ(std::string(key.ldb), "U");
+  EXPECT_EQ(std::string(key.ldc), "A");
+  EXPECT_EQ(std::string(key.beta), "0");
+  EXPECT_EQ(std::string(key.mirror().lda), "U");
+  EXPECT_EQ(std::string(key.mirror().ldb), "P");
+
+  // Same shape, planned apart
+  GEMM_Key odd(GEMM_Inputs<double>(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N,
+                                   A, B, C_odd, 1.0, 0.0));
+  GEMM_Key accumulate(GEMM_Inputs<double>(handle, gpu::BLAS_OP_N, 
+                      gpu::BLAS_OP_N, A, B, C, 1.0, 1.0));
+  EXPECT_EQ(std::string(odd.ldc), "U");
+  EXPECT_EQ(std::string(accumulate.beta), "1");
+  EXPECT_TRUE(key < odd || odd < key);
+  EXPECT_TRUE(key < accumulate || accumulate < key);
+
+  EXPECT_EQ(std::string(beta_class(0.5)), "X");
+  SYRK_Key syrk(SYRK_Inputs<double>(handle, gpu::BLAS_FILL_MODE_LOWER,
+                gpu::BLAS_OP_N, A, C, 1.0, 2.0));
+  EXPECT_EQ(std::string(syrk.beta), "X");
+  EXPECT_EQ(std::string(syrk.mirror().lda), "P");
+}
+
+TEST_F(Planning_Test, Bucketed_Keys) {
+  Dimension_Buckets buckets;
+  EXPECT_EQ(buckets.bucket(10), 10);
+  EXPECT_EQ(buckets.bucket(97), buckets.bucket(99));
+  EXPECT_NE(buckets.bucket(96), buckets.bucket(97));
+  EXPECT_EQ(buckets.range(99), std::make_pair(80, 104));
+  buckets.refine({97, 99});
+  EXPECT_EQ(buckets.refinements(), 1);
+  EXPECT_EQ(buckets.range(99), std::make_pair(96, 104));
+
+  GEMM_Planner planner;
+  planner.set_bucketing(std::make_shared<Dimension_Buckets>(), 0.0, 1);
+
+  int n = 16;
+  int k = 12;
+  std::vector<std::unique_ptr<TestMatrix<double>>> As, Cs;
+  TestMatrix<double> B(k,n,k);
+  std::vector<GEMM_Inputs<double>> inputs;
+  for (int m : {97, 99, 96}) {
+    As.push_back(std::make_unique<TestMatrix<double>>(m,k,m));
+    Cs.push_back(std::make_unique<TestMatrix<double>>(m,n,m));
+    inputs.emplace_back(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N,
+                        *As.back(), B, *Cs.back(), 1.0, 0.0);
+  }
+
+  size_t ws = 0;
+  for (auto &plan : GEMM_Options::enumerate())
+    for (auto &in : inputs)
+      ws = std::max(ws, planner.calculate_workspace(in, plan));
+  ManagedWorkspace space(ws);
+
+  // The unaligned sizes share a bucket, and converge together
+  size_t converged = GEMM_Options::enumerate().size();
+  for (size_t i = 0; i < converged + 1; i++)
+    planner.execute(inputs[i%2], planner.create_plan(inputs[i%2]), space, s);
+  ASSERT_TRUE(planner.converged_plan(inputs[0]));
+  ASSERT_TRUE(planner.converged_plan(inputs[1]));
+  planner.execute(inputs[2], planner.create_plan(inputs[2]), space, s);
+
+  auto stats = planner.make_statistics();
+  EXPECT_EQ(stats.get_counts().size(), 2);
+
+  // Both members time the plan, then the next lookup splits the bucket
+  auto plan = *planner.converged_plan(inputs[0]);
+  planner.execute(inputs[0], plan, space, s);
+  planner.execute(inputs[1], plan, space, s);
+  planner.create_plan(inputs[0]);
+  EXPECT_FALSE(planner.converged_plan(inputs[0]));
+  EXPECT_FALSE(planner.converged_plan(inputs[1]));
+
+  for (size_t i = 0; i < inputs.size(); i++) {
+    Cs[i]->download();
+    test_gemm(*As[i], B, *Cs[i], -1.0, 1.0, false, false);
+    EXPECT_TRUE(Cs[i]->is_zero());
+  }
+}
+
 TEST_F(Planning_Test, Hello) {
   // This isn't really testing anything?
   GEMM_Planner planner;
@@ -145,6 +767,383 @@ TEST_F(Planning_Test, Hello) {
   }
 }
 
+// The one-call API plans, leases workspace and executes in one step, and 
+// stops allocating once the problem has converged
+TEST_F(Planning_Test, One_Call_API) {
+  rtat::rtat tuner;
+
+  int m = 57;
+  int n = 33;
+  int k = 41;
+
+  TestMatrix<double> A(k,m,k);
+  TestMatrix<double> B(k,n,k);
+  TestMatrix<double> C(m,n,m);
+
+  GEMM_Inputs<double> inputs(handle, gpu::BLAS_OP_T, gpu::BLAS_OP_N, A, B, C, 1.0, 0.0);
+
+  size_t converged = GEMM_Options::enumerate().size();
+  size_t arena_bytes = 0;
+  for (size_t i=0; i<converged+5; i++) {
+    tuner.gemm(inputs);
+    if (i == converged) arena_bytes = tuner.arena_bytes();
+  }
+  EXPECT_EQ(tuner.arena_bytes(), arena_bytes);
+
+  C.download();
+  test_gemm(A, B, C, -1.0, 1.0, true, false);
+  EXPECT_TRUE(C.is_zero());
+
+  auto stats = tuner.gemm_planner<double>().make_statistics();
+  EXPECT_EQ(stats.get_counts().at(GEMM_Key(inputs)).size(), converged);
+}
+
+// C = A*B on a plan that computes C transposed is left transposed, then 
+// read through the transpose by D = C*E and accumulated into in place
+TEST_F(Planning_Test, Lazy_Layout) {
+  rtat::rtat tuner;
+
+  int m = 29;
+  int n = 18;
+  int k = 37;
+  int p = 22;
+
+  TestMatrix<double> A(m,k,m);
+  TestMatrix<double> B(k,n,k);
+  TestMatrix<double> C(m,n,m);
+  TestMatrix<double> E(n,p,n);
+  TestMatrix<double> D(m,p,m);
+
+  nlohmann::json plan;
+  plan["key"] = to_json(GEMM_Key(GEMM_Inputs<double>(
+      handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, A, B, C, 1.0, 0.0)));
+  plan["option"] = to_json(
+      GEMM_Options(BLAS_Op::NOTRANS, BLAS_Op::NOTRANS, BLAS_Op::TRANS));
+  tuner.gemm_planner<double>().load_plans(nlohmann::json::array({plan}));
+
+  Lazy_Matrix<double> lazy_A(A), lazy_B(B), lazy_C(C), lazy_E(E), lazy_D(D);
+  tuner.gemm(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, 
+             lazy_A, lazy_B, lazy_C, 1.0, 0.0);
+  EXPECT_TRUE(lazy_C.transposed());
+
+  tuner.gemm(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, 
+             lazy_C, lazy_E, lazy_D, 1.0, 0.0);
+  EXPECT_FALSE(lazy_D.transposed());
+
+  tuner.gemm(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, 
+             lazy_A, lazy_B, lazy_C, 1.0, 1.0);
+  EXPECT_TRUE(lazy_C.transposed());
+
+  lazy_C.read(handle);
+  EXPECT_FALSE(lazy_C.transposed());
+  gpuAssert(gpu::StreamSynchronize(s));
+
+  C.download();
+  D.download();
+  test_gemm(A, B, C, -2.0, 1.0, false, false);
+  EXPECT_TRUE(C.is_zero());
+
+  // D was formed from the first product alone
+  test_gemm(A, B, C, 1.0, 1.0, false, false);
+  test_gemm(C, E, D, -1.0, 1.0, false, false);
+  EXPECT_TRUE(D.is_zero());
+}
+
+// C held transposed and overwritten by a product that cannot be computed
+// into its transpose is dropped, not transposed back first
+TEST_F(Planning_Test, Lazy_Layout_Overwrite) {
+  rtat::rtat tuner;
+
+  int m = 29;
+  int n = 18;
+  int k = 37;
+
+  TestMatrix<double> A(m,k,m);
+  TestMatrix<double> At(k,m,k);
+  TestMatrix<double> B(k,n,k);
+  TestMatrix<double> C(m,n,m);
+
+  auto plan_for = [&](BLAS_Operation transa, TestMatrix<double> &X, 
+                      BLAS_Op transc) {
+    nlohmann::json plan;
+    plan["key"] = to_json(GEMM_Key(GEMM_Inputs<double>(
+        handle, transa, gpu::BLAS_OP_N, X, B, C, 1.0, 0.0)));
+    plan["option"] = to_json(
+        GEMM_Options(BLAS_Op::NOTRANS, BLAS_Op::NOTRANS, transc));
+    return plan;
+  };
+  tuner.gemm_planner<double>().load_plans(nlohmann::json::array({
+      plan_for(gpu::BLAS_OP_N, A, BLAS_Op::TRANS),
+      plan_for(gpu::BLAS_OP_C, At, BLAS_Op::NOTRANS)}));
+
+  Lazy_Matrix<double> lazy_A(A), lazy_At(At), lazy_B(B), lazy_C(C);
+  tuner.gemm(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, 
+             lazy_A, lazy_B, lazy_C, 1.0, 0.0);
+  EXPECT_TRUE(lazy_C.transposed());
+
+  // op C on a transpose is not a BLAS operation, so C is computed in place
+  tuner.gemm(handle, gpu::BLAS_OP_C, gpu::BLAS_OP_N, 
+             lazy_At, lazy_B, lazy_C, 1.0, 0.0);
+  EXPECT_FALSE(lazy_C.transposed());
+  EXPECT_EQ(lazy_C.get_transposes(), 0);
+  gpuAssert(gpu::StreamSynchronize(s));
+
+  C.download();
+  test_gemm(At, B, C, -1.0, 1.0, true, false);
+  EXPECT_TRUE(C.is_zero());
+}
+
+// Independent GEMMs of one shape are batched. D = C[0]*E waits for C[0],
+// and C[0] is only overwritten once D has read it.
+TEST_F(Planning_Test, Deferred_Calls) {
+  rtat::rtat tuner;
+  tuner.set_deferred(true);
+
+  int m = 21;
+  int n = 14;
+  int k = 30;
+  int p = 9;
+
+  TestMatrix<double> A(m,k,m);
+  TestMatrix<double> B(k,n,k);
+  TestMatrix<double> E(n,p,n);
+  TestMatrix<double> D(m,p,m);
+  std::vector<std::unique_ptr<TestMatrix<double>>> C;
+  for (int i = 0; i < 4; i++)
+    C.push_back(std::make_unique<TestMatrix<double>>(m,n,m));
+
+  for (auto &Ci : C)
+    tuner.gemm(GEMM_Inputs<double>(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, 
+                                   A, B, *Ci, 1.0, 0.0));
+  tuner.gemm(GEMM_Inputs<double>(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, 
+                                 *C[0], E, D, 1.0, 0.0));
+  tuner.gemm(GEMM_Inputs<double>(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, 
+                                 A, B, *C[0], 2.0, 0.0));
+  EXPECT_EQ(tuner.call_queue()->size(), 6);
+
+  tuner.flush();
+  gpuAssert(gpu::StreamSynchronize(s));
+  EXPECT_EQ(tuner.call_queue()->size(), 0);
+  EXPECT_EQ(tuner.call_queue()->batched(), 4);
+  EXPECT_EQ(tuner.call_queue()->launched(), 3);
+
+  for (auto &Ci : C) Ci->download();
+  D.download();
+
+  TestMatrix<double> AB(m,n,m);
+  test_gemm(A, B, AB, 1.0, 0.0, false, false);
+  test_gemm(AB, E, D, -1.0, 1.0, false, false);
+  EXPECT_TRUE(D.is_zero());
+
+  test_gemm(A, B, *C[0], -2.0, 1.0, false, false);
+  EXPECT_TRUE(C[0]->is_zero());
+  for (int i = 1; i < 4; i++) {
+    test_gemm(A, B, *C[i], -1.0, 1.0, false, false);
+    EXPECT_TRUE(C[i]->is_zero());
+  }
+}
+
+// Calls run on the device they were recorded on. Recording on another 
+// device flushes the calls queued so far.
+TEST_F(Planning_Test, Deferred_Devices) {
+#if defined(_RTAT_HOST)
+  setenv("RTAT_HOST_DEVICES", "3", 1);
+#endif
+  int count = 0;
+  gpuAssert(gpu::GetDeviceCount(&count));
+  if (count < 2) GTEST_SKIP() << "Needs two devices";
+
+  rtat::rtat tuner;
+  tuner.set_deferred(true);
+
+  int m = 21;
+  int n = 14;
+  int k = 30;
+
+  TestMatrix<double> A(m,k,m);
+  TestMatrix<double> B(k,n,k);
+  TestMatrix<double> C(m,n,m);
+  TestMatrix<double> D(m,n,m);
+  GEMM_Key key(GEMM_Inputs<double>(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N,
+                                   A, B, C, 1.0, 0.0));
+
+  tuner.gemm(GEMM_Inputs<double>(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, 
+                                 A, B, C, 1.0, 0.0));
+  gpuAssert(gpu::SetDevice(1));
+  tuner.gemm(GEMM_Inputs<double>(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, 
+                                 A, B, D, 2.0, 0.0));
+  EXPECT_EQ(tuner.call_queue()->size(), 1);
+  gpuAssert(gpu::SetDevice(0));
+  tuner.flush();
+  gpuAssert(gpu::StreamSynchronize(s));
+
+  int device = -1;
+  gpuAssert(gpu::GetDevice(&device));
+  EXPECT_EQ(device, 0);
+
+  // Each call was planned by the planner of its own device
+  for (int d : {0, 1}) {
+    gpuAssert(gpu::SetDevice(d));
+    auto stats = tuner.gemm_planner<double>().make_statistics();
+    EXPECT_EQ(stats.get_counts().at(key).size(), 1);
+  }
+  gpuAssert(gpu::SetDevice(0));
+
+  C.download();
+  D.download();
+  test_gemm(A, B, C, -1.0, 1.0, false, false);
+  EXPECT_TRUE(C.is_zero());
+  test_gemm(A, B, D, -2.0, 1.0, false, false);
+  EXPECT_TRUE(D.is_zero());
+}
+
+// A simulated node. Devices 0 and 1 are the same model, device 2 differs.
+// Warmup runs in the background. A call made before it finishes waits 
+// for it rather than warming up a second time.
+TEST_F(Planning_Test, Initialize) {
+  rtat::rtat tuner;
+  auto ready = tuner.initialize({"dgemm", "ztrsm", "cherk"});
+  EXPECT_EQ(ready.size(), 3);
+
+  int m = 19;
+  int n = 27;
+  int k = 8;
+  TestMatrix<double> A(m,k,m);
+  TestMatrix<double> B(k,n,k);
+  TestMatrix<double> C(m,n,m);
+  tuner.gemm(GEMM_Inputs<double>(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, A, B, C, 1.0, 0.0));
+  C.download();
+  test_gemm(A, B, C, -1.0, 1.0, false, false);
+  EXPECT_TRUE(C.is_zero());
+
+  for (auto &[routine, startup] : ready)
+    EXPECT_GE(startup.get(), 0.0);
+  EXPECT_TRUE(tuner.gemm_planner<double>().is_warm());
+  EXPECT_TRUE(tuner.trsm_planner<std::complex<double>>().is_warm());
+  EXPECT_TRUE(tuner.herk_planner<std::complex<float>>().is_warm());
+  EXPECT_FALSE(tuner.gemm_planner<float>().is_warm());
+
+  EXPECT_THROW(tuner.initialize({"dherk"}), std::runtime_error);
+}
+
+class Mock_Devices : public Device_Layer {
+public:
+  int device = 0;
+  int current() const override { return device; }
+  int count() const override { return 3; }
+  std::string model(int d) const override { return d < 2 ? "A" : "B"; }
+};
+
+TEST_F(Planning_Test, Per_Device_Planners) {
+  TestMatrix<double> A(30,20,30);
+  TestMatrix<double> B(20,10,20);
+  TestMatrix<double> C(30,10,30);
+  GEMM_Inputs<double> inputs(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, A, B, C, 1.0, 0.0);
+  GEMM_Key key(inputs);
+
+  for (bool share : {false, true}) {
+    auto devices = std::make_shared<Mock_Devices>();
+    rtat::rtat tuner(devices, share);
+
+    size_t converged = GEMM_Options::enumerate().size();
+    for (size_t i=0; i<converged; i++) tuner.gemm(inputs);
+
+    auto counts = [&](int device) {
+      devices->device = device;
+      auto stats = tuner.gemm_planner<double>().make_statistics();
+      return stats.get_counts().count(key) ? stats.get_counts().at(key).size() : 0;
+    };
+
+    EXPECT_EQ(counts(0), converged);
+    EXPECT_EQ(counts(1), share ? converged : 0);
+    EXPECT_EQ(counts(2), 0);
+  }
+}
+
+// The split across devices is tuned like any other option
+TEST_F(Planning_Test, Distributed_GEMM) {
+  Distributed_DGEMM_Planner planner(test_team());
+  ASSERT_EQ(planner.get_team().size(), 3);
+
+  TestMatrix<double> A(64,48,64);
+  TestMatrix<double> B(48,80,48);
+  TestMatrix<double> C(64,80,64);
+  GEMM_Inputs<double> inputs(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, A, B, C, 1.0, 0.0);
+
+  size_t converged = GEMM_Options_Distributed::enumerate().size();
+  for (size_t i=0; i<converged+2; i++) {
+    auto plan = planner.create_plan(inputs);
+    ASSERT_EQ(planner.calculate_workspace(inputs, plan), 0);
+    planner.execute(inputs, plan, Workspace(), s);
+  }
+  gpuAssert(gpu::DeviceSynchronize());
+
+  C.download();
+  test_gemm(A, B, C, -1.0, 1.0, false, false);
+  EXPECT_TRUE(C.is_zero());
+
+  auto stats = planner.make_statistics();
+  EXPECT_EQ(stats.get_counts().at(GEMM_Key(inputs)).size(), converged);
+}
+
+// Out-of-core plans take host operands and only device workspace
+TEST_F(Planning_Test, Out_Of_Core_GEMM) {
+  rtat::rtat tuner;
+
+  int m = 70, k = 50, n = 60;
+  std::vector<double> A(m*k), B(k*n), C(m*n, 0.0);
+  for (int i = 0; i < m*k; i++) A[i] = (i % 7) - 3;
+  for (int i = 0; i < k*n; i++) B[i] = (i % 5) - 2;
+
+  GEMM_Inputs<double> inputs(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, 
+                             Matrix<double>(Workspace(A.data(), A.size()), m, k, m),
+                             Matrix<double>(Workspace(B.data(), B.size()), k, n, k),
+                             Matrix<double>(Workspace(C.data(), C.size()), m, n, m),
+                             1.0, 1.0);
+
+  size_t converged = GEMM_Options_Out_Of_Core::enumerate().size();
+  for (size_t i=0; i<converged+2; i++) tuner.out_of_core_gemm(inputs);
+  gpuAssert(gpu::DeviceSynchronize());
+
+  // C accumulated the product once per call
+  for (int j = 0; j < n; j++) {
+    for (int i = 0; i < m; i++) {
+      double product = 0.0;
+      for (int l = 0; l < k; l++) product += A[l*m+i]*B[j*k+l];
+      ASSERT_DOUBLE_EQ(C[j*m+i], (converged+2)*product);
+    }
+  }
+
+  auto stats = tuner.out_of_core_gemm_planner<double>().make_statistics();
+  EXPECT_EQ(stats.get_counts().at(GEMM_Key(inputs)).size(), converged);
+}
+
+// With k zero every out-of-core plan only scales C by beta
+TEST_F(Planning_Test, Out_Of_Core_Empty_K) {
+  rtat::rtat tuner;
+
+  int m = 40, n = 30;
+  std::vector<double> A(m), B(n);
+  size_t calls = GEMM_Options_Out_Of_Core::enumerate().size() + 2;
+
+  for (double beta : {0.0, 0.5}) {
+    std::vector<double> C(m*n);
+    for (int i = 0; i < m*n; i++) C[i] = (i % 9) + 1;
+    auto C_init = C;
+
+    GEMM_Inputs<double> inputs(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N,
+                               Matrix<double>(Workspace(A.data(), 0), m, 0, m),
+                               Matrix<double>(Workspace(B.data(), 0), 0, n, 1),
+                               Matrix<double>(Workspace(C.data(), C.size()), m, n, m),
+                               1.0, beta);
+    for (size_t i = 0; i < calls; i++) tuner.out_of_core_gemm(inputs);
+    gpuAssert(gpu::DeviceSynchronize());
+
+    for (int i = 0; i < m*n; i++)
+      ASSERT_DOUBLE_EQ(C[i], C_init[i]*std::pow(beta, calls));
+  }
+}
+
 // Check that every plan can run without workspace
 TEST_F(Planning_Test, Plan_Degradation) {
   GEMM_Planner planner;
@@ -169,3 +1168,85 @@ TEST_F(Planning_Test, Plan_Degradation) {
     ASSERT_TRUE(C.is_zero());
   }
 }
+
+// Plans chosen under an accuracy budget must respect it
+TEST_F(Planning_Test, Mixed_Precision_Tolerance) {
+  size_t m = 64;
+  size_t n = 48;
+  size_t k = 96;
+
+  TestMatrix<float> A(m,k,m);
+  TestMatrix<float> B(k,n,k);
+  TestMatrix<float> C(m,n,m);
+
+  GEMM_Inputs<float> inputs(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, A, B, C, 1.0, 0.0);
+
+  for (float tolerance : {1e-7f, 1.0f}) {
+    SGEMM_Mixed_Planner planner(tolerance);
+    ManagedWorkspace space(1024);
+
+    GEMM_Options_Mixed plan;
+    for (size_t i=0; i<2*GEMM_Options_Mixed::enumerate().size(); i++) {
+      plan = planner.create_plan(inputs);
+
+      size_t req = planner.calculate_workspace(inputs, plan);
+      space.grow_to_fit<char>(req);
+
+      planner.execute(inputs, plan, space, s);
+    }
+    gpuAssert(gpu::DeviceSynchronize());
+
+    auto &errors = planner.get_errors()[GEMM_Key(inputs)];
+    EXPECT_EQ(errors.size(), Precision_Op().enumerate().size());
+    EXPECT_EQ(errors[Precision_Op::FULL], 0.0);
+    EXPECT_LE(errors[plan.precision], tolerance);
+
+    // Every error is bounded by what the inputs' precision allows
+    for (auto &[precision, error] : errors)
+      EXPECT_LT(error, 1e-1);
+  }
+}
+
+// The call measuring a precision outside the tolerance returns a full 
+// precision result, and the error is found under a bucketed key
+TEST_F(Planning_Test, Mixed_Precision_Guard) {
+  size_t m = 64;
+  size_t n = 48;
+  size_t k = 96;
+
+  TestMatrix<float> A(m,k,m);
+  TestMatrix<float> B(k,n,k);
+  TestMatrix<float> C(m,n,m);
+
+  GEMM_Inputs<float> inputs(handle, gpu::BLAS_OP_N, gpu::BLAS_OP_N, A, B, C, 1.0, 0.0);
+
+  for (auto precision : Precision_Op().enumerate()) {
+    SGEMM_Mixed_Planner planner(1e-7f);
+    planner.set_bucketing(std::make_shared<Dimension_Buckets>());
+    GEMM_Options_Mixed opts(BLAS_Op::NOTRANS, BLAS_Op::NOTRANS, 
+                            BLAS_Op::NOTRANS, precision);
+    ManagedWorkspace space(planner.calculate_workspace(inputs, opts));
+
+    planner.execute(inputs, opts, space, s);
+    gpuAssert(gpu::DeviceSynchronize());
+
+    C.download();
+    test_gemm(A, B, C, -1.0f, 1.0f, false, false);
+    EXPECT_TRUE(C.is_zero());
+
+    auto &errors = planner.get_errors()[planner.canonical(GEMM_Key(inputs))];
+    ASSERT_EQ(errors.count(precision), 1);
+    if (precision == Precision_Op::FULL) continue;
+    EXPECT_GT(errors[precision], 1e-7f);
+
+    // Once the error is known the option is filtered out
+    for (size_t i=0; i<2*GEMM_Options_Mixed::enumerate().size(); i++) {
+      auto next = planner.create_plan(inputs);
+      space.grow_to_fit<char>(planner.calculate_workspace(inputs, next));
+      planner.execute(inputs, next, space, s);
+    }
+    auto plan = planner.converged_plan(inputs);
+    ASSERT_TRUE(plan);
+    EXPECT_EQ(plan->precision.op, Precision_Op::FULL);
+  }
+}
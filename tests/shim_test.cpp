@@ -0,0 +1,121 @@
+#include <blas_shim.h>
+#include "common.h"
+
+// The shim takes host pointers, so only the host side of each TestMatrix
+// is used. Each problem is repeated until its plan has converged.
+const int repetitions = 12;
+
+TEST(Shim_Test, GEMM_Column_Major) {
+  const int m = 70, n = 50, k = 60;
+  const double alpha = 1.5, beta = 0.5;
+  TestMatrix<double> A(k,m,k+3);
+  TestMatrix<double> B(k,n);
+  TestMatrix<double> C(m,n,m+1);
+  auto C_init = C.host_vector;
+
+  size_t calls = BLAS_Shim::instance().get_overhead().calls;
+  for (int i = 0; i < repetitions; i++) {
+    C.host_vector = C_init;
+    cblas_dgemm(CblasColMajor, CblasTrans, CblasNoTrans, m, n, k, alpha,
+                A.host_vector.data(), A.ld, B.host_vector.data(), B.ld,
+                beta, C.host_vector.data(), C.ld);
+  }
+  ASSERT_EQ(BLAS_Shim::instance().get_overhead().calls, calls + repetitions);
+
+  TestMatrix<double> C_ref(m,n,m+1);
+  C_ref.host_vector = C_init;
+  test_gemm(A, B, C_ref, alpha, beta, true, false);
+  ASSERT_TRUE(C == C_ref);
+
+  // The converged plan is saved and can seed another planner
+  auto plans = BLAS_Shim::instance().save_plans();
+  ASSERT_EQ(plans["gemm"]["d"].size(), 1);
+
+  rtat::rtat fresh;
+  fresh.load_plans(plans);
+  auto saved_key = from_json<GEMM_Key>(plans["gemm"]["d"][0]["key"]);
+  // Every ld is off cache lines, and alignment is up to the allocator
+  GEMM_Key key(gpu::BLAS_OP_T, gpu::BLAS_OP_N, m, k, n, STRIDE_UNALIGNED,
+               STRIDE_UNALIGNED, STRIDE_UNALIGNED, saved_key.align,
+               BETA_OTHER);
+  ASSERT_EQ(std::string(saved_key), std::string(key));
+  auto saved = from_json<GEMM_Options>(plans["gemm"]["d"][0]["option"]);
+  auto loaded = fresh.gemm_planner<double>().create_plan(key);
+  ASSERT_TRUE(!(saved < loaded) && !(loaded < saved));
+}
+
+// Row major data is a column major transpose, so C^T = B^T A^T
+TEST(Shim_Test, GEMM_Row_Major) {
+  const int m = 40, n = 30, k = 20;
+  const std::complex<float> alpha(1.0, 0.5), beta(0.25, 0.0);
+  TestMatrix<std::complex<float>> At(k,m);
+  TestMatrix<std::complex<float>> Bt(n,k);
+  TestMatrix<std::complex<float>> Ct(n,m);
+  auto C_init = Ct.host_vector;
+
+  for (int i = 0; i < repetitions; i++) {
+    Ct.host_vector = C_init;
+    cblas_cgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, m, n, k, &alpha,
+                At.host_vector.data(), k, Bt.host_vector.data(), n,
+                &beta, Ct.host_vector.data(), n);
+  }
+
+  TestMatrix<std::complex<float>> C_ref(n,m);
+  C_ref.host_vector = C_init;
+  test_gemm(Bt, At, C_ref, alpha, beta, false, false);
+  ASSERT_TRUE(Ct == C_ref);
+}
+
+TEST(Shim_Test, TRSM_Row_Major) {
+  const int m = 40, n = 30;
+  const double alpha = 2.0;
+  TestMatrix<double> At(m,m);
+  TestMatrix<double> Bt(n,m);
+  auto B_init = Bt.host_vector;
+
+  // A row major lower A is a column major upper A^T
+  for (int i = 0; i < m; i++) {
+    for (int j = 0; j < m; j++) {
+      if (i > j) At.host_vector[j*m+i] = 0.0;
+      if (i == j) At.host_vector[j*m+i] += m;
+    }
+  }
+
+  for (int i = 0; i < repetitions; i++) {
+    Bt.host_vector = B_init;
+    cblas_dtrsm(CblasRowMajor, CblasLeft, CblasLower, CblasNoTrans,
+                CblasNonUnit, m, n, alpha, At.host_vector.data(), m,
+                Bt.host_vector.data(), n);
+  }
+
+  // A X = alpha B is X^T A^T = alpha B^T
+  TestMatrix<double> B_ref(n,m);
+  B_ref.host_vector = B_init;
+  test_trsm(At, B_ref, false, false, false, false, alpha);
+  ASSERT_TRUE(Bt == B_ref);
+}
+
+TEST(Shim_Test, SYRK_Column_Major) {
+  const int n = 50, k = 30;
+  const double alpha = 0.5, beta = 2.0;
+  TestMatrix<double> A(n,k);
+  TestMatrix<double> C(n,n);
+  auto C_init = C.host_vector;
+
+  for (int i = 0; i < repetitions; i++) {
+    C.host_vector = C_init;
+    cblas_dsyrk(CblasColMajor, CblasUpper, CblasNoTrans, n, k, alpha,
+                A.host_vector.data(), n, beta, C.host_vector.data(), n);
+  }
+
+  TestMatrix<double> C_ref(n,n);
+  C_ref.host_vector = C_init;
+  test_gemm(A, A, C_ref, alpha, beta, false, true);
+
+  // Only the upper triangle is referenced
+  for (int j = 0; j < n; j++) {
+    for (int i = 0; i <= j; i++) {
+      ASSERT_NEAR(C.host_vector[j*n+i], C_ref.host_vector[j*n+i], 1e-10);
+    }
+  }
+}
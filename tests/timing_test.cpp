@@ -37,3 +37,13 @@ TEST(Timer_Bank_Test, Times) {
   for (auto &t : times) 
     ASSERT_NEAR(t, interval, 1);
 }
+
+TEST(Device_Timer_Test, Reuses_Events) {
+  Stream s;
+  auto pooled = Device_Timer::pooled_events();
+  for (int i=0; i<10; i++) {
+    Device_Timer timer([&]([[maybe_unused]] Stream s) {}, s);
+    timer.time();
+  }
+  ASSERT_LE(Device_Timer::pooled_events(), pooled + 2);
+}